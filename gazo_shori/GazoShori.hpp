@@ -14,7 +14,24 @@
 #include <fstream>
 #include <sstream>
 #include <cmath>
+#include <complex>
 #include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <climits>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <system_error>
+#include <new>
+#include <algorithm>
+#include <utility>
+#include <type_traits>
+
+#if ( defined( __x86_64__ ) || defined( __i386__ ) ) && defined( __GNUC__ )
+#define GAZO_SHORI_X86_SIMD
+#include <immintrin.h>
+#endif
 
 namespace gs
 {
@@ -58,7 +75,24 @@ namespace gs
             return fast_min( fast_max( value, min ), max );
         }
         
-        static const int fixed_point_table[] = {0,4,8,12,16,20,24,28,32,36,40,44,48,52,56,60,64,68,72,76,80,84,88,92,96,100,104,108,112,116,120,124,128,132,136,140,144,148,152,156,160,164,168,172,176,180,184,188,192,196,200,204,208,212,216,220,224,228,232,236,240,244,248,252,257,261,265,269,273,277,281,285,289,293,297,301,305,309,313,317,321,325,329,333,337,341,345,349,353,357,361,365,369,373,377,381,385,389,393,397,401,405,409,413,417,421,425,429,433,437,441,445,449,453,457,461,465,469,473,477,481,485,489,493,497,501,505,509,514,518,522,526,530,534,538,542,546,550,554,558,562,566,570,574,578,582,586,590,594,598,602,606,610,614,618,622,626,630,634,638,642,646,650,654,658,662,666,670,674,678,682,686,690,694,698,702,706,710,714,718,722,726,730,734,738,742,746,750,754,758,762,766,771,775,779,783,787,791,795,799,803,807,811,815,819,823,827,831,835,839,843,847,851,855,859,863,867,871,875,879,883,887,891,895,899,903,907,911,915,919,923,927,931,935,939,943,947,951,955,959,963,967,971,975,979,983,987,991,995,999,1003,1007,1011,1015,1019,1024};
+        // alpha 0-255 in 1/1024 steps. built by the compiler.
+        struct FixedPointTable
+        {
+            int values[256];
+            
+            constexpr FixedPointTable() : values()
+            {
+                for( int i=0; i<256; ++i )
+                {
+                    values[i] = i * 1024 / 255;
+                }
+            }
+            constexpr int operator[]( const int index ) const
+            {
+                return values[ index ];
+            }
+        };
+        static constexpr FixedPointTable fixed_point_table{};
 
         template <class T> struct Point
         {
@@ -323,6 +357,7 @@ namespace gs
     { \
         static const int CHANNEL = N; \
         static const int TYPE_BYTE = sizeof(T); \
+        using Type = T; \
         union \
         { \
             T channels[N]; \
@@ -355,14 +390,180 @@ namespace gs
      */
     ColorConcept( HMB,  float, 3, H, M, B );
 #undef ColorConcept
+    
+    /*
+       HMB in 4 bytes for the tolerance tests of the edge keeping filters.
+     
+       H = hue in 1/HUE_SCALE degree steps from -180 degree.
+       M, B = the same integers as HMB of an RGB color.
+     */
+    struct HMB_Q
+    {
+        static const int CHANNEL = 3;
+        static const int HUE_SCALE = 128;
+        
+        uint16_t H;
+        uint8_t  M;
+        uint8_t  B;
+    };
 
-    // Unimplemented
     struct ColorBufferGRAY
     {
         int L = 0;
+        
+        ColorBufferGRAY(){}
+        
+        ColorBufferGRAY( const int value )
+        {
+            L = value;
+        }
+        
+        ColorBufferGRAY( const GRAY value )
+        {
+            *this = value;
+        }
+        
+        inline ColorBufferGRAY& operator=( const GRAY value )
+        {
+            L = (int)value.L;
+            return *this;
+        }
+        
+        inline ColorBufferGRAY operator+( const int value ) const
+        {
+            return { L+value };
+        }
+        
+        inline ColorBufferGRAY& operator+=( const int value )
+        {
+            L += value;
+            return *this;
+        }
+        
+        inline ColorBufferGRAY operator+( const ColorBufferGRAY value ) const
+        {
+            return { L+value.L };
+        }
+        
+        inline ColorBufferGRAY& operator+=( const ColorBufferGRAY value )
+        {
+            L += value.L;
+            return *this;
+        }
+        
+        inline ColorBufferGRAY operator-( const int value ) const
+        {
+            return { L-value };
+        }
+        
+        inline ColorBufferGRAY& operator-=( const int value )
+        {
+            L -= value;
+            return *this;
+        }
+        
+        inline ColorBufferGRAY operator-( const ColorBufferGRAY value ) const
+        {
+            return { L-value.L };
+        }
+        
+        inline ColorBufferGRAY& operator-=( const ColorBufferGRAY value )
+        {
+            L -= value.L;
+            return *this;
+        }
+        
+        inline ColorBufferGRAY operator*( const int value ) const
+        {
+            return { L*value };
+        }
+        
+        inline ColorBufferGRAY operator*( const ColorBufferGRAY value ) const
+        {
+            return { L*value.L };
+        }
+        
+        inline ColorBufferGRAY& operator*=( const int value )
+        {
+            L *= value;
+            return *this;
+        }
+        
+        inline ColorBufferGRAY operator/( const int value ) const
+        {
+            return { L/value };
+        }
+        
+        inline ColorBufferGRAY& operator/=( const int value )
+        {
+            L /= value;
+            return *this;
+        }
+        
+        inline ColorBufferGRAY& operator>>=( const int value )
+        {
+            L >>= value;
+            return *this;
+        }
+        
+        inline ColorBufferGRAY operator>>( const int value ) const
+        {
+            return { L >> value };
+        }
+        
+        inline operator GRAY() const
+        {
+            return { (uint8_t)L };
+        }
+        
+        inline GRAY min( const int value ) const
+        {
+            return { (uint8_t)core::fast_min( L, value ) };
+        }
+        
+        inline GRAY max( const int value ) const
+        {
+            return { (uint8_t)core::fast_max( L, value ) };
+        }
+        
+        // [return] clamped to 0-255.
+        inline GRAY limit() const
+        {
+            return { (uint8_t)core::limit( L, 0, 255 ) };
+        }
+        
+        inline GRAY abs() const
+        {
+            return { (uint8_t)core::fast_max( L, -L ) };
+        }
+        
+        inline GRAY limit_min_max() const
+        {
+            return { (uint8_t)core::limit( L, 0, 255 ) };
+        }
+        
+        inline GRAY limit_min() const
+        {
+            return { (uint8_t)core::fast_max( L, 0 ) };
+        }
+        
+        inline GRAY limit_max() const
+        {
+            return { (uint8_t)core::fast_min( L, 255 ) };
+        }
+        
+        inline static GRAY compare_min( const GRAY left, const GRAY right )
+        {
+            return { (uint8_t)core::fast_min( left.L, right.L ) };
+        }
+        
+        inline static GRAY compare_max( const GRAY left, const GRAY right )
+        {
+            return { (uint8_t)core::fast_max( left.L, right.L ) };
+        }
     };
-
-    // Unimplemented
+    
+    // luminance in the same 0-255 scale as GRAY, without rounding between the passes.
     struct ColorBufferGRAY_F
     {
         float L = 0;
@@ -383,12 +584,6 @@ namespace gs
             return *this;
         }
         
-        inline ColorBufferGRAY_F& operator=( const ColorBufferGRAY_F value )
-        {
-            L = value.L;
-            return *this;
-        }
-
         inline ColorBufferGRAY_F operator*( const float value ) const
         {
             return { L * value };
@@ -404,6 +599,23 @@ namespace gs
             return { L * value.L };
         }
         
+        inline ColorBufferGRAY_F& operator*=( const float value )
+        {
+            L *= value;
+            return *this;
+        }
+        
+        inline ColorBufferGRAY_F operator/( const float value ) const
+        {
+            return { L / value };
+        }
+        
+        inline ColorBufferGRAY_F& operator/=( const float value )
+        {
+            L /= value;
+            return *this;
+        }
+        
         inline ColorBufferGRAY_F operator+( const float value ) const
         {
             return {L + value};
@@ -414,6 +626,11 @@ namespace gs
             return {L + value.L};
         }
         
+        inline ColorBufferGRAY_F operator+( const ColorBufferGRAY_F value ) const
+        {
+            return {L + value.L};
+        }
+        
         inline ColorBufferGRAY_F& operator+=( const float value )
         {
             L += value;
@@ -432,15 +649,90 @@ namespace gs
             return *this;
         }
         
+        inline ColorBufferGRAY_F operator-( const float value ) const
+        {
+            return {L - value};
+        }
+        
+        inline ColorBufferGRAY_F operator-( const ColorBufferGRAY_F value ) const
+        {
+            return {L - value.L};
+        }
+        
+        inline ColorBufferGRAY_F& operator-=( const float value )
+        {
+            L -= value;
+            return *this;
+        }
+        
+        inline ColorBufferGRAY_F& operator-=( const ColorBufferGRAY_F value )
+        {
+            L -= value.L;
+            return *this;
+        }
+        
+        // fixed point shift of the integer buffers is a division here.
         inline ColorBufferGRAY_F operator>>( const int value ) const
         {
             return { L / (float)(1<<value) };
         }
         
+        inline ColorBufferGRAY_F& operator>>=( const int value )
+        {
+            L /= (float)(1<<value);
+            return *this;
+        }
+        
         inline operator GRAY_F() const
         {
             return { L };
         }
+        
+        inline GRAY_F min( const float value ) const
+        {
+            return { L < value ? L : value };
+        }
+        
+        inline GRAY_F max( const float value ) const
+        {
+            return { L > value ? L : value };
+        }
+        
+        // [return] as it is. float channels have no range.
+        inline GRAY_F limit() const
+        {
+            return { L };
+        }
+        
+        inline GRAY_F abs() const
+        {
+            return { L < 0.0f ? -L : L };
+        }
+        
+        inline GRAY_F limit_min_max() const
+        {
+            return { L < 0.0f ? 0.0f : L > 255.0f ? 255.0f : L };
+        }
+        
+        inline GRAY_F limit_min() const
+        {
+            return max( 0.0f );
+        }
+        
+        inline GRAY_F limit_max() const
+        {
+            return min( 255.0f );
+        }
+        
+        inline static GRAY_F compare_min( const GRAY_F left, const GRAY_F right )
+        {
+            return { left.L < right.L ? left.L : right.L };
+        }
+        
+        inline static GRAY_F compare_max( const GRAY_F left, const GRAY_F right )
+        {
+            return { left.L > right.L ? left.L : right.L };
+        }
     };
 
     struct ColorBufferRGB
@@ -603,6 +895,15 @@ namespace gs
                 (uint8_t)core::fast_max( B, value  ) };
         }
 
+        // [return] clamped to 0-255.
+        inline RGB limit() const
+        {
+            return {
+                (uint8_t)core::limit( R, 0, 255 ),
+                (uint8_t)core::limit( G, 0, 255 ),
+                (uint8_t)core::limit( B, 0, 255 ) };
+        }
+
         inline RGB abs() const
         {
             return {
@@ -652,90 +953,419 @@ namespace gs
         }
     };
     
-    // Unimplemented
     struct ColorBufferRGBA
     {
         int R = 0;
         int G = 0;
         int B = 0;
         int A = 0;
-    };
-    
-    // Unimplemented
-    struct ColorBufferHMB
-    {
-        float H = 0.0f;
-        float M = 0.0f;
-        float B = 0.0f;
-    };
-#undef BaseColorBufferOperator3Channel
-    
-    inline static const uint8_t alpha_blend( const uint8_t back, const uint8_t fore, const int fixed_alpha )
-    {
-        const int a   = fixed_alpha;
-        const int ia  = 1024 - a;
         
-        return (uint8_t)((back * ia + fore * a) >> 10);
-    }
-    
-    inline static const uint8_t alpha_blend( const uint8_t back, const uint8_t fore, const uint8_t alpha )
-    {
-        return alpha_blend( back, fore, core::fixed_point_table[ alpha ] );
-    }
-    
-    inline static const uint8_t alpha_blend( const uint8_t back, const uint8_t fore, const float alpha )
-    {
-        return alpha_blend( back, fore, (int)(alpha*1024.0f) );
-    }
+        ColorBufferRGBA(){}
 
-    inline static const RGB alpha_blend( const RGB back, const RGB fore, const int alpha )
-    {
-        return
+        ColorBufferRGBA( const int value )
         {
-            (uint8_t)alpha_blend( back.R, fore.R, alpha ),
-            (uint8_t)alpha_blend( back.G, fore.G, alpha ),
-            (uint8_t)alpha_blend( back.B, fore.B, alpha )
-        };
-    }
-    
-    enum class Interpolation
-    {
-        nearest,
-        bilinear,
-        bicubic,
-        super,
-    };
-    
-    using bicubic_table = std::array<int, 201>;
-    
-    static bicubic_table create_bicubic_table( const float a )
-    {
-        bicubic_table table;
+            this->R = value;
+            this->G = value;
+            this->B = value;
+            this->A = value;
+        }
+
+        ColorBufferRGBA( const int R, const int G, const int B, const int A )
+        {
+            this->R = R;
+            this->G = G;
+            this->B = B;
+            this->A = A;
+        }
+
+        ColorBufferRGBA( const RGBA value )
+        {
+            *this = value;
+        }
         
-        for( int d=0; d<=table.size(); ++d )
+        inline ColorBufferRGBA& operator=( const RGBA value )
         {
-            const float fd = d / 100.0f;
+            R = (int)value.R;
+            G = (int)value.G;
+            B = (int)value.B;
+            A = (int)value.A;
             
-            if( d < 100 )
-            {
-                table[d] = (int)(((a+2.0f) * fd * fd * fd - (a+3.0f) * fd * fd + 1.0f) * 1000.0f);
-            }
-            else if( d < 200 )
-            {
-                table[d] = (int)((a * fd * fd * fd  - 5 * a * fd * fd + 8 * a * fd - 4 * a) * 1000.0f);
-            }
-            else
-            {
-                table[d] = 0.0f;
-            }
+            return *this;
+        }
+        
+        inline ColorBufferRGBA operator+( const int value ) const
+        {
+            return { R+value, G+value, B+value, A+value };
+        }
+        
+        inline ColorBufferRGBA& operator+=( const int value )
+        {
+            R += value;
+            G += value;
+            B += value;
+            A += value;
+            
+            return *this;
+        }
+        
+        inline ColorBufferRGBA operator+( const ColorBufferRGBA value ) const
+        {
+            return { R+value.R, G+value.G, B+value.B, A+value.A };
+        }
+
+        inline ColorBufferRGBA& operator+=( const ColorBufferRGBA value )
+        {
+            R += value.R;
+            G += value.G;
+            B += value.B;
+            A += value.A;
+            
+            return *this;
+        }
+        
+        inline ColorBufferRGBA operator-( const int value ) const
+        {
+            return { R-value, G-value, B-value, A-value };
+        }
+        
+        inline ColorBufferRGBA& operator-=( const int value )
+        {
+            R -= value;
+            G -= value;
+            B -= value;
+            A -= value;
+            
+            return *this;
+        }
+        
+        inline ColorBufferRGBA operator-( const ColorBufferRGBA value ) const
+        {
+            return { R-value.R, G-value.G, B-value.B, A-value.A };
+        }
+        
+        inline ColorBufferRGBA& operator-=( const ColorBufferRGBA value )
+        {
+            R -= value.R;
+            G -= value.G;
+            B -= value.B;
+            A -= value.A;
+            
+            return *this;
+        }
+        
+        inline ColorBufferRGBA operator*( const int value ) const
+        {
+            return { R*value, G*value, B*value, A*value };
+        }
+        
+        inline ColorBufferRGBA operator*( const ColorBufferRGBA value ) const
+        {
+            return { R*value.R, G*value.G, B*value.B, A*value.A };
+        }
+
+        inline ColorBufferRGBA& operator*=( const int value )
+        {
+            R *= value;
+            G *= value;
+            B *= value;
+            A *= value;
+            
+            return *this;
+        }
+        
+        inline ColorBufferRGBA operator/( const int value ) const
+        {
+            return { R/value, G/value, B/value, A/value };
+        }
+        
+        inline ColorBufferRGBA& operator/=( const int value )
+        {
+            R /= value;
+            G /= value;
+            B /= value;
+            A /= value;
+            
+            return *this;
+        }
+        
+        inline ColorBufferRGBA& operator>>=( const int value )
+        {
+            R >>= value;
+            G >>= value;
+            B >>= value;
+            A >>= value;
+            
+            return *this;
+        }
+        
+        inline ColorBufferRGBA operator>>( const int value ) const
+        {
+            return {R >> value, G >> value, B >> value, A >> value};
+        }
+        
+        inline operator RGBA() const
+        {
+            return { (uint8_t)R, (uint8_t)G, (uint8_t)B, (uint8_t)A };
+        }
+
+        inline RGBA min( const int value ) const
+        {
+            return {
+                (uint8_t)core::fast_min( R, value ),
+                (uint8_t)core::fast_min( G, value  ),
+                (uint8_t)core::fast_min( B, value  ),
+                (uint8_t)core::fast_min( A, value  ) };
+        }
+
+        inline RGBA max( const int value ) const
+        {
+            return {
+                (uint8_t)core::fast_max( R, value ),
+                (uint8_t)core::fast_max( G, value  ),
+                (uint8_t)core::fast_max( B, value  ),
+                (uint8_t)core::fast_max( A, value  ) };
+        }
+
+        // [return] clamped to 0-255.
+        inline RGBA limit() const
+        {
+            return {
+                (uint8_t)core::limit( R, 0, 255 ),
+                (uint8_t)core::limit( G, 0, 255 ),
+                (uint8_t)core::limit( B, 0, 255 ),
+                (uint8_t)core::limit( A, 0, 255 ) };
+        }
+
+        inline RGBA abs() const
+        {
+            return {
+                (uint8_t)core::fast_max( R, -R ),
+                (uint8_t)core::fast_max( G, -G ),
+                (uint8_t)core::fast_max( B, -B ),
+                (uint8_t)core::fast_max( A, -A ) };
+        }
+        
+        inline RGBA limit_min_max() const
+        {
+            return {
+                (uint8_t)core::limit( R, 0, 255 ),
+                (uint8_t)core::limit( G, 0, 255 ),
+                (uint8_t)core::limit( B, 0, 255 ),
+                (uint8_t)core::limit( A, 0, 255 ) };
+        }
+
+        inline RGBA limit_min() const
+        {
+            return {
+                (uint8_t)core::fast_max( R, 0 ),
+                (uint8_t)core::fast_max( G, 0 ),
+                (uint8_t)core::fast_max( B, 0 ),
+                (uint8_t)core::fast_max( A, 0 ) };
+        }
+
+        inline RGBA limit_max() const
+        {
+            return {
+                (uint8_t)core::fast_min( R, 255 ),
+                (uint8_t)core::fast_min( G, 255 ),
+                (uint8_t)core::fast_min( B, 255 ),
+                (uint8_t)core::fast_min( A, 255 ) };
+        }
+        
+        inline static RGBA compare_min( const RGBA left, const RGBA right )
+        {
+            return {
+                (uint8_t)core::fast_min( left.R, right.R ),
+                (uint8_t)core::fast_min( left.G, right.G ),
+                (uint8_t)core::fast_min( left.B, right.B ),
+                (uint8_t)core::fast_min( left.A, right.A ) };
+        }
+
+        inline static RGBA compare_max( const RGBA left, const RGBA right )
+        {
+            return {
+                (uint8_t)core::fast_max( left.R, right.R ),
+                (uint8_t)core::fast_max( left.G, right.G ),
+                (uint8_t)core::fast_max( left.B, right.B ),
+                (uint8_t)core::fast_max( left.A, right.A ) };
+        }
+    };
+    
+    // Unimplemented
+    struct ColorBufferHMB
+    {
+        float H = 0.0f;
+        float M = 0.0f;
+        float B = 0.0f;
+    };
+#undef BaseColorBufferOperator3Channel
+    
+    inline static const uint8_t alpha_blend( const uint8_t back, const uint8_t fore, const int fixed_alpha )
+    {
+        const int a   = fixed_alpha;
+        const int ia  = 1024 - a;
+        
+        return (uint8_t)((back * ia + fore * a) >> 10);
+    }
+    
+    inline static const uint8_t alpha_blend( const uint8_t back, const uint8_t fore, const uint8_t alpha )
+    {
+        return alpha_blend( back, fore, core::fixed_point_table[ alpha ] );
+    }
+    
+    inline static const uint8_t alpha_blend( const uint8_t back, const uint8_t fore, const float alpha )
+    {
+        return alpha_blend( back, fore, (int)(alpha*1024.0f) );
+    }
+
+    inline static const float alpha_blend( const float back, const float fore, const int fixed_alpha )
+    {
+        return (back * (1024 - fixed_alpha) + fore * fixed_alpha) * (1.0f / 1024.0f);
+    }
+    
+    inline static const GRAY alpha_blend( const GRAY back, const GRAY fore, const int alpha )
+    {
+        return { (uint8_t)alpha_blend( back.L, fore.L, alpha ) };
+    }
+    
+    inline static const GRAY_F alpha_blend( const GRAY_F back, const GRAY_F fore, const int alpha )
+    {
+        return { alpha_blend( back.L, fore.L, alpha ) };
+    }
+    
+    inline static const RGB alpha_blend( const RGB back, const RGB fore, const int alpha )
+    {
+        return
+        {
+            (uint8_t)alpha_blend( back.R, fore.R, alpha ),
+            (uint8_t)alpha_blend( back.G, fore.G, alpha ),
+            (uint8_t)alpha_blend( back.B, fore.B, alpha )
+        };
+    }
+
+    inline static const RGBA alpha_blend( const RGBA back, const RGBA fore, const int alpha )
+    {
+        return
+        {
+            (uint8_t)alpha_blend( back.R, fore.R, alpha ),
+            (uint8_t)alpha_blend( back.G, fore.G, alpha ),
+            (uint8_t)alpha_blend( back.B, fore.B, alpha ),
+            (uint8_t)alpha_blend( back.A, fore.A, alpha )
+        };
+    }
+    
+    // value * alpha / 255, rounded.
+    inline static const uint8_t multiply_alpha( const int value, const int alpha )
+    {
+        const int temp = value * alpha + 128;
+        
+        return (uint8_t)((temp + (temp >> 8)) >> 8);
+    }
+    
+    inline static const RGBA premultiply( const RGBA color )
+    {
+        return
+        {
+            multiply_alpha( color.R, color.A ),
+            multiply_alpha( color.G, color.A ),
+            multiply_alpha( color.B, color.A ),
+            color.A
+        };
+    }
+    
+    inline static const RGBA unpremultiply( const RGBA color )
+    {
+        if( color.A == 0 )
+        {
+            return { 0, 0, 0, 0 };
         }
         
-        return table;
+        const int half = color.A / 2;
+        return
+        {
+            (uint8_t)core::fast_min( (color.R * 255 + half) / color.A, 255 ),
+            (uint8_t)core::fast_min( (color.G * 255 + half) / color.A, 255 ),
+            (uint8_t)core::fast_min( (color.B * 255 + half) / color.A, 255 ),
+            color.A
+        };
+    }
+    
+    // source over of premultiplied colors.
+    inline static const RGBA composite_over( const RGBA back, const RGBA fore )
+    {
+        const int inverse = 255 - fore.A;
+        
+        return
+        {
+            (uint8_t)( fore.R + multiply_alpha( back.R, inverse ) ),
+            (uint8_t)( fore.G + multiply_alpha( back.G, inverse ) ),
+            (uint8_t)( fore.B + multiply_alpha( back.B, inverse ) ),
+            (uint8_t)( fore.A + multiply_alpha( back.A, inverse ) )
+        };
+    }
+    
+    enum class Interpolation
+    {
+        nearest,
+        bilinear,
+        bicubic,
+        super,
+    };
+    
+    // pixels outside of the image read by filters. abcdef is the image.
+    enum class Border
+    {
+        mirror,   // edcb|abcdef|fedc  same as mirror_border().
+        reflect,  // dcba|abcdef|fedc
+        clamp,    // aaaa|abcdef|ffff
+        wrap,     // cdef|abcdef|abcd
+        constant, // xxxx|abcdef|xxxx  x is the border color.
+    };
+    
+    // kernels of edge_detection().
+    enum class EdgeKernel
+    {
+        direction, // unit vectors to every pixel within the radius.
+        sobel,     // 3x3 sobel. radius 1 only.
+    };
+    
+    // operations of ImageView::morphology_into().
+    enum class Morphology
+    {
+        erode,    // min of the rectangle.
+        dilate,   // max of the rectangle.
+        open,     // dilate of erode. removes bright specks smaller than the rectangle.
+        close,    // erode of dilate. fills dark holes smaller than the rectangle.
+        gradient, // dilate - erode.
+    };
+    
+    using bicubic_table = std::array<int, 201>;
+    
+    // bicubic weight at d/100 pixels, in 1/1000.
+    static constexpr int bicubic_weight( const float a, const int d )
+    {
+        const float fd = d / 100.0f;
+        
+        return d < 100 ? (int)(((a+2.0f) * fd * fd * fd - (a+3.0f) * fd * fd + 1.0f) * 1000.0f) :
+               d < 200 ? (int)((a * fd * fd * fd  - 5 * a * fd * fd + 8 * a * fd - 4 * a) * 1000.0f) :
+                         0;
+    }
+    
+    template <size_t... D>
+    static constexpr bicubic_table create_bicubic_table( const float a, std::index_sequence< D... > )
+    {
+        return {{ bicubic_weight( a, (int)D )... }};
+    }
+    
+    // a constant expression, so a table of a constant a costs nothing at load.
+    static constexpr bicubic_table create_bicubic_table( const float a )
+    {
+        return create_bicubic_table( a, std::make_index_sequence< std::tuple_size< bicubic_table >::value >() );
     }
     
     namespace core
     {
-        static const bicubic_table default_bicubic_table = create_bicubic_table(-1.0f);
+        static constexpr bicubic_table default_bicubic_table = create_bicubic_table(-1.0f);
         
 #pragma pack(1)
         struct BitmapHeader
@@ -759,1461 +1389,8027 @@ namespace gs
             uint32_t biClrImportant   = 0;
         };
 #pragma pack()
-        template <class T, class ColorBuffer> class Image
+        
+        static const int ROW_ALIGNMENT = 64;
+        
+        inline static const size_t align_size( const size_t size, const size_t alignment )
         {
-        public:
-            union
+            return (size + alignment - 1) / alignment * alignment;
+        }
+        
+        // move a row pointer by stride bytes.
+        template <class T> inline static T* offset_row( T* pointer, const ptrdiff_t stride )
+        {
+            return (T*)((const uint8_t*)pointer + stride);
+        }
+        
+        /*
+         *  [return] source index of index under border, or -1 for the border color.
+         *           any index is folded back, so the border may be wider than the image.
+         */
+        inline static int border_index( const int index, const int length, const Border border )
+        {
+            if( index >= 0 && index < length )
             {
-                struct
+                return index;
+            }
+            if( border == Border::mirror )
+            {
+                // the two reflections repeat every length*2-1 pixels.
+                const int period = length*2 - 1;
+                const int i = ( index % period + period ) % period;
+                return i < length ? i : period - i;
+            }
+            else if( border == Border::reflect )
+            {
+                const int period = length*2;
+                const int i = ( index % period + period ) % period;
+                return i < length ? i : period - 1 - i;
+            }
+            else if( border == Border::clamp )
+            {
+                return index < 0 ? 0 : length - 1;
+            }
+            else if( border == Border::wrap )
+            {
+                return ( index % length + length ) % length;
+            }
+            return -1;
+        }
+        
+        /*
+         *  fills radius columns on both sides of a line from its own width columns.
+         *
+         *  [in]line  column 0. a column is channels values.
+         *  [in]color channels values of Border::constant.
+         */
+        template <class T>
+        inline static void fill_border_columns( T* line, const int width, const int radius, const int channels,
+                                                const Border border, const T* color )
+        {
+            for( int x=1; x<=radius; ++x )
+            {
+                const int left  = border_index( -x, width, border );
+                const int right = border_index( width-1+x, width, border );
+                const T* p_left  = left  < 0 ? color : line + left*channels;
+                const T* p_right = right < 0 ? color : line + right*channels;
+                
+                for( int c=0; c<channels; ++c )
                 {
-                    const int width = 0;
-                    const int height = 0;
-                };
-                const SizeI size;
-            };
-            const unsigned int length = 0;
-            
-        private:
-            std::vector< T > m_data;
-           
+                    line[ -x*channels + c ] = p_left[c];
+                    line[ (width-1+x)*channels + c ] = p_right[c];
+                }
+            }
+        }
+        
+        // memory source of image buffers.
+        class Allocator
+        {
         public:
-            class Move
+            virtual ~Allocator(){}
+            virtual void* allocate( const size_t size ) = 0;
+            virtual void deallocate( void* memory, const size_t size ) = 0;
+        };
+        
+        class HeapAllocator : public Allocator
+        {
+        public:
+            void* allocate( const size_t size ) override
             {
-                friend class Image;
-            private:
-                SizeI size = {};
-                unsigned int length = 0;
-                std::vector< T > m_data;
+                return ::operator new( size );
+            }
+            void deallocate( void* memory, const size_t ) override
+            {
+                ::operator delete( memory );
+            }
+        };
+        
+        inline static std::atomic< size_t >& recycle_capacity_setting()
+        {
+            static std::atomic< size_t > bytes( 16 * 1024 * 1024 );
+            return bytes;
+        }
+        
+        // [return] bytes RecyclingAllocator keeps cached per thread, for all of its instances together.
+        inline static size_t recycle_capacity()
+        {
+            return recycle_capacity_setting().load( std::memory_order_relaxed );
+        }
+        
+        // [in]bytes 0 caches nothing. a lower value is reached as the cached blocks are reused.
+        inline static void set_recycle_capacity( const size_t bytes )
+        {
+            recycle_capacity_setting().store( bytes );
+        }
+        
+        /*
+         *  Keeps freed blocks in a per-thread cache by size class, and reuses them
+         *  for the next allocation of the same class. Worker threads reuse their
+         *  buffers across requests without touching malloc or fresh pages.
+         *
+         *  Size classes are 4 steps per power of two from 4KB. Blocks freed by another
+         *  thread go to that thread's cache. every instance shares the cache of a thread,
+         *  bounded by recycle_capacity().
+         */
+        class RecyclingAllocator : public Allocator
+        {
+        private:
+            static const int CLASS_COUNT = 4 * 40;
+            
+            struct Cache
+            {
+                std::vector< void* > blocks[ CLASS_COUNT ];
+                size_t bytes = 0;
                 
-            public:
-                Move( Image&& image )
+                ~Cache()
                 {
-                    size   = image.size;
-                    length = image.length;
-                    m_data = std::move( image.m_data );
-                    
-                    (SizeI&)image.size = SizeI();
-                    (unsigned int&)image.length = 0;
+                    for( auto& list : blocks )
+                    {
+                        for( void* block : list )
+                        {
+                            ::operator delete( block );
+                        }
+                    }
                 }
             };
             
-        public:
-            Image() noexcept{}
-            Image( const Image& value ) noexcept
+            static Cache& cache()
             {
-                (SizeI&)this->size = value.size;
-                (unsigned int&)length = value.size.width*size.height;
-                m_data = value.m_data;
+                static thread_local Cache cache;
+                return cache;
             }
-            Image( Image&& value ) noexcept{ *this = std::forward<Image>(value); }
-            Image( Move&& value ) noexcept{ *this = std::forward<Move>(value); }
-            Image( const SizeI& size ){ create( size ); }
-            virtual ~Image(){}
-            virtual void create( const SizeI& size )
+            
+            inline static size_t class_size( const int index )
             {
-                (SizeI&)this->size = size;
-                (unsigned int&)length = size.width*size.height;
-                if( length == m_data.size() )
+                return (size_t)(4 + index % 4) << (index / 4 + 10);
+            }
+            
+            inline static int class_index( const size_t size )
+            {
+                int index = 0;
+                while( index < CLASS_COUNT-1 && class_size( index ) < size )
                 {
-                    fill({});
+                    index += index % 4 == 0 && class_size( index + 4 ) < size ? 4 : 1;
                 }
-                else
+                return index;
+            }
+            
+        public:
+            void* allocate( const size_t size ) override
+            {
+                const int index = class_index( size );
+                Cache& local = cache();
+                
+                if( !local.blocks[index].empty() )
                 {
-                    m_data.resize( length );
+                    void* block = local.blocks[index].back();
+                    local.blocks[index].pop_back();
+                    local.bytes -= class_size( index );
+                    return block;
                 }
+                return ::operator new( class_size( index ) );
             }
-            virtual void clear()
+            
+            void deallocate( void* memory, const size_t size ) override
             {
-                (SizeI&)size = SizeI();
-                (unsigned int&)length = 0;
-                m_data.clear();
-            }
-            inline T& operator[]( unsigned int index ){ return m_data[index]; };
-            inline const T& operator[]( unsigned int index ) const{ return m_data[index]; };
-            inline T& operator[]( const PointI& point ){ return m_data[point.y*width+point.x]; };
-            inline const T& operator[]( const PointI& point ) const{ return m_data[point.y*width+point.x]; };
-            inline typename std::vector<T>::iterator begin(){return m_data.begin();}
-            inline typename std::vector<T>::iterator end(){return m_data.end();}
-            inline typename std::vector<T>::const_iterator cbegin() const{return m_data.cbegin();}
-            inline typename std::vector<T>::const_iterator cend() const{return m_data.cend();}
-
-            Image<T,ColorBuffer>& operator=( const Image<T,ColorBuffer>& value )
-            {
-                clear();
-                (SizeI&)size = value.size;
-                (unsigned int&)length = value.length;
-                m_data = value.m_data;
-                return *this;
+                const int index = class_index( size );
+                Cache& local = cache();
+                
+                if( local.bytes + class_size( index ) > recycle_capacity() )
+                {
+                    ::operator delete( memory );
+                    return;
+                }
+                local.blocks[index].push_back( memory );
+                local.bytes += class_size( index );
             }
+        };
+        
+        inline static Allocator* heap_allocator()
+        {
+            static HeapAllocator allocator;
+            return &allocator;
+        }
+        
+        inline static Allocator*& thread_allocator()
+        {
+            static thread_local Allocator* allocator = nullptr;
+            return allocator;
+        }
+        
+        // allocator of the images created by this thread.
+        inline static Allocator* default_allocator()
+        {
+            Allocator* allocator = thread_allocator();
+            return allocator != nullptr ? allocator : heap_allocator();
+        }
+        
+        // sets the default allocator of this thread while in scope.
+        class ScopedAllocator
+        {
+        private:
+            Allocator* m_previous;
             
-            inline T get_nearest_pixel( const float x, const float y ) const
+        public:
+            ScopedAllocator( Allocator* allocator )
             {
-                return (*this)[ { (int)(x+0.5f), (int)(y+0.5f) } ];
+                m_previous = thread_allocator();
+                thread_allocator() = allocator;
             }
-
-            inline T get_nearest_pixel_safe_out_of_range( const float x, const float y ) const
+            ~ScopedAllocator()
             {
-                return (*this)[ { limit( (int)(x+0.5f), 0, width-1), limit( (int)(y+0.5f), 0, height-1 ) } ];
+                thread_allocator() = m_previous;
             }
+            ScopedAllocator( const ScopedAllocator& ) = delete;
+            ScopedAllocator& operator=( const ScopedAllocator& ) = delete;
+        };
+        
+        // std::vector allocator for scratch buffers, backed by default_allocator().
+        template <class T> struct ScratchAllocator
+        {
+            using value_type = T;
             
-            inline T get_bilinear_pixel( const float x, const float y ) const
+            Allocator* allocator = default_allocator();
+            
+            ScratchAllocator(){}
+            template <class U> ScratchAllocator( const ScratchAllocator<U>& value ) : allocator( value.allocator ){}
+            
+            T* allocate( const size_t count )
             {
-                const int ix = (int)x;
-                const int iy = (int)y;
-                const int fx = (int)((1.0f - (x - (float)ix))*1024.0f);
-                const int fy = (int)((1.0f - (y - (float)iy))*1024.0f);
-                
-                const T* base = &(*this)[ { ix+0, iy+0 } ];
-                const ColorBuffer c1 = base[0];      // { ix+0, iy+0 }
-                const ColorBuffer c2 = base[1];      // { ix+1, iy+0 }
-                const ColorBuffer c3 = base[width];  // { ix+0, iy+1 }
-                const ColorBuffer c4 = base[width+1];// { ix+1, iy+1 }
-
-                return (((c1*fx + c2*(1024-fx))>>10) * fy + ((c3*fx + c4*(1024-fx))>>10) * (1024-fy)) >> 10;
+                return (T*)allocator->allocate( count * sizeof(T) );
             }
-
-            inline T get_bilinear_pixel_safe_out_of_range( const float x, const float y ) const
+            void deallocate( T* memory, const size_t count )
             {
-                const int ix = (int)x;
-                const int iy = (int)y;
-                const float fx = x >= 0.0f ? 1.0f - (x - (float)ix) : 1.0f + (x - (float)ix);
-                const float fy = y >= 0.0f ? 1.0f - (y - (float)iy) : 1.0f + (y - (float)iy);
-                const int aix = limit( ix, 0, width - 2 );
-                const int aiy = limit( iy, 0, height- 2 );
-                
-                const T* base = &(*this)[ { aix+0, aiy+0 } ];
-                const ColorBuffer c1 = base[0];      // { ix+0, iy+0 }
-                const ColorBuffer c2 = base[1];      // { ix+1, iy+0 }
-                const ColorBuffer c3 = base[width];  // { ix+0, iy+1 }
-                const ColorBuffer c4 = base[width+1];// { ix+1, iy+1 }
-
-                return (((c1*fx + c2*(1024-fx))>>10) * fy + ((c3*fx + c4*(1024-fx))>>10) * (1024-fy)) >> 10;
+                allocator->deallocate( memory, count * sizeof(T) );
             }
+            template <class U> bool operator==( const ScratchAllocator<U>& right ) const{ return allocator == right.allocator; }
+            template <class U> bool operator!=( const ScratchAllocator<U>& right ) const{ return allocator != right.allocator; }
+        };
+        
+        template <class T> using ScratchVector = std::vector< T, ScratchAllocator<T> >;
+        
+        // scratch array of default_allocator() that is not initialized. for buffers written before read.
+        template <class T> class ScratchBuffer
+        {
+        private:
+            ScratchAllocator< T > m_allocator;
+            T* m_data;
+            size_t m_count;
             
-            inline T get_bicubic_pixel( const float x, const float y, const bicubic_table& table=default_bicubic_table ) const
+        public:
+            explicit ScratchBuffer( const size_t count ) : m_data( m_allocator.allocate( count ) ), m_count( count ){}
+            ~ScratchBuffer(){ m_allocator.deallocate( m_data, m_count ); }
+            ScratchBuffer( const ScratchBuffer& ) = delete;
+            ScratchBuffer& operator=( const ScratchBuffer& ) = delete;
+            
+            inline T& operator[]( const size_t index ){ return m_data[index]; }
+            inline const T& operator[]( const size_t index ) const{ return m_data[index]; }
+        };
+        
+        // bands are not split below this height. a thread costs more than blurring a few rows.
+        static const int MIN_BAND_ROWS = 32;
+        
+        // [return] number of bands parallel_bands() splits count rows into.
+        inline static int band_count( const int count, const int threads )
+        {
+            return limit( count / MIN_BAND_ROWS, 1, fast_max( threads, 1 ) );
+        }
+        
+        /*
+         *  calls func( band, begin, end ) for each of band_count( count, threads ) bands of [0, count)
+         *  at the same time. this thread runs band 0 and the bands no thread could be started for.
+         *
+         *  [in]func must not throw. scratch buffers per band are allocated by the caller in advance,
+         *           because the default allocator of ScopedAllocator is per thread.
+         */
+        template <class Function>
+        static inline void parallel_bands( const int count, const int threads, const Function& func )
+        {
+            const int bands = band_count( count, threads );
+            auto begin = [count, bands]( const int band ){ return (int)((int64_t)count * band / bands); };
+            
+            std::vector< std::thread > workers;
+            int started = 1;
+            
+            try
             {
-                const int ix = (int)x;
-                const int iy = (int)y;
-                const float fx = x - (float)ix;
-                const float fy = y - (float)iy;
-                const int fx100 = (int)(fx * 100);
-                const int fy100 = (int)(fy * 100);
-                
-                const int x0 = fast_max( ix-1, 0 );
-                const int x1 = ix;
-                const int x2 = fast_min( ix+1, width-1 );
-                const int x3 = fast_min( ix+2, width-1 );
-
-                const int y0 = fast_max( iy-1, 0 );
-                const int y1 = iy;
-                const int y2 = fast_min( iy+1, height-1 );
-                const int y3 = fast_min( iy+2, height-1 );
-                
-                const ColorBuffer color[16] =
+                workers.reserve( bands - 1 );
+                for( ; started<bands; ++started )
                 {
-                    (*this)[ {x0, y0} ], (*this)[ {x1, y0} ], (*this)[ {x2, y0} ], (*this)[ {x3, y0} ],
-                    (*this)[ {x0, y1} ], (*this)[ {x1, y1} ], (*this)[ {x2, y1} ], (*this)[ {x3, y1} ],
-                    (*this)[ {x0, y2} ], (*this)[ {x1, y2} ], (*this)[ {x2, y2} ], (*this)[ {x3, y2} ],
-                    (*this)[ {x0, y3} ], (*this)[ {x1, y3} ], (*this)[ {x2, y3} ], (*this)[ {x3, y3} ],
-                };
-                
-                const int ti_x0 = fx100 + 100;
-                const int ti_x1 = fx100;
-                const int ti_x2 = 100 - fx100;
-                const int ti_x3 = 200 - fx100;
-
-                const int ti_y0 = fy100 + 100;
-                const int ti_y1 = fy100;
-                const int ti_y2 = 100 - fy100;
-                const int ti_y3 = 200 - fy100;
-
-                const int weight_x = table[ ti_x0 ] + table[ ti_x1 ] + table[ ti_x2 ] + table[ ti_x3 ];
-                const int weight_y = table[ ti_y0 ] + table[ ti_y1 ] + table[ ti_y2 ] + table[ ti_y3 ];
-                
-                const ColorBuffer result =
-                    ((
-                        color[ 0] * table[ ti_x0 ] + color[ 1] * table[ ti_x1 ] +
-                        color[ 2] * table[ ti_x2 ] + color[ 3] * table[ ti_x3 ]
-                    ) / weight_x ) * table[ ti_y0 ] +
-                
-                    ((
-                        color[ 4] * table[ ti_x0 ] + color[ 5] * table[ ti_x1 ] +
-                        color[ 6] * table[ ti_x2 ] + color[ 7] * table[ ti_x3 ]
-                    ) / weight_x ) * table[ ti_y1 ] +
-                
-                    ((
-                        color[ 8] * table[ ti_x0 ] + color[ 9] * table[ ti_x1 ] +
-                        color[10] * table[ ti_x2 ] + color[11] * table[ ti_x3 ]
-                    ) / weight_x ) * table[ ti_y2 ] +
-                
-                    ((
-                        color[12] * table[ ti_x0 ] + color[13] * table[ ti_x1 ] +
-                        color[14] * table[ ti_x2 ] + color[15] * table[ ti_x3 ]
-                    ) / weight_x) * table[ ti_y3 ];
+                    const int band = started;
+                    workers.emplace_back( [&func, &begin, band]{ func( band, begin( band ), begin( band+1 ) ); } );
+                }
+            }
+            catch( const std::system_error& )
+            {
+            }
             
-                return (result / weight_y).limit_min_max();
+            func( 0, 0, begin( 1 ) );
+            for( int band=started; band<bands; ++band )
+            {
+                func( band, begin( band ), begin( band+1 ) );
+            }
+            for( auto& worker : workers )
+            {
+                worker.join();
             }
+        }
+        
+        /*
+         *  ring of the radius*2+1 rows around one output row of a 2D kernel, each with radius
+         *  border columns on both sides. moving to the next output row loads only one row,
+         *  so the border is handled without a bordered copy of the image.
+         */
+        template <class T> class BorderRing
+        {
+        private:
+            ScratchVector< T > m_lines;
+            int m_radius;
+            int m_side;
+            int m_line;
+            Border m_border;
+            T m_color;
+            int m_center = 0;
+            bool m_loaded = false;
             
-            inline T get_bicubic_pixel_safe_out_of_range( const float x, const float y,
-                                                         const bicubic_table& table=default_bicubic_table ) const
+            // index of column 0 of row y.
+            inline size_t line( const int y ) const
             {
-                const int ix = (int)x;
-                const int iy = (int)y;
-                const float fx = x >= 0.0f ? 1.0f - (x - (float)ix) : 1.0f + (x - (float)ix);
-                const float fy = y >= 0.0f ? 1.0f - (y - (float)iy) : 1.0f + (y - (float)iy);
-                const int fx100 = (int)(fx * 100 + 100);
-                const int fy100 = (int)(fy * 100 + 100);
-                
-                const int x0 = limit( ix-1, 0, width -  1);
-                const int x1 = limit( ix  , 0, width -  1);
-                const int x2 = limit( ix+1, 0, width -  1);
-                const int x3 = limit( ix+2, 0, width -  1);
-                
-                const int y0 = limit( iy-1, 0, height - 1);
-                const int y1 = limit( iy  , 0, height - 1);
-                const int y2 = limit( iy+1, 0, height - 1);
-                const int y3 = limit( iy+2, 0, height - 1);
+                return (size_t)( ( y % m_side + m_side ) % m_side ) * m_line + m_radius;
+            }
+            
+            template <class View> void load( const View& image, const int y )
+            {
+                T* p_line = &m_lines[ line( y ) ];
+                const int index = border_index( y, image.height, m_border );
                 
-                const ColorBuffer color[16] =
+                if( index < 0 )
                 {
-                    (*this)[ {x0, y0} ], (*this)[ {x1, y0} ], (*this)[ {x2, y0} ], (*this)[ {x3, y0} ],
-                    (*this)[ {x0, y1} ], (*this)[ {x1, y1} ], (*this)[ {x2, y1} ], (*this)[ {x3, y1} ],
-                    (*this)[ {x0, y2} ], (*this)[ {x1, y2} ], (*this)[ {x2, y2} ], (*this)[ {x3, y2} ],
-                    (*this)[ {x0, y3} ], (*this)[ {x1, y3} ], (*this)[ {x2, y3} ], (*this)[ {x3, y3} ],
-                };
-                
-                const int ti_x0 = fx100 + 100;
-                const int ti_x1 = fx100;
-                const int ti_x2 = 100 - fx100;
-                const int ti_x3 = 200 - fx100;
-                
-                const int ti_y0 = fy100 + 100;
-                const int ti_y1 = fy100;
-                const int ti_y2 = 100 - fy100;
-                const int ti_y3 = 200 - fy100;
-                
-                const int weight_x = table[ ti_x0 ] + table[ ti_x1 ] + table[ ti_x2 ] + table[ ti_x3 ];
-                const int weight_y = table[ ti_y0 ] + table[ ti_y1 ] + table[ ti_y2 ] + table[ ti_y3 ];
-                
-                const ColorBuffer result =
-                    ((
-                      color[ 0] * table[ ti_x0 ] + color[ 1] * table[ ti_x1 ] +
-                      color[ 2] * table[ ti_x2 ] + color[ 3] * table[ ti_x3 ]
-                      ) / weight_x ) * table[ ti_y0 ] +
-                    
-                    ((
-                      color[ 4] * table[ ti_x0 ] + color[ 5] * table[ ti_x1 ] +
-                      color[ 6] * table[ ti_x2 ] + color[ 7] * table[ ti_x3 ]
-                      ) / weight_x ) * table[ ti_y1 ] +
-                    
-                    ((
-                      color[ 8] * table[ ti_x0 ] + color[ 9] * table[ ti_x1 ] +
-                      color[10] * table[ ti_x2 ] + color[11] * table[ ti_x3 ]
-                      ) / weight_x ) * table[ ti_y2 ] +
-                    
-                    ((
-                      color[12] * table[ ti_x0 ] + color[13] * table[ ti_x1 ] +
-                      color[14] * table[ ti_x2 ] + color[15] * table[ ti_x3 ]
-                      ) / weight_x) * table[ ti_y3 ];
-                
-                return (result / weight_y).limit_min_max();
+                    std::fill( p_line - m_radius, p_line + image.width + m_radius, m_color );
+                    return;
+                }
+                std::copy( image.row( index ), image.row( index ) + image.width, p_line );
+                fill_border_columns( p_line, image.width, m_radius, 1, m_border, &m_color );
             }
             
-        private:
-            void convert( const Image<GRAY,ColorBufferGRAY>& ){ throw std::bad_function_call(); }
-            void convert( const Image<RGB,ColorBufferRGB>& ){ throw std::bad_function_call(); }
-            void convert( const Image<HMB,ColorBufferHMB>& ){ throw std::bad_function_call(); }
-
         public:
-            template <class C, class B>
-            Image<T,ColorBuffer>& operator=( const Image<C,B>& image )
+            BorderRing( const int width, const int radius, const Border border, const T color )
+                : m_lines( (size_t)( width + radius*2 ) * ( radius*2 + 1 ) )
             {
-                create( image.size );
-                convert( image );
-                return *this;
+                m_radius = radius;
+                m_side   = radius*2 + 1;
+                m_line   = width + radius*2;
+                m_border = border;
+                m_color  = color;
             }
-
-            inline Image& operator=( Image&& value )
+            
+            // moves to output row y. image must be the same for every row.
+            template <class View> void seek( const View& image, const int y )
             {
-                (SizeI&)size = value.size;
-                (unsigned int&)length = value.length;
-                (int&)value.width = 0;
-                (int&)value.height = 0;
-                (SizeI&)value.size = SizeI();
-                (unsigned int&)value.length = 0;
-                m_data = std::move( value.m_data );
-                return *this;
+                if( m_loaded && y == m_center + 1 )
+                {
+                    load( image, y + m_radius );
+                }
+                else
+                {
+                    for( int i=-m_radius; i<=m_radius; ++i )
+                    {
+                        load( image, y+i );
+                    }
+                }
+                m_center = y;
+                m_loaded = true;
             }
             
-            inline Image& operator=( Move&& value )
+            // [return] column 0 of row center+dy. columns -radius to width+radius-1 are readable.
+            inline const T* row( const int dy ) const
             {
-                (SizeI&)size = value.size;
-                (unsigned int&)length = value.length;
-                (SizeI&)value.size = SizeI();
-                (unsigned int&)value.length = 0;
-                m_data = std::move( value.m_data );
-                return *this;
+                return &m_lines[ line( m_center + dy ) ];
+            }
+        };
+        
+        // exp() of x <= 0 for constant expressions. x is halved until the series converges fast.
+        static constexpr double constant_exp( double x )
+        {
+            int halving = 0;
+            for( ; x < -0.0625; ++halving )
+            {
+                x *= 0.5;
             }
             
-            inline void fill(const T color)
+            double term = 1.0;
+            double sum = 1.0;
+            for( int n=1; n<30; ++n )
             {
-                std::fill( m_data.begin(), m_data.end(), color );
+                term *= x / n;
+                sum += term;
             }
-           
-            void fill(const T color, const RectangleI& rectangle)
+            for( int i=0; i<halving; ++i )
             {
-                const int begin_x = fast_max( rectangle.point.x, 0 );
-                const int end_x   = fast_min( rectangle.point.x + rectangle.size.width, width );
-                const int begin_y = fast_max( rectangle.point.y, 0 );
-                const int end_y   = fast_min( rectangle.point.y + rectangle.size.height, height );
+                sum *= sum;
+            }
+            return sum;
+        }
+        
+        // sqrt() for constant expressions. value >= 0.
+        static constexpr double constant_sqrt( const double value )
+        {
+            double root = value > 1.0 ? value : 1.0;
+            for( int i=0; i<100; ++i )
+            {
+                root = 0.5 * ( root + value / root );
+            }
+            return root;
+        }
+        
+        /*
+         *  gaussian_kernel() of sigma RADIUS, built by the compiler. the integer weights are the same
+         *  as the ones of exp() for every radius up to 40.
+         */
+        template <int RADIUS> struct GaussianWeights
+        {
+            static const int TAPS = RADIUS*2 + 1;
+            int values[ TAPS ];
+            
+            constexpr GaussianWeights() : values()
+            {
+                const float sigma = (float)RADIUS;
+                const float pixel_distance_scale = 2.0f;
+                const double sigma_2_square = 2 * sigma * sigma;
+                const double root_sigma_square_pi = constant_sqrt( 2.0 * M_PI * sigma * sigma );
                 
-                for( int y = begin_y; y<end_y; ++y )
+                double sum = 0.0;
+                for( int i=0; i<TAPS; ++i )
                 {
-                    for( int x= begin_x; x<end_x; ++x )
-                    {
-                        (*this)[ {x, y} ] = color;
-                    }
+                    const double distance = (i-RADIUS) * pixel_distance_scale;
+                    
+                    sum += constant_exp( -(distance*distance / sigma_2_square) ) / root_sigma_square_pi;
                 }
-            }
-
-            void fill(const T color, const CircleF& circle)
-            {
-                const int begin_x = fast_max( (int)(circle.point.x - circle.radius-1),      0 );
-                const int end_x   = fast_min( (int)(circle.point.x + circle.radius+1),  width );
-                const int begin_y = fast_max( (int)(circle.point.y - circle.radius-1),      0 );
-                const int end_y   = fast_min( (int)(circle.point.y + circle.radius+1), height );
-                const float radius_square = circle.radius * circle.radius;
                 
-                for( int y = begin_y; y<end_y; ++y )
+                const double weight = 4096.0 / sum;
+                for( int i=0; i<TAPS; ++i )
                 {
-                    const float sub_y = y - circle.point.y;
-                    const float square_y = sub_y * sub_y;
-
-                    for( int x= begin_x; x<end_x; ++x )
-                    {
-                        const float sub_x = x - circle.point.x;
-                        const float square_x = sub_x * sub_x;
-                        
-                        if( square_x + square_y <= radius_square )
-                        {
-                            (*this)[ {x, y} ] = color;
-                        }
-                    }
+                    const double distance = (i-RADIUS) * pixel_distance_scale;
+                    
+                    values[i] = (int)(
+                        (constant_exp( -(distance*distance / sigma_2_square) ) / root_sigma_square_pi ) * weight);
                 }
             }
+        };
+        
+        // [return] true and the constant weights when sigma is one of the radii of unrolled_taps().
+        template <class Vector>
+        static inline bool constant_gaussian_kernel( const float sigma, Vector& kernel )
+        {
+            static constexpr GaussianWeights< 1 >  weights_1{};
+            static constexpr GaussianWeights< 2 >  weights_2{};
+            static constexpr GaussianWeights< 3 >  weights_3{};
+            static constexpr GaussianWeights< 5 >  weights_5{};
+            static constexpr GaussianWeights< 10 > weights_10{};
             
-            Move trimming( const RectangleI& rectangle ) const
+            const int* values = sigma == 1.0f  ? weights_1.values :
+                                sigma == 2.0f  ? weights_2.values :
+                                sigma == 3.0f  ? weights_3.values :
+                                sigma == 5.0f  ? weights_5.values :
+                                sigma == 10.0f ? weights_10.values : nullptr;
+            if( values == nullptr )
             {
-                Image output( rectangle.size );
-
-                for( int y=0; y<output.height; ++y )
-                {
-                    memcpy(
-                           &output[{0,y}],
-                           &(*this)[{rectangle.point.x,rectangle.point.y+y}],
-                           sizeof(T)*rectangle.size.width );
-                }
-                return std::move(output);
+                return false;
             }
-    
-            Move resize( const SizeI& size, const Interpolation interpo = Interpolation::bicubic ) const
+            kernel.resize( (int)sigma * 2 + 1 );
+            std::copy( values, values + kernel.size(), &kernel[0] );
+            return true;
+        }
+        
+        /*
+         *  [return] radius of the kernel. 0 means that sigma does not blur.
+         *
+         *  [in]sigma
+         *
+         *  [out]kernel
+         *       radius*2+1 integer weights. the sum is about 4096.
+         */
+        template <class Vector>
+        static inline int gaussian_kernel( const float sigma, Vector& kernel )
+        {
+            const float pixel_distance_scale = 2.0f;
+            const int radius = (int)( sigma / pixel_distance_scale * 2.0f );
+            
+            if( constant_gaussian_kernel( sigma, kernel ) )
             {
-                if( size.width <= 0 )
-                {
-                    throw std::range_error( "resize : size.width <= 0" );
-                }
-                if( size.height <= 0)
-                {
-                    throw std::range_error( "resize : size.height <= 0" );
-                }
+                return radius;
+            }
+            
+            kernel.resize( radius * 2 + 1 );
+            if( radius == 0 )
+            {
+                return 0;
+            }
+            
+            const double sigma_2_square = 2 * sigma * sigma;
+            double root_sigma_square_pi = sqrt(2.0 * M_PI * sigma * sigma);
+            
+            double sum = 0.0;
+            for( int i=0; i<(int)kernel.size(); ++i )
+            {
+                double distance = (i-radius) * pixel_distance_scale;
                 
-                Image output( size );
+                sum += exp( -(distance*distance / sigma_2_square) ) / root_sigma_square_pi;
+            }
+            
+            const double weight = 4096.0 / sum;
+            for( int i=0; i<(int)kernel.size(); ++i )
+            {
+                double distance = (i-radius) * pixel_distance_scale;
                 
-                if( this->size == size )
-                {
-                    output = *this;
-                }
-                else
+                kernel[i] = (int)(
+                    (exp( -(distance*distance / sigma_2_square) ) / root_sigma_square_pi ) * weight);
+            }
+            return radius;
+        }
+        
+        // [return] standard deviation in pixels of a kernel of gaussian_kernel().
+        template <class Vector>
+        static inline double kernel_deviation( const Vector& kernel )
+        {
+            const int radius = (int)kernel.size() / 2;
+            double sum = 0.0;
+            double moment = 0.0;
+            
+            for( int i=0; i<(int)kernel.size(); ++i )
+            {
+                sum    += kernel[i];
+                moment += (double)kernel[i] * (i-radius) * (i-radius);
+            }
+            return sum > 0.0 ? sqrt( moment / sum ) : 0.0;
+        }
+        
+        // [return] scale of the two passes of a kernel of gaussian_kernel(). (sum/4096)^2
+        template <class Vector>
+        static inline double kernel_gain( const Vector& kernel )
+        {
+            double sum = 0.0;
+            for( int i=0; i<(int)kernel.size(); ++i )
+            {
+                sum += kernel[i];
+            }
+            return ( sum / 4096.0 ) * ( sum / 4096.0 );
+        }
+        
+        // [return] sigma of gaussian() whose kernel has the deviation in pixels. 0 below half a pixel.
+        static inline float gaussian_sigma( const double deviation )
+        {
+            // the kernel is cut at 2 deviations, so its deviation is a little less than sigma/2.
+            float sigma = (float)( deviation * 2.2 );
+            
+            for( int i=0; i<3 && sigma >= 1.0f; ++i )
+            {
+                std::vector< int > kernel;
+                gaussian_kernel( sigma, kernel );
+                sigma *= (float)( deviation / kernel_deviation( kernel ) );
+            }
+            return sigma >= 1.0f ? sigma : 0.0f;
+        }
+        
+        /*
+         *  recursive gaussian of Young and van Vliet. a line is filtered forward and then backward by
+         *    w[n] = B*x[n] + b1*w[n-1] + b2*w[n-2] + b3*w[n-3]
+         *  so the cost per pixel does not depend on the deviation.
+         */
+        struct RecursiveGaussian
+        {
+            float B;
+            float b1, b2, b3;
+            float gain; // applied to the input. the integer FIR kernel sums to a little less than 1.
+            int pad;    // pixels read beyond each end of a line. the start state decays within them.
+            
+            RecursiveGaussian( const double deviation, const double gain )
+            {
+                const double s = deviation < 0.5 ? 0.5 : deviation;
+                const double q = s >= 2.5 ? 0.98711 * s - 0.96330 : 3.97156 - 4.14554 * sqrt( 1.0 - 0.26891 * s );
+                const double b0 = 1.57825 + 2.44413*q + 1.4281*q*q + 0.422205*q*q*q;
+                
+                b1 = (float)( ( 2.44413*q + 2.85619*q*q + 1.26661*q*q*q ) / b0 );
+                b2 = (float)( -( 1.4281*q*q + 1.26661*q*q*q ) / b0 );
+                b3 = (float)( 0.422205*q*q*q / b0 );
+                B  = 1.0f - ( b1 + b2 + b3 );
+                pad = (int)( s * 4.0 ) + 3;
+                this->gain = (float)gain;
+            }
+        };
+        
+        /*
+         *  one step of the recursion for count floats of rows side by side.
+         *  [out]output = B*input + b1*w1 + b2*w2 + b3*w3. may be input.
+         */
+        static inline void recursive_gaussian_row( const float* input, const float* w1, const float* w2, const float* w3,
+                                                   float* output, const int count, const RecursiveGaussian& g )
+        {
+            const float B = g.B, b1 = g.b1, b2 = g.b2, b3 = g.b3;
+            
+            for( int x=0; x<count; ++x )
+            {
+                output[x] = B * input[x] + b1 * w1[x] + b2 * w2[x] + b3 * w3[x];
+            }
+        }
+        
+        // integer channels are rounded down like the FIR path.
+        inline static void store_channel( uint8_t& channel, const float value )
+        {
+            channel = (uint8_t)limit( (int)value, 0, 255 );
+        }
+        inline static void store_channel( float& channel, const float value )
+        {
+            channel = value;
+        }
+        
+        /*
+         *  forward and backward recursion over lines of count floats side by side.
+         *  both directions start from the steady state of their first line.
+         *
+         *  [in]source(i)       line i of lines.
+         *  [in]store(i, line)  receives the result of line i, from the last line to the first.
+         *  [in]p_forward       lines*count floats. p_backward 4*count floats.
+         */
+        template <class Source, class Store>
+        static inline void recursive_gaussian_lines( const int lines, const int count, const RecursiveGaussian& g,
+                                                     const Source& source, const Store& store,
+                                                     float* p_forward, float* p_backward )
+        {
+            auto forward  = [p_forward, count]( const int i ){ return p_forward + (size_t)i*count; };
+            auto backward = [p_backward, count]( const int i ){ return p_backward + (size_t)( i & 3 )*count; };
+            
+            const float* first = source( 0 );
+            for( int i=0; i<lines; ++i )
+            {
+                recursive_gaussian_row( source( i ),
+                                        i >= 1 ? forward( i-1 ) : first,
+                                        i >= 2 ? forward( i-2 ) : first,
+                                        i >= 3 ? forward( i-3 ) : first, forward( i ), count, g );
+            }
+            
+            const float* last = forward( lines-1 );
+            for( int i=lines-1; i>=0; --i )
+            {
+                recursive_gaussian_row( forward( i ),
+                                        i+1 < lines ? backward( i+1 ) : last,
+                                        i+2 < lines ? backward( i+2 ) : last,
+                                        i+3 < lines ? backward( i+3 ) : last, backward( i ), count, g );
+                store( i, (const float*)backward( i ) );
+            }
+        }
+        
+        /*
+         *  horizontal pass of the recursive gaussian. ROWS rows are filtered side by side,
+         *  so the recursion runs over vectors of ROWS*CHANNEL floats.
+         *
+         *  [in]input   rows of width*CHANNEL values.
+         *  [in]color   CHANNEL values of Border::constant.
+         *  [out]output rows of width*CHANNEL floats, one after another. multiplied by the gain.
+         */
+        template <int CHANNEL, class Channel>
+        static inline void recursive_gaussian_rows( const Channel* input, const ptrdiff_t input_stride,
+                                                    const int width, const int height, const RecursiveGaussian& g,
+                                                    const int threads, const Border border, const float* color, float* output )
+        {
+            const int ROWS = 8;
+            const int STEP = ROWS*CHANNEL;
+            const int pad = g.pad;
+            const int lines = width + pad*2;
+            const int bands = band_count( height, threads );
+            ScratchBuffer< float > buffer( (size_t)( lines*2 + 4 ) * STEP * bands );
+            
+            parallel_bands( height, threads, [&]( const int band, const int begin, const int end )
+            {
+                float* p_gather  = &buffer[ (size_t)( lines*2 + 4 ) * STEP * band ];
+                float* p_forward = p_gather + (size_t)lines * STEP;
+                float* p_backward = p_forward + (size_t)lines * STEP;
+                const float gain = g.gain;
+                
+                for( int y0=begin; y0<end; y0+=ROWS )
                 {
-                    const float x_step = (float)(width  - 1) / (size.width  - 1);
-                    const float y_step = (float)(height - 1) / (size.height - 1);
-                    
-                    float y_pos = 0;
-                    T* p_output = &output[0];
+                    const int rows = fast_min( ROWS, end - y0 );
                     
-                    if( interpo == Interpolation::nearest )
-                    {
-                        for( int y=0; y<size.height; ++y, y_pos += y_step )
-                        {
-                            float x_pos = 0;
-                            for( int x=0; x<size.width; ++x, x_pos += x_step, ++p_output )
-                            {
-                                *p_output = get_nearest_pixel( x_pos, y_pos );
-                            }
-                        }
-                    }
-                    if( interpo == Interpolation::bilinear )
+                    // column x of row y0+r is at line x+pad, r*CHANNEL. missing rows are 0.
+                    if( rows < ROWS )
                     {
-                        for( int y=0; y<size.height; ++y, y_pos += y_step )
-                        {
-                            float x_pos = 0;
-                            for( int x=0; x<size.width; ++x, x_pos += x_step, ++p_output )
-                            {
-                                *p_output = get_bilinear_pixel( x_pos, y_pos );
-                            }
-                        }
+                        std::fill( p_gather, p_gather + (size_t)lines * STEP, 0.0f );
                     }
-                    if( interpo == Interpolation::bicubic )
+                    for( int r=0; r<rows; ++r )
                     {
-                        for( int y=0; y<size.height; ++y, y_pos += y_step )
+                        const Channel* p_input = offset_row( input, (y0+r)*input_stride );
+                        
+                        for( int x=-pad; x<width+pad; ++x )
                         {
-                            float x_pos = 0;
-                            for( int x=0; x<size.width; ++x, x_pos += x_step, ++p_output )
+                            const int index = x >= 0 && x < width ? x : border_index( x, width, border );
+                            float* p_line = p_gather + (size_t)( x+pad ) * STEP + r*CHANNEL;
+                            
+                            for( int c=0; c<CHANNEL; ++c )
                             {
-                                *p_output = get_bicubic_pixel( x_pos, y_pos );
+                                p_line[c] = gain * ( index < 0 ? color[c] : (float)p_input[ index*CHANNEL + c ] );
                             }
                         }
                     }
-                    if( interpo == Interpolation::super )
-                    {
-                        int y_pos_super =  0;
-
-                        const int x_step_super = (int)((float)width  / (size.width)  * 1024);
-                        const int y_step_super = (int)((float)height / (size.height) * 1024);
-
-                        for( int y=0; y<size.height; ++y, y_pos_super += y_step_super )
+                    
+                    recursive_gaussian_lines( lines, STEP, g,
+                        [p_gather, STEP]( const int i ){ return (const float*)( p_gather + (size_t)i*STEP ); },
+                        [&]( const int i, const float* p_line )
                         {
-                            int x_pos_super = 0;
-
-                            for( int x=0; x<size.width; ++x, x_pos_super += x_step_super, ++p_output )
+                            const int x = i - pad;
+                            if( x >= 0 && x < width )
                             {
-                                ColorBuffer color;
-                                int weight = 0;
-                                int y_rem = 1024 - (y_pos_super - (y_pos_super&0xFFFFFC00));
-                                int y_area = y_step_super;
-                                
-                                for( int yy=(y_pos_super>>10); y_area > 0; ++yy )
+                                for( int r=0; r<rows; ++r )
                                 {
-                                    int x_rem = 1024 - (x_pos_super - (x_pos_super&0xFFFFFC00));
-
-                                    if( y_area <= 1024 )
-                                    {
-                                        y_rem = y_area;
-                                    }
-                                    y_area -= y_rem;
+                                    float* p_output = output + ( (size_t)( y0+r ) * width + x ) * CHANNEL;
                                     
-                                    int x_area = x_step_super;
-                                    
-                                    for( int xx=(x_pos_super>>10); x_area > 0; ++xx )
+                                    for( int c=0; c<CHANNEL; ++c )
                                     {
-                                        if( x_area <= 1024 )
-                                        {
-                                            x_rem = x_area;
-                                        }
-                                        color += ColorBuffer( (*this)[{xx,yy}] ) * ((x_rem*y_rem)>>10);
-                                        weight += ((x_rem*y_rem) >> 10);
-                                        x_area -= x_rem;
-                                        x_rem = 1024;
+                                        p_output[c] = p_line[ r*CHANNEL + c ];
                                     }
-                                    y_rem = 1024;
                                 }
-                                *p_output = color / weight;
                             }
-                        }
-                    }
+                        }, p_forward, p_backward );
                 }
-                return std::move(output);
-            }
-
-            inline Move resize( const float scaling, const Interpolation interpo = Interpolation::bicubic ) const
+            } );
+        }
+        
+        /*
+         *  vertical pass of the recursive gaussian, over blocks of columns side by side.
+         *
+         *  [in]input   rows of width*CHANNEL floats by recursive_gaussian_rows().
+         *  [in]color   CHANNEL values of Border::constant.
+         *  [out]output rows of width*CHANNEL values.
+         */
+        template <int CHANNEL, class Channel>
+        static inline void recursive_gaussian_columns( const float* input, const int width, const int height,
+                                                       const RecursiveGaussian& g, const int threads,
+                                                       const Border border, const float* color,
+                                                       Channel* output, const ptrdiff_t output_stride )
+        {
+            // 16 pixels of every row of a block stay in the L2 cache.
+            const int BLOCK = 16*CHANNEL;
+            const int pad = g.pad;
+            const int lines = height + pad*2;
+            const int count = width*CHANNEL;
+            const int blocks = ( count + BLOCK - 1 ) / BLOCK;
+            const int bands = band_count( blocks, threads );
+            ScratchBuffer< float > buffer( (size_t)( lines + 4 ) * BLOCK * bands );
+            ScratchVector< float > color_row( BLOCK );
+            
+            for( int x=0; x<BLOCK; ++x )
             {
-                return resize( {width*scaling+0.5f, height*scaling+0.5f}, interpo );
+                color_row[x] = g.gain * color[ x % CHANNEL ];
             }
             
-            Move mirror_border( const int width_radius, const int height_radius ) const
+            parallel_bands( blocks, threads, [&]( const int band, const int begin, const int end )
             {
-                if( width_radius > width )
+                float* p_forward = &buffer[ (size_t)( lines + 4 ) * BLOCK * band ];
+                float* p_backward = p_forward + (size_t)lines * BLOCK;
+                
+                for( int block=begin; block<end; ++block )
                 {
-                    throw std::range_error( "mirror_border : width_radius > width" );
+                    const int x0 = block * BLOCK;
+                    const int block_count = fast_min( BLOCK, count - x0 );
+                    
+                    recursive_gaussian_lines( lines, block_count, g,
+                        [&]( const int i )
+                        {
+                            const int index = border_index( i-pad, height, border );
+                            return index < 0 ? &color_row[0] : input + (size_t)count*index + x0;
+                        },
+                        [&]( const int i, const float* p_line )
+                        {
+                            const int y = i - pad;
+                            if( y >= 0 && y < height )
+                            {
+                                Channel* p_output = offset_row( output, y*output_stride ) + x0;
+                                
+                                for( int x=0; x<block_count; ++x )
+                                {
+                                    store_channel( p_output[x], p_line[x] );
+                                }
+                            }
+                        }, p_forward, p_backward );
                 }
-                if( height_radius > height )
+            } );
+        }
+        
+        inline static std::atomic< int >& recursive_gaussian_radius_setting()
+        {
+            static std::atomic< int > radius( 32 );
+            return radius;
+        }
+        
+        // [return] kernel radius from which gaussian() runs gaussian_recursive().
+        // 32 is where the 8bit SIMD kernel gets slower. the scalar kernels cross at about 6.
+        inline static int recursive_gaussian_radius()
+        {
+            return recursive_gaussian_radius_setting().load( std::memory_order_relaxed );
+        }
+        
+        // [in]radius 1 or more. INT_MAX keeps every gaussian() on the FIR kernel.
+        inline static void set_recursive_gaussian_radius( const int radius )
+        {
+            if( radius < 1 )
+            {
+                throw std::range_error( "set_recursive_gaussian_radius : radius < 1" );
+            }
+            recursive_gaussian_radius_setting().store( radius );
+        }
+        
+        /*
+         *  radii of three box filters whose cascade has the given deviation. (Kovesi)
+         *  the widths are odd and differ by at most 2 pixels.
+         *
+         *  [out]radii 3 radii. a box is radius*2+1 pixels wide.
+         */
+        static inline void box_cascade_radii( const double deviation, int* radii )
+        {
+            const int n = 3;
+            const double variance = deviation * deviation;
+            
+            int lower = (int)sqrt( 12.0*variance/n + 1.0 );
+            if( lower % 2 == 0 )
+            {
+                lower -= 1;
+            }
+            const int count = (int)floor( ( 12.0*variance - n*lower*lower - 4.0*n*lower - 3.0*n ) / ( -4.0*lower - 4.0 ) + 0.5 );
+            
+            for( int i=0; i<n; ++i )
+            {
+                radii[i] = ( ( i < count ? lower : lower + 2 ) - 1 ) / 2;
+            }
+        }
+        
+        // sums of the box filters. integer channels carry 8 fractional bits between the passes.
+        template <class Channel> struct BoxSum
+        {
+            using Type = int;
+            static float scale(){ return 256.0f; }
+        };
+        template <> struct BoxSum< float >
+        {
+            using Type = float;
+            static float scale(){ return 1.0f; }
+        };
+        
+        // differences of two channels. a band of a laplacian pyramid.
+        template <class Channel> struct ChannelDifference
+        {
+            using Type = int16_t;
+        };
+        template <> struct ChannelDifference< float >
+        {
+            using Type = float;
+        };
+        
+        inline static void store_box( int& sum, const float value )
+        {
+            sum = (int)( value + 0.5f );
+        }
+        inline static void store_box( float& sum, const float value )
+        {
+            sum = value;
+        }
+        
+        /*
+         *  one box filter down count columns side by side. the running sum is a row, so it vectorizes.
+         *
+         *  [in]input  height rows of pitch values, from the first column.
+         *  [in]color  count values of Border::constant.
+         *  [in]p_sum  count values of scratch.
+         *  [in]store(y, sum) receives the sum of the box around row y.
+         */
+        template <class Sum, class Store>
+        static inline void box_columns( const Sum* input, const ptrdiff_t pitch, const int count, const int height,
+                                        const int radius, const Border border, const Sum* color, Sum* p_sum,
+                                        const Store& store )
+        {
+            auto line = [&]( const int y )
+            {
+                const int index = border_index( y, height, border );
+                return index < 0 ? color : input + pitch*index;
+            };
+            
+            std::fill( p_sum, p_sum + count, (Sum)0 );
+            for( int i=-radius; i<=radius; ++i )
+            {
+                const Sum* p_line = line( i );
+                for( int x=0; x<count; ++x )
                 {
-                    throw std::range_error( "mirror_border : height_radius > height" );
+                    p_sum[x] += p_line[x];
                 }
-                Image output( {width+width_radius*2, height+height_radius*2} );
+            }
+            for( int y=0; y<height; ++y )
+            {
+                store( y, (const Sum*)p_sum );
                 
-                int x, y;
-                for( y=-height_radius; y<height; ++y )
+                if( y+1 < height )
                 {
-                    for( x=-width_radius; x<width; ++x )
-                    {
-                        output[ {x+width_radius,y+height_radius} ] = (*this)[{fast_abs(x), fast_abs(y)}];
-                    }
-
-                    for( int sx = x-1; x<output.width; ++x, --sx )
+                    const Sum* p_add = line( y+radius+1 );
+                    const Sum* p_sub = line( y-radius );
+                    for( int x=0; x<count; ++x )
                     {
-                        output[ {x+width_radius,y+height_radius} ] = (*this)[{sx, fast_abs(y)}];
+                        p_sum[x] += p_add[x] - p_sub[x];
                     }
                 }
-
-                int sy = y - 1;
-                y += height_radius;
+            }
+        }
+        
+        /*
+         *  horizontal pass of the box cascade. ROWS rows are gathered side by side,
+         *  so the filters run down lines of ROWS*CHANNEL sums like box_columns() does.
+         *
+         *  [in]radii   3 radii of box_cascade_radii().
+         *  [in]color   CHANNEL sums of Border::constant.
+         *  [out]output rows of width*CHANNEL sums, one after another.
+         */
+        template <int CHANNEL, class Channel, class Sum>
+        static inline void box_gaussian_rows( const Channel* input, const ptrdiff_t input_stride,
+                                              const int width, const int height, const int* radii,
+                                              const int threads, const Border border, const Sum* color, Sum* output )
+        {
+            const int ROWS = 8;
+            const int STEP = ROWS*CHANNEL;
+            const float scale = BoxSum< Channel >::scale();
+            const int count = width*CHANNEL;
+            const size_t scratch = (size_t)STEP * ( width*2 + 1 );
+            const int bands = band_count( height, threads );
+            ScratchBuffer< Sum > buffer( scratch * bands );
+            Sum color_row[ STEP ];
+            
+            for( int x=0; x<STEP; ++x )
+            {
+                color_row[x] = color[ x % CHANNEL ];
+            }
+            
+            parallel_bands( height, threads, [&]( const int band, const int begin, const int end )
+            {
+                Sum* p_gather = &buffer[ scratch * band ];
+                Sum* p_middle = p_gather + (size_t)STEP * width;
+                Sum* p_sum = p_middle + (size_t)STEP * width;
                 
-                for( ; y<output.height; ++y, --sy )
+                for( int y0=begin; y0<end; y0+=ROWS )
                 {
-                    for( x=-width_radius; x<width; ++x )
+                    const int rows = fast_min( ROWS, end - y0 );
+                    
+                    // column x of row y0+r is at line x, r*CHANNEL. missing rows are 0.
+                    if( rows < ROWS )
                     {
-                        output[ {x+width_radius,y} ] = (*this)[{fast_abs(x), sy}];
+                        std::fill( p_gather, p_gather + (size_t)STEP * width, (Sum)0 );
+                    }
+                    for( int r=0; r<rows; ++r )
+                    {
+                        const Channel* p_input = offset_row( input, (y0+r)*input_stride );
+                        
+                        for( int x=0; x<width; ++x )
+                        {
+                            for( int c=0; c<CHANNEL; ++c )
+                            {
+                                store_box( p_gather[ x*STEP + r*CHANNEL + c ], (float)p_input[ x*CHANNEL + c ] * scale );
+                            }
+                        }
                     }
-                    for( int sx = x-1; x<output.width; ++x, --sx )
+                    
+                    // gather -> middle -> gather -> output.
+                    for( int i=0; i<2; ++i )
                     {
-                        output[ {x,y} ] = (*this)[{sx, sy}];
+                        Sum* p_output = i == 0 ? p_middle : p_gather;
+                        const float mean = 1.0f / ( radii[i]*2 + 1 );
+                        
+                        box_columns( i == 0 ? p_gather : p_middle, STEP, STEP, width, radii[i], border, color_row, p_sum,
+                            [p_output, STEP, mean]( const int x, const Sum* p_sum )
+                            {
+                                Sum* p_line = p_output + (size_t)STEP * x;
+                                for( int i=0; i<STEP; ++i )
+                                {
+                                    store_box( p_line[i], p_sum[i] * mean );
+                                }
+                            } );
                     }
+                    const float mean = 1.0f / ( radii[2]*2 + 1 );
+                    box_columns( p_gather, STEP, STEP, width, radii[2], border, color_row, p_sum,
+                        [&]( const int x, const Sum* p_sum )
+                        {
+                            for( int r=0; r<rows; ++r )
+                            {
+                                Sum* p_output = output + (size_t)count * ( y0+r ) + x*CHANNEL;
+                                
+                                for( int c=0; c<CHANNEL; ++c )
+                                {
+                                    store_box( p_output[c], p_sum[ r*CHANNEL + c ] * mean );
+                                }
+                            }
+                        } );
                 }
-                return std::move(output);
+            } );
+        }
+        
+        /*
+         *  vertical pass of the box cascade, over blocks of columns side by side.
+         *  the first two filters of a block write to scratch of the block alone, so it stays in the cache.
+         *
+         *  [in]input   rows of width*CHANNEL sums by box_gaussian_rows().
+         *  [in]color   CHANNEL sums of Border::constant.
+         *  [in]gain    scale of the result.
+         *  [out]output rows of width*CHANNEL values.
+         */
+        template <int CHANNEL, class Channel, class Sum>
+        static inline void box_gaussian_columns( const Sum* input, const int width, const int height, const int* radii,
+                                                 const double gain, const int threads, const Border border,
+                                                 const Sum* color, Channel* output, const ptrdiff_t output_stride )
+        {
+            // a whole number of pixels, so the color row lines up with every block.
+            const int BLOCK = 32*CHANNEL;
+            const int count = width*CHANNEL;
+            const int blocks = ( count + BLOCK - 1 ) / BLOCK;
+            const int bands = band_count( blocks, threads );
+            const size_t scratch = (size_t)BLOCK * ( height*2 + 1 );
+            ScratchBuffer< Sum > buffer( scratch * bands );
+            ScratchVector< Sum > color_row( BLOCK );
+            const float last = (float)( gain / ( radii[2]*2 + 1 ) / BoxSum< Channel >::scale() );
+            
+            for( int x=0; x<BLOCK; ++x )
+            {
+                color_row[x] = color[ x % CHANNEL ];
             }
             
-            Move filter( const std::vector< float >& kernel ) const
+            parallel_bands( blocks, threads, [&]( const int band, const int begin, const int end )
             {
-                const int side = (int)sqrt( kernel.size() );
-                const int radius = side / 2;
-                
-                Image output( size );
-                Image temp = mirror_border( radius, radius );
-                std::vector< int > ikernel( kernel.size() );
+                Sum* p_first = &buffer[ scratch * band ];
+                Sum* p_second = p_first + (size_t)BLOCK * height;
+                Sum* p_sum = p_second + (size_t)BLOCK * height;
                 
-                for( size_t i=0; i<kernel.size(); ++i )
-                {
-                    ikernel[i] = (int)(kernel[i] * 1024.0f);
-                }
-                
-                for( int y=0; y<height; ++y )
+                for( int block=begin; block<end; ++block )
                 {
-                    for( int x=0; x<width; ++x )
+                    const int x0 = block * BLOCK;
+                    const int block_count = fast_min( BLOCK, count - x0 );
+                    
+                    // input -> first -> second -> output.
+                    for( int i=0; i<2; ++i )
                     {
-                        ColorBuffer color;
-                        for( int i=0; i<side; ++i )
+                        Sum* p_output = i == 0 ? p_first : p_second;
+                        const float mean = 1.0f / ( radii[i]*2 + 1 );
+                        
+                        box_columns( i == 0 ? input + x0 : p_first, i == 0 ? count : BLOCK, block_count, height,
+                                     radii[i], border, &color_row[0], p_sum,
+                            [p_output, BLOCK, block_count, mean]( const int y, const Sum* p_sum )
+                            {
+                                Sum* p_line = p_output + (size_t)BLOCK * y;
+                                for( int x=0; x<block_count; ++x )
+                                {
+                                    store_box( p_line[x], p_sum[x] * mean );
+                                }
+                            } );
+                    }
+                    box_columns( p_second, BLOCK, block_count, height, radii[2], border, &color_row[0], p_sum,
+                        [output, output_stride, x0, block_count, last]( const int y, const Sum* p_sum )
                         {
-                            const int tx = x+i;
-                            
-                            for( int j=0; j<side; ++j )
+                            Channel* p_line = offset_row( output, y*output_stride ) + x0;
+                            for( int x=0; x<block_count; ++x )
                             {
-                                const int ty = y+j;
-                                
-                                color += temp[ {tx, ty} ] * ikernel[ i*side + j ];
+                                store_channel( p_line[x], p_sum[x] * last );
                             }
-                        }
-                        output[ {x,y} ] = (color >> 10).limit();
-                    }
+                        } );
                 }
-                return std::move( output );
+            } );
+        }
+        
+        enum class SimdLevel
+        {
+            none,
+            sse41,
+            avx2,
+        };
+        
+        inline static std::atomic< SimdLevel >& simd_level_setting()
+        {
+#if defined( GAZO_SHORI_X86_SIMD )
+            static std::atomic< SimdLevel > level(
+                __builtin_cpu_supports( "avx2" )   ? SimdLevel::avx2  :
+                __builtin_cpu_supports( "sse4.1" ) ? SimdLevel::sse41 : SimdLevel::none );
+#else
+            static std::atomic< SimdLevel > level( SimdLevel::none );
+#endif
+            return level;
+        }
+        
+        // the best level of this CPU, or lower when set_simd_level() limited it.
+        inline static SimdLevel simd_level()
+        {
+            return simd_level_setting().load( std::memory_order_relaxed );
+        }
+        
+        // SimdLevel::none runs the scalar reference code. levels the CPU lacks are ignored.
+        inline static void set_simd_level( const SimdLevel level )
+        {
+            SimdLevel supported = SimdLevel::none;
+#if defined( GAZO_SHORI_X86_SIMD )
+            supported = __builtin_cpu_supports( "avx2" )   ? SimdLevel::avx2  :
+                        __builtin_cpu_supports( "sse4.1" ) ? SimdLevel::sse41 : SimdLevel::none;
+#endif
+            simd_level_setting().store( (int)level < (int)supported ? level : supported );
+        }
+        
+        inline static std::atomic< int >& vertical_block_setting()
+        {
+            static std::atomic< int > columns( 1024 );
+            return columns;
+        }
+        
+        /*
+         *  [return] columns of one block of the vertical filters. the sums of a block are
+         *           accumulated row by row, so they stay in the cache for every tap.
+         */
+        inline static int vertical_block()
+        {
+            return vertical_block_setting().load( std::memory_order_relaxed );
+        }
+        
+        // [in]columns 1 or more. a value wider than the image accumulates whole rows.
+        inline static void set_vertical_block( const int columns )
+        {
+            if( columns < 1 )
+            {
+                throw std::range_error( "set_vertical_block : columns < 1" );
+            }
+            vertical_block_setting().store( columns );
+        }
+        
+        inline static std::atomic< float >& filter_tolerance_setting()
+        {
+            static std::atomic< float > tolerance( 1.0f / 2048.0f );
+            return tolerance;
+        }
+        
+        /*
+         *  [return] largest error of a kernel weight that ImageView::filter() accepts when it splits a kernel
+         *           into separable passes. half of the 1/1024 steps of the weights by default.
+         */
+        inline static float filter_tolerance()
+        {
+            return filter_tolerance_setting().load( std::memory_order_relaxed );
+        }
+        
+        // [in]tolerance 0 or more. 0 runs every kernel by the 2D loop.
+        inline static void set_filter_tolerance( const float tolerance )
+        {
+            if( !( tolerance >= 0.0f ) )
+            {
+                throw std::range_error( "set_filter_tolerance : tolerance < 0.0f" );
+            }
+            filter_tolerance_setting().store( tolerance );
+        }
+        
+        inline static std::atomic< int >& fft_filter_radius_setting()
+        {
+            static std::atomic< int > radius( 4 );
+            return radius;
+        }
+        
+        /*
+         *  [return] smallest kernel radius of ImageView::filter() that may run by FFT convolution.
+         *           it does when the transforms take less work than the direct taps for the image size.
+         */
+        inline static int fft_filter_radius()
+        {
+            return fft_filter_radius_setting().load( std::memory_order_relaxed );
+        }
+        
+        // [in]radius 1 or more. INT_MAX keeps every kernel on the direct taps.
+        inline static void set_fft_filter_radius( const int radius )
+        {
+            if( radius < 1 )
+            {
+                throw std::range_error( "set_fft_filter_radius : radius < 1" );
             }
+            fft_filter_radius_setting().store( radius );
+        }
+        
+        /*
+         *  splits a side*side kernel into a sum of separable passes, the largest singular values first.
+         *  a term is found by power iteration and subtracted, until no weight is off by more than tolerance.
+         *
+         *  [return] number of passes. 0 when more than max_passes are needed.
+         *
+         *  [in]kernel     weight of column i of row j at kernel[ i*side + j ], as ImageView::filter() reads it.
+         *  [in]max_passes (side-1)/2 passes take as many taps as the kernel itself.
+         *  [out]vertical   side weights over the rows for every pass.
+         *  [out]horizontal side weights over the columns for every pass.
+         */
+        static inline int separable_kernel( const std::vector< float >& kernel, const int side, const float tolerance,
+                                            const int max_passes,
+                                            std::vector< float >& vertical, std::vector< float >& horizontal )
+        {
+            std::vector< double > residual( kernel.begin(), kernel.end() );
+            auto weight = [&]( const int j, const int i ) -> double& { return residual[ i*side + j ]; };
             
-            Move gaussian( const float sigma ) const
+            vertical.clear();
+            horizontal.clear();
+            
+            for( int pass=0; ; ++pass )
             {
-                if( sigma < 0.0f )
+                double error = 0.0;
+                int largest_row = 0;
+                double largest_norm = -1.0;
+                
+                for( int j=0; j<side; ++j )
                 {
-                    throw std::range_error( "gaussian : sigma < 0.0f" );
+                    double norm = 0.0;
+                    for( int i=0; i<side; ++i )
+                    {
+                        error = std::max( error, std::abs( weight( j, i ) ) );
+                        norm += weight( j, i ) * weight( j, i );
+                    }
+                    if( norm > largest_norm )
+                    {
+                        largest_norm = norm;
+                        largest_row = j;
+                    }
+                }
+                if( error <= tolerance )
+                {
+                    return pass;
+                }
+                if( pass == max_passes )
+                {
+                    return 0;
                 }
                 
-                Image output( size );
-                
-                const float pixel_distance_scale = 2.0f;
-                const int radius = (int)( sigma / pixel_distance_scale * 2.0f );
-                
-                if( radius == 0 )
+                // right singular vector. starts from the strongest row, which is not orthogonal to it.
+                std::vector< double > u( side ), v( side );
+                for( int i=0; i<side; ++i )
                 {
-                    output = *this;
+                    v[i] = weight( largest_row, i );
                 }
-                else
+                
+                double value = 0.0;
+                for( int iteration=0; iteration<200; ++iteration )
                 {
-                    std::vector< int > kernel( radius * 2 + 1 );
-                    
-                    const double sigma_2_square = 2 * sigma * sigma;
-                    double root_sigma_square_pi = sqrt(2.0 * M_PI * sigma * sigma);
-                    
-                    double sum = 0.0;
-                    for( int i=0; i<(int)kernel.size(); ++i )
+                    for( int j=0; j<side; ++j )
                     {
-                        double distance = (i-radius) * pixel_distance_scale;
-
-                        sum += exp( -(distance*distance / sigma_2_square) ) / root_sigma_square_pi;
+                        u[j] = 0.0;
+                        for( int i=0; i<side; ++i )
+                        {
+                            u[j] += weight( j, i ) * v[i];
+                        }
                     }
-                    
-                    const double weight = 4096.0 / sum;
-                    for( int i=0; i<(int)kernel.size(); ++i )
+                    double norm = 0.0;
+                    for( int i=0; i<side; ++i )
                     {
-                        double distance = (i-radius) * pixel_distance_scale;
-
-                        kernel[i] = (int)(
-                            (exp( -(distance*distance / sigma_2_square) ) / root_sigma_square_pi ) * weight);
+                        v[i] = 0.0;
+                        for( int j=0; j<side; ++j )
+                        {
+                            v[i] += weight( j, i ) * u[j];
+                        }
+                        norm += v[i] * v[i];
+                    }
+                    norm = sqrt( norm );
+                    if( norm == 0.0 )
+                    {
+                        break;
+                    }
+                    for( int i=0; i<side; ++i )
+                    {
+                        v[i] /= norm;
                     }
                     
-                    const Image input = mirror_border(radius, radius);
-                    std::vector<ColorBuffer> horizontal( input.width );
-                    
-                    const T* p_input = &input[0];
-                    T* p_output = &output[0];
-
-                    for( int y=0; y<output.height; ++y )
+                    if( std::abs( norm - value ) <= norm * 1e-12 )
                     {
-                        // vertical filter.
-                        for( int x=0; x<input.width; ++x, ++p_input )
-                        {
-                            const T* p_input_xy = p_input;
-
-                            ColorBuffer color;
-                            for( int i=0; i<kernel.size(); ++i, p_input_xy += input.width )
-                            {
-                                color += ColorBuffer(*p_input_xy) * kernel[ i ];
-                            }
-                            horizontal[x] = color >> 6;
-                        }
-                        
-                        // horizontal filter.
-                        for( int x=0; x<output.width; ++x, ++p_output )
-                        {
-                            ColorBuffer color;
-                            for( int i=0; i<kernel.size(); ++i )
-                            {
-                                color += ColorBuffer( horizontal[i+x] ) * kernel[ i ];
-                            }
-                            *p_output = color >> 18;
-                        }
+                        break;
                     }
+                    value = norm;
+                }
+                
+                // u = A*v is the left vector times the singular value. half of the scale goes to each side.
+                double scale = 0.0;
+                for( int j=0; j<side; ++j )
+                {
+                    u[j] = 0.0;
+                    for( int i=0; i<side; ++i )
+                    {
+                        u[j] += weight( j, i ) * v[i];
+                    }
+                    scale += u[j] * u[j];
+                }
+                scale = sqrt( sqrt( scale ) );
+                if( scale == 0.0 )
+                {
+                    return 0;
+                }
+                
+                for( int j=0; j<side; ++j )
+                {
+                    for( int i=0; i<side; ++i )
+                    {
+                        weight( j, i ) -= u[j] * v[i];
+                    }
+                }
+                for( int j=0; j<side; ++j )
+                {
+                    vertical.push_back( (float)( u[j] / scale ) );
+                }
+                for( int i=0; i<side; ++i )
+                {
+                    horizontal.push_back( (float)( v[i] * scale ) );
                 }
-            
-                return std::move( output );
             }
-
-#define BlendConcept( FORE ) \
-            Image output( size ); \
-            \
-            const int ialpha = (int)(alpha * 1024.0f); \
-            const Image& back = *this; \
-            \
-            for( unsigned int i=0; i<length; ++i ) \
-            { \
-                output[i] = gs::alpha_blend( back[i], FORE, ialpha ); \
-            } \
-            \
-            return std::move(output)
+        }
+        
+        // a*b without the inf and nan checks of operator*, which run as a library call.
+        inline static std::complex< float > complex_multiply( const std::complex< float > a, const std::complex< float > b )
+        {
+            return std::complex< float >( a.real()*b.real() - a.imag()*b.imag(), a.real()*b.imag() + a.imag()*b.real() );
+        }
+        
+        // radix-2 FFT of a power of 2 complex values. the twiddles and the bit reversal are prepared once.
+        class FFT
+        {
+        private:
+            int m_size;
+            std::vector< int > m_reverse;
+            std::vector< std::complex< float > > m_twiddle;
             
-#define fore_color ColorBuffer(fore[i])
-#define back_color ColorBuffer(back[i])
-#define args_color ColorBuffer(color)
-
-            Move alpha_blend( const Image& fore, float alpha ) const
+        public:
+            FFT( const int size ) : m_size( size ), m_reverse( size ), m_twiddle( size / 2 )
             {
-                BlendConcept( fore_color );
-            }
-
-            Move alpha_blend( const T color, float alpha ) const
-            {
-                BlendConcept( args_color );
+                int bits = 0;
+                while( ( 1 << bits ) < size )
+                {
+                    ++bits;
+                }
+                for( int i=0; i<size; ++i )
+                {
+                    int reverse = 0;
+                    for( int b=0; b<bits; ++b )
+                    {
+                        reverse |= ( ( i >> b ) & 1 ) << ( bits-1-b );
+                    }
+                    m_reverse[i] = reverse;
+                }
+                for( int i=0; i<size/2; ++i )
+                {
+                    const double angle = -2.0 * M_PI * i / size;
+                    m_twiddle[i] = std::complex< float >( (float)cos( angle ), (float)sin( angle ) );
+                }
             }
             
-            Move addition_blend( const Image& fore, float alpha ) const
+            inline int size() const
             {
-                BlendConcept( ( back_color + fore_color ).limit_max() );
+                return m_size;
             }
-
-            Move addition_blend( const T color, float alpha ) const
+            
+            // [in]data size values in place. the inverse is not divided by size.
+            void transform( std::complex< float >* data, const bool inverse ) const
             {
-                BlendConcept( ( back_color + args_color ).limit_max() );
+                for( int i=0; i<m_size; ++i )
+                {
+                    if( i < m_reverse[i] )
+                    {
+                        std::swap( data[i], data[ m_reverse[i] ] );
+                    }
+                }
+                for( int half=1; half<m_size; half*=2 )
+                {
+                    const int step = m_size / ( half*2 );
+                    
+                    for( int begin=0; begin<m_size; begin+=half*2 )
+                    {
+                        for( int i=0; i<half; ++i )
+                        {
+                            const std::complex< float > w = inverse ? std::conj( m_twiddle[ i*step ] ) : m_twiddle[ i*step ];
+                            const std::complex< float > odd = complex_multiply( data[ begin+i+half ], w );
+                            
+                            data[ begin+i+half ] = data[ begin+i ] - odd;
+                            data[ begin+i ] += odd;
+                        }
+                    }
+                }
             }
             
-            Move subtract_blend( const Image& fore, float alpha ) const
+            /*
+             *  2D transform of size*size values, rows first. rows at and after rows are 0 on the way in,
+             *  so the forward transform skips them.
+             *
+             *  [in]line size values of scratch for the columns.
+             */
+            void transform_2d( std::complex< float >* data, const int rows, const bool inverse,
+                               std::complex< float >* line ) const
             {
-                BlendConcept( ( back_color - fore_color ).limit_min() );
+                for( int y=0; y<rows; ++y )
+                {
+                    transform( data + (size_t)y*m_size, inverse );
+                }
+                for( int x=0; x<m_size; ++x )
+                {
+                    for( int y=0; y<m_size; ++y )
+                    {
+                        line[y] = data[ (size_t)y*m_size + x ];
+                    }
+                    transform( line, inverse );
+                    for( int y=0; y<m_size; ++y )
+                    {
+                        data[ (size_t)y*m_size + x ] = line[y];
+                    }
+                }
             }
-            
-            Move multiply_blend( const Image& fore, float alpha ) const
+        };
+        
+        // [return] work of fft_filter() per tile, in the taps of one pixel of the direct filter. measured.
+        static inline double fft_tile_cost( const int size )
+        {
+            return 7.0 * size * size * log2( (double)size );
+        }
+        
+        // [return] side of the FFT of fft_filter(). the least work per output pixel, up to 128 where a transform still fits the cache.
+        static inline int fft_filter_size( const int side )
+        {
+            int best = 1;
+            while( best < side*2 )
             {
-                BlendConcept( back_color * fore_color / 255 );
+                best *= 2;
             }
+            double best_cost = fft_tile_cost( best ) / ( (double)( best - side + 1 ) * ( best - side + 1 ) );
             
-            Move difference_blend( const Image& fore, float alpha ) const
+            for( int size=16; size<=128; size*=2 )
             {
-                BlendConcept( ( fore_color - back_color ).abs() );
+                const double tile = size - side + 1;
+                if( tile >= 1.0 && fft_tile_cost( size ) / ( tile*tile ) < best_cost )
+                {
+                    best = size;
+                    best_cost = fft_tile_cost( size ) / ( tile*tile );
+                }
             }
+            return best;
+        }
+        
+        // [return] work of fft_filter() on an image, in the taps of one pixel of the direct filter.
+        static inline double fft_filter_cost( const int width, const int height, const int side )
+        {
+            const int size = fft_filter_size( side );
+            const int tile = size - side + 1;
+            const double tiles = (double)( ( width + side - 2 ) / tile + 1 ) * ( ( height + side - 2 ) / tile + 1 );
+            
+            // the kernel takes one more transform.
+            return ( tiles + 1.0 ) * fft_tile_cost( size );
+        }
+        
+        // integer channels are rounded to the nearest value. the transforms leave small noise.
+        inline static void round_channel( uint8_t& channel, const float value )
+        {
+            channel = (uint8_t)limit( (int)floor( value + 0.5f ), 0, 255 );
+        }
+        inline static void round_channel( float& channel, const float value )
+        {
+            channel = value;
+        }
+        
+        /*
+         *  ImageView::filter() by FFT convolution with overlap-add. the image with its border is cut into
+         *  tiles, every tile is convolved by the transform of the kernel, and the results are added
+         *  into a band of output rows. only the band and one transform are held, so the memory does not
+         *  grow with the image. two channels of real values go through one complex transform, as the real
+         *  and the imaginary part. the kernel is real, so their results do not mix.
+         *
+         *  [in]kernel weight of column i of row j at kernel[ i*side + j ].
+         *  [in]color  CHANNEL values of Border::constant.
+         */
+        template <int CHANNEL, class Channel>
+        static inline void fft_filter( const Channel* input, const ptrdiff_t input_stride,
+                                       const int width, const int height,
+                                       const std::vector< float >& kernel, const int side,
+                                       const Border border, const float* color,
+                                       Channel* output, const ptrdiff_t output_stride )
+        {
+            using Complex = std::complex< float >;
+            const int radius = side / 2;
+            const FFT fft( fft_filter_size( side ) );
+            const int size = fft.size();
+            const int tile = size - side + 1;
+            const int padded_width  = width  + side - 1;
+            const int padded_height = height + side - 1;
+            const int tiles_x = ( padded_width + tile - 1 ) / tile;
+            
+            std::vector< Complex > line( size );
             
-            Move color_burn_blend( const Image& fore, float alpha ) const
+            // transform of the kernel turned around, so the convolution is the correlation of filter().
+            std::vector< Complex > spectrum( (size_t)size*size );
+            for( int j=0; j<side; ++j )
             {
-                BlendConcept(
-                    (ColorBuffer(255) -
-                     (( ColorBuffer(255) - back_color ) * 255 / fore_color.max(1) )).limit_min()
-                );
+                for( int i=0; i<side; ++i )
+                {
+                    spectrum[ (size_t)j*size + i ] = kernel[ ( side-1-i )*side + ( side-1-j ) ] / ( (float)size*size );
+                }
             }
+            fft.transform_2d( &spectrum[0], side, false, &line[0] );
             
-            Move darken_blend( const Image& fore, float alpha ) const
+            // output rows [ty-side+1, ty+tile) of the tiles of padded rows [ty, ty+tile).
+            const int band_rows = tile + side - 1;
+            const size_t band_line = (size_t)width * CHANNEL;
+            std::vector< float > band( band_line * band_rows );
+            std::vector< Complex > data( (size_t)size*size );
+            std::vector< int > columns( padded_width );
+            
+            for( int x=0; x<padded_width; ++x )
             {
-                BlendConcept( ColorBuffer::compare_min( back_color, fore_color ) );
+                columns[x] = border_index( x - radius, width, border );
             }
             
-            Move lighten_blend( const Image& fore, float alpha ) const
+            for( int ty=0; ty<padded_height; ty+=tile )
             {
-                BlendConcept( ColorBuffer::compare_max( back_color, fore_color ) );
+                const int rows = fast_min( tile, padded_height - ty );
+                
+                // channel c of tile t is plane t*CHANNEL + c. two planes per transform.
+                const int planes = tiles_x * CHANNEL;
+                for( int plane=0; plane<planes; plane+=2 )
+                {
+                    const int pair = fast_min( 2, planes - plane );
+                    std::fill( data.begin(), data.end(), Complex() );
+                    
+                    for( int p=0; p<pair; ++p )
+                    {
+                        const int tx = ( plane+p ) / CHANNEL * tile;
+                        const int c  = ( plane+p ) % CHANNEL;
+                        const int tile_columns = fast_min( tile, padded_width - tx );
+                        
+                        for( int v=0; v<rows; ++v )
+                        {
+                            const int index = border_index( ty + v - radius, height, border );
+                            const Channel* p_input = index < 0 ? nullptr : offset_row( input, index*input_stride );
+                            Complex* p_data = &data[ (size_t)v*size ];
+                            
+                            for( int u=0; u<tile_columns; ++u )
+                            {
+                                const int x = columns[ tx+u ];
+                                const float value = p_input == nullptr || x < 0 ? color[c] : (float)p_input[ x*CHANNEL + c ];
+                                
+                                p_data[u] = p == 0 ? Complex( value, p_data[u].imag() ) : Complex( p_data[u].real(), value );
+                            }
+                        }
+                    }
+                    
+                    fft.transform_2d( &data[0], rows, false, &line[0] );
+                    for( size_t i=0; i<data.size(); ++i )
+                    {
+                        data[i] = complex_multiply( data[i], spectrum[i] );
+                    }
+                    fft.transform_2d( &data[0], size, true, &line[0] );
+                    
+                    for( int p=0; p<pair; ++p )
+                    {
+                        const int tx = ( plane+p ) / CHANNEL * tile;
+                        const int c  = ( plane+p ) % CHANNEL;
+                        const int x0 = fast_max( tx - side + 1, 0 );
+                        const int x1 = fast_min( tx + tile, width );
+                        
+                        for( int v=0; v<rows+side-1; ++v )
+                        {
+                            const Complex* p_data = &data[ (size_t)v*size ] + ( side - 1 - tx );
+                            float* p_band = &band[ band_line * v ];
+                            
+                            for( int x=x0; x<x1; ++x )
+                            {
+                                p_band[ x*CHANNEL + c ] += p == 0 ? p_data[x].real() : p_data[x].imag();
+                            }
+                        }
+                    }
+                }
+                
+                // rows before ty+tile-side+1 get nothing from the next tiles.
+                for( int v=0; v<tile; ++v )
+                {
+                    const int y = ty - side + 1 + v;
+                    if( y >= 0 && y < height )
+                    {
+                        Channel* p_output = offset_row( output, y*output_stride );
+                        const float* p_band = &band[ band_line * v ];
+                        
+                        for( size_t x=0; x<band_line; ++x )
+                        {
+                            round_channel( p_output[x], p_band[x] );
+                        }
+                    }
+                }
+                std::copy( band.begin() + band_line * tile, band.end(), band.begin() );
+                std::fill( band.end() - band_line * tile, band.end(), 0.0f );
             }
-
-            Move linear_burn_blend( const Image& fore, float alpha ) const
+        }
+        
+        /*
+         *  separable gaussian passes over uint8_t channels with the same integer math as
+         *  ImageView::gaussian_fir_into(). results are bit-exact:
+         *    vertical   : sum <= 255*4096, so sum>>6 fits int16.
+         *    horizontal : int16 * kernel pairs are summed by pmaddwd in int32.
+         */
+        
+        // [out]output[j] = sum( rows[i][j] * kernel[i] ) >> 6. j < count.
+        static inline void gaussian_vertical_u8_scalar( const uint8_t* const* rows,
+                const int* kernel, const int taps, int16_t* output, const int begin, const int count )
+        {
+            for( int j=begin; j<count; ++j )
             {
-                BlendConcept( (back_color + fore_color - 255).limit_min() );
+                int sum = 0;
+                for( int i=0; i<taps; ++i )
+                {
+                    sum += rows[i][j] * kernel[i];
+                }
+                output[j] = (int16_t)(sum >> 6);
             }
-
-            Move screen_blend( const Image& fore, float alpha ) const
+        }
+        
+        // [out]output[j] = sum( input[ j + i*step ] * kernel[i] ) >> 18. j < count.
+        static inline void gaussian_horizontal_u8_scalar( const int16_t* input, const int step,
+                const int* kernel, const int taps, uint8_t* output, const int begin, const int count )
+        {
+            for( int j=begin; j<count; ++j )
             {
-                BlendConcept( back_color + fore_color - back_color * fore_color / 255 );
+                const int16_t* p_input = input + j;
+                int sum = 0;
+                for( int i=0; i<taps; ++i, p_input += step )
+                {
+                    sum += *p_input * kernel[i];
+                }
+                output[j] = (uint8_t)(sum >> 18);
             }
-
-            Move color_dodge_blend( const Image& fore, float alpha ) const
+        }
+        
+        /*
+         *  kernels of the radii the pipelines use run with their taps unrolled and the weights in registers.
+         *  radius 1, 2 (Pyramid), 3, 5 and 10 (mod_gazo_shori).
+         *
+         *  [return] func( std::integral_constant< int, taps > ) for those taps, otherwise func() of 0 taps.
+         */
+        template <class Function>
+        static inline auto unrolled_taps( const int taps, const Function& func ) -> decltype( func( std::integral_constant< int, 0 >() ) )
+        {
+            if( taps == 3 )
             {
-                BlendConcept( (back_color * 255 / (ColorBuffer(255) - fore_color).max(1)).limit_max() );
+                return func( std::integral_constant< int, 3 >() );
             }
-
-            Move exclusion_blend( const Image& fore, float alpha ) const
+            else if( taps == 5 )
             {
-                BlendConcept( ( back_color + fore_color - 2 * back_color * fore_color / 255).limit_min() );
+                return func( std::integral_constant< int, 5 >() );
             }
-            
-#undef BlendConcept
-#undef fore_color
-#undef back_color
-#undef args_color
-
-#define BlendConceptChannel( FORE ) \
-    Image output( size ); \
-    \
-    const int ialpha = (int)(alpha * 1024.0f); \
-    const Image& back = *this; \
-    \
-    for( unsigned int i=0; i<length; ++i ) \
-    { \
-        for( int c=0; c<T::CHANNEL; ++c ) \
-        { \
-            output[i][c] = gs::alpha_blend( back[i][c], FORE, ialpha ); \
-        } \
-    } \
-    \
-    return std::move(output)
-            
-#define fore_color (fore[i][c])
-#define back_color (back[i][c])
-#define args_color (color[c])
-
-            Move overlay_blend( const Image& fore, float alpha ) const
+            else if( taps == 7 )
             {
-                BlendConceptChannel( back_color < 128 ?
-                             back_color*fore_color*2/255 :
-                             2*(back_color+fore_color-back_color*fore_color/255)-255 );
+                return func( std::integral_constant< int, 7 >() );
             }
-
-            Move overlay_blend( const T color, float alpha ) const
+            else if( taps == 11 )
             {
-                BlendConceptChannel( back_color < 128 ?
-                                    back_color*args_color*2/255 :
-                                    2*(back_color+args_color-back_color*args_color/255)-255 );
+                return func( std::integral_constant< int, 11 >() );
+            }
+            else if( taps == 21 )
+            {
+                return func( std::integral_constant< int, 21 >() );
             }
+            return func( std::integral_constant< int, 0 >() );
+        }
+        
+        // [out]output[x] = sum( input[x+i] * kernel[i] ) >> 18 of ColorBuffer values. TAPS 0 runs runtime_taps.
+        template <int TAPS, class ColorBuffer, class T>
+        static inline void gaussian_horizontal_line( const ColorBuffer* input, const int* kernel, const int runtime_taps,
+                                                     T* output, const int count )
+        {
+            const int taps = TAPS != 0 ? TAPS : runtime_taps;
             
-            Move soft_light_blend( const Image& fore, float alpha ) const
+            for( int x=0; x<count; ++x )
             {
-                BlendConceptChannel( fore_color < 128 ?
-                             std::pow( back_color / 255.0f, 2.0f * (1.0f - fore_color / 255.0f) ) * 255.0f :
-                             std::pow( back_color / 255.0f, 2.0f * (1.0f / (2.0f * fore_color / 255.0f) ) ) * 255.0f );
+                ColorBuffer color;
+                for( int i=0; i<taps; ++i )
+                {
+                    color += ColorBuffer( input[i+x] ) * kernel[ i ];
+                }
+                output[x] = color >> 18;
             }
-
-            Move soft_light_blend( const T color, float alpha ) const
+        }
+        
+#if defined( GAZO_SHORI_X86_SIMD )
+        // two taps as int16 pairs for pmaddwd. the last odd tap is paired with 0.
+        inline static int kernel_pair( const int* kernel, const int taps, const int i )
+        {
+            return (kernel[i] & 0xFFFF) | ((i+1 < taps ? kernel[i+1] : 0) << 16);
+        }
+        
+        template <int TAPS>
+        __attribute__(( target( "sse4.1" ) ))
+        static inline int gaussian_vertical_u8_sse41( const uint8_t* const* rows,
+                const int* kernel, const int runtime_taps, int16_t* output, const int count )
+        {
+            const int taps = TAPS != 0 ? TAPS : runtime_taps;
+            // the pairs stay in registers when TAPS is a constant.
+            __m128i pairs[ TAPS != 0 ? ( TAPS + 1 ) / 2 : 1 ];
+            for( int i=0; TAPS != 0 && i<taps; i+=2 )
             {
-                BlendConceptChannel( args_color < 128 ?
-                                    std::pow( back_color / 255.0f, 2.0f * (1.0f - args_color / 255.0f) ) * 255.0f :
-                                    std::pow( back_color / 255.0f, 2.0f * (1.0f / (2.0f * args_color / 255.0f) ) ) * 255.0f );
+                pairs[ i/2 ] = _mm_set1_epi32( kernel_pair( kernel, taps, i ) );
             }
             
-            Move hard_light_blend( const Image& fore, float alpha ) const
+            int j = 0;
+            for( ; j+8<=count; j+=8 )
             {
-                BlendConceptChannel( fore_color < 128 ?
-                             back_color*fore_color*2/255 :
-                             2*(back_color+fore_color-back_color*fore_color/255) - 255 );
+                __m128i sum_low  = _mm_setzero_si128();
+                __m128i sum_high = _mm_setzero_si128();
+                
+                for( int i=0; i<taps; i+=2 )
+                {
+                    const __m128i a = _mm_cvtepu8_epi16( _mm_loadl_epi64( (const __m128i*)(rows[i] + j) ) );
+                    const __m128i b = i+1 < taps ?
+                        _mm_cvtepu8_epi16( _mm_loadl_epi64( (const __m128i*)(rows[i+1] + j) ) ) : _mm_setzero_si128();
+                    const __m128i k = TAPS != 0 ? pairs[ i/2 ] : _mm_set1_epi32( kernel_pair( kernel, taps, i ) );
+                    
+                    sum_low  = _mm_add_epi32( sum_low,  _mm_madd_epi16( _mm_unpacklo_epi16( a, b ), k ) );
+                    sum_high = _mm_add_epi32( sum_high, _mm_madd_epi16( _mm_unpackhi_epi16( a, b ), k ) );
+                }
+                _mm_storeu_si128( (__m128i*)(output + j),
+                                  _mm_packs_epi32( _mm_srai_epi32( sum_low, 6 ), _mm_srai_epi32( sum_high, 6 ) ) );
             }
-
-            Move hard_light_blend( const T color, float alpha ) const
+            return j;
+        }
+        
+        template <int TAPS>
+        __attribute__(( target( "sse4.1" ) ))
+        static inline int gaussian_horizontal_u8_sse41( const int16_t* input, const int step,
+                const int* kernel, const int runtime_taps, uint8_t* output, const int count )
+        {
+            const int taps = TAPS != 0 ? TAPS : runtime_taps;
+            // the pairs stay in registers when TAPS is a constant.
+            __m128i pairs[ TAPS != 0 ? ( TAPS + 1 ) / 2 : 1 ];
+            for( int i=0; TAPS != 0 && i<taps; i+=2 )
             {
-                BlendConceptChannel( args_color < 128 ?
-                                    back_color*args_color*2/255 :
-                                    2*(back_color+args_color-back_color*args_color/255) - 255 );
+                pairs[ i/2 ] = _mm_set1_epi32( kernel_pair( kernel, taps, i ) );
             }
             
-            Move vivid_light_blend( const Image& fore, float alpha ) const
+            int j = 0;
+            for( ; j+8<=count; j+=8 )
             {
-                BlendConceptChannel( fore_color < 128 ?
-                                 back_color < 255-2*fore_color ?
-                                    0 :
-                                    (back_color-(255-2*fore_color)) / (2 * fast_max(fore_color,1)) :
-                                 back_color < 2*(255-fore_color) ?
-                                    back_color / 2*(255-fore_color) :
-                                    255
-                             );
+                __m128i sum_low  = _mm_setzero_si128();
+                __m128i sum_high = _mm_setzero_si128();
+                const int16_t* p_input = input + j;
+                
+                for( int i=0; i<taps; i+=2, p_input += step*2 )
+                {
+                    const __m128i a = _mm_loadu_si128( (const __m128i*)p_input );
+                    const __m128i b = i+1 < taps ? _mm_loadu_si128( (const __m128i*)(p_input + step) ) : _mm_setzero_si128();
+                    const __m128i k = TAPS != 0 ? pairs[ i/2 ] : _mm_set1_epi32( kernel_pair( kernel, taps, i ) );
+                    
+                    sum_low  = _mm_add_epi32( sum_low,  _mm_madd_epi16( _mm_unpacklo_epi16( a, b ), k ) );
+                    sum_high = _mm_add_epi32( sum_high, _mm_madd_epi16( _mm_unpackhi_epi16( a, b ), k ) );
+                }
+                const __m128i sum = _mm_packs_epi32( _mm_srai_epi32( sum_low, 18 ), _mm_srai_epi32( sum_high, 18 ) );
+                _mm_storel_epi64( (__m128i*)(output + j), _mm_packus_epi16( sum, sum ) );
             }
-
-            Move vivid_light_blend( const T color, float alpha ) const
+            return j;
+        }
+        
+        // unpack and pack work in 128bit lanes, so 16 values per loop come back in order.
+        template <int TAPS>
+        __attribute__(( target( "avx2" ) ))
+        static inline int gaussian_vertical_u8_avx2( const uint8_t* const* rows,
+                const int* kernel, const int runtime_taps, int16_t* output, const int count )
+        {
+            const int taps = TAPS != 0 ? TAPS : runtime_taps;
+            // the pairs stay in registers when TAPS is a constant.
+            __m256i pairs[ TAPS != 0 ? ( TAPS + 1 ) / 2 : 1 ];
+            for( int i=0; TAPS != 0 && i<taps; i+=2 )
             {
-                BlendConceptChannel( args_color < 128 ?
-                                back_color < 255-2*args_color ?
-                                    0 :
-                                    (back_color-(255-2*args_color)) / (2 * fast_max(args_color,1)) :
-                                back_color < 2*(255-args_color) ?
-                                    back_color / 2*(255-args_color) :
-                                    255
-                                    );
+                pairs[ i/2 ] = _mm256_set1_epi32( kernel_pair( kernel, taps, i ) );
             }
             
-            Move linear_light_blend( const Image& fore, float alpha ) const
+            int j = 0;
+            for( ; j+16<=count; j+=16 )
             {
-                BlendConceptChannel( fore_color < 128 ?
-                                 back_color < 255 - 2 * fore_color ?
-                                    0 :
-                                    fast_min( 2 * fore_color + back_color + 255, 255 ) :
-                             
-                                 back_color < 2 * (255-fore_color) ?
-                                    fast_min( 2 * fore_color + back_color + 255, 255 ) :
-                                    255
-                             );
+                __m256i sum_low  = _mm256_setzero_si256();
+                __m256i sum_high = _mm256_setzero_si256();
+                
+                for( int i=0; i<taps; i+=2 )
+                {
+                    const __m256i a = _mm256_cvtepu8_epi16( _mm_loadu_si128( (const __m128i*)(rows[i] + j) ) );
+                    const __m256i b = i+1 < taps ?
+                        _mm256_cvtepu8_epi16( _mm_loadu_si128( (const __m128i*)(rows[i+1] + j) ) ) : _mm256_setzero_si256();
+                    const __m256i k = TAPS != 0 ? pairs[ i/2 ] : _mm256_set1_epi32( kernel_pair( kernel, taps, i ) );
+                    
+                    sum_low  = _mm256_add_epi32( sum_low,  _mm256_madd_epi16( _mm256_unpacklo_epi16( a, b ), k ) );
+                    sum_high = _mm256_add_epi32( sum_high, _mm256_madd_epi16( _mm256_unpackhi_epi16( a, b ), k ) );
+                }
+                _mm256_storeu_si256( (__m256i*)(output + j),
+                    _mm256_packs_epi32( _mm256_srai_epi32( sum_low, 6 ), _mm256_srai_epi32( sum_high, 6 ) ) );
             }
-
-            Move linear_light_blend( const T color, float alpha ) const
+            return j;
+        }
+        
+        template <int TAPS>
+        __attribute__(( target( "avx2" ) ))
+        static inline int gaussian_horizontal_u8_avx2( const int16_t* input, const int step,
+                const int* kernel, const int runtime_taps, uint8_t* output, const int count )
+        {
+            const int taps = TAPS != 0 ? TAPS : runtime_taps;
+            // the pairs stay in registers when TAPS is a constant.
+            __m256i pairs[ TAPS != 0 ? ( TAPS + 1 ) / 2 : 1 ];
+            for( int i=0; TAPS != 0 && i<taps; i+=2 )
             {
-                BlendConceptChannel( args_color < 128 ?
-                                    back_color < 255 - 2 * args_color ?
-                                        0 :
-                                        fast_min( 2 * args_color + back_color + 255, 255 ) :
-                                    
-                                    back_color < 2 * (255-args_color) ?
-                                        fast_min( 2 * args_color + back_color + 255, 255 ) :
-                                        255
-                                    );
+                pairs[ i/2 ] = _mm256_set1_epi32( kernel_pair( kernel, taps, i ) );
             }
             
-            Move pin_light_blend( const Image& fore, float alpha ) const
+            int j = 0;
+            for( ; j+16<=count; j+=16 )
             {
-                BlendConceptChannel( fore_color < 128 ?
-                                 back_color < 255 - 2 * fore_color ?
-                                    back_color :
-                                    2 * fore_color :
-                                 
-                                 back_color < 2 * fore_color - 255 ?
-                                    2 * fore_color - 255 :
-                                    back_color
-                             );
+                __m256i sum_low  = _mm256_setzero_si256();
+                __m256i sum_high = _mm256_setzero_si256();
+                const int16_t* p_input = input + j;
+                
+                for( int i=0; i<taps; i+=2, p_input += step*2 )
+                {
+                    const __m256i a = _mm256_loadu_si256( (const __m256i*)p_input );
+                    const __m256i b = i+1 < taps ? _mm256_loadu_si256( (const __m256i*)(p_input + step) ) : _mm256_setzero_si256();
+                    const __m256i k = TAPS != 0 ? pairs[ i/2 ] : _mm256_set1_epi32( kernel_pair( kernel, taps, i ) );
+                    
+                    sum_low  = _mm256_add_epi32( sum_low,  _mm256_madd_epi16( _mm256_unpacklo_epi16( a, b ), k ) );
+                    sum_high = _mm256_add_epi32( sum_high, _mm256_madd_epi16( _mm256_unpackhi_epi16( a, b ), k ) );
+                }
+                const __m256i sum = _mm256_packs_epi32( _mm256_srai_epi32( sum_low, 18 ), _mm256_srai_epi32( sum_high, 18 ) );
+                _mm_storeu_si128( (__m128i*)(output + j),
+                    _mm_packus_epi16( _mm256_castsi256_si128( sum ), _mm256_extracti128_si256( sum, 1 ) ) );
             }
-
-            Move pin_light_blend( const T color, float alpha ) const
+            return j;
+        }
+#endif
+        
+        static inline void gaussian_vertical_u8( const uint8_t* const* rows,
+                const int* kernel, const int taps, int16_t* output, const int count )
+        {
+            int j = 0;
+#if defined( GAZO_SHORI_X86_SIMD )
+            const SimdLevel level = simd_level();
+            if( level == SimdLevel::avx2 )
+            {
+                j = unrolled_taps( taps, [&]( const auto constant )
+                {
+                    return gaussian_vertical_u8_avx2< decltype( constant )::value >( rows, kernel, taps, output, count );
+                } );
+            }
+            else if( level == SimdLevel::sse41 )
+            {
+                j = unrolled_taps( taps, [&]( const auto constant )
+                {
+                    return gaussian_vertical_u8_sse41< decltype( constant )::value >( rows, kernel, taps, output, count );
+                } );
+            }
+#endif
+            gaussian_vertical_u8_scalar( rows, kernel, taps, output, j, count );
+        }
+        
+        static inline void gaussian_horizontal_u8( const int16_t* input, const int step,
+                const int* kernel, const int taps, uint8_t* output, const int count )
+        {
+            int j = 0;
+#if defined( GAZO_SHORI_X86_SIMD )
+            const SimdLevel level = simd_level();
+            if( level == SimdLevel::avx2 )
+            {
+                j = unrolled_taps( taps, [&]( const auto constant )
+                {
+                    return gaussian_horizontal_u8_avx2< decltype( constant )::value >( input, step, kernel, taps, output, count );
+                } );
+            }
+            else if( level == SimdLevel::sse41 )
+            {
+                j = unrolled_taps( taps, [&]( const auto constant )
+                {
+                    return gaussian_horizontal_u8_sse41< decltype( constant )::value >( input, step, kernel, taps, output, count );
+                } );
+            }
+#endif
+            gaussian_horizontal_u8_scalar( input, step, kernel, taps, output, j, count );
+        }
+        
+        // bins of a histogram of median_filter(). 256 fine bins, then 16 coarse bins of 16 values each.
+        static const int MEDIAN_BINS = 256 + 16;
+        
+#if defined( GAZO_SHORI_X86_SIMD )
+        __attribute__(( target( "avx2" ) ))
+        static inline int histogram_update_avx2( uint16_t* histogram, const uint16_t* add, const uint16_t* sub,
+                                                 const int count )
+        {
+            int i = 0;
+            for( ; i+16<=count; i+=16 )
+            {
+                const __m256i h = _mm256_loadu_si256( (const __m256i*)(histogram + i) );
+                const __m256i a = _mm256_loadu_si256( (const __m256i*)(add + i) );
+                const __m256i s = _mm256_loadu_si256( (const __m256i*)(sub + i) );
+                _mm256_storeu_si256( (__m256i*)(histogram + i), _mm256_sub_epi16( _mm256_add_epi16( h, a ), s ) );
+            }
+            return i;
+        }
+        
+        __attribute__(( target( "sse4.1" ) ))
+        static inline int histogram_update_sse41( uint16_t* histogram, const uint16_t* add, const uint16_t* sub,
+                                                  const int count )
+        {
+            int i = 0;
+            for( ; i+8<=count; i+=8 )
+            {
+                const __m128i h = _mm_loadu_si128( (const __m128i*)(histogram + i) );
+                const __m128i a = _mm_loadu_si128( (const __m128i*)(add + i) );
+                const __m128i s = _mm_loadu_si128( (const __m128i*)(sub + i) );
+                _mm_storeu_si128( (__m128i*)(histogram + i), _mm_sub_epi16( _mm_add_epi16( h, a ), s ) );
+            }
+            return i;
+        }
+        
+        /*
+         *  [return]   index of the first of 16 counts at which sum plus the counts so far passes rank.
+         *  [in][out]sum count before counts. on return, count before the index.
+         */
+        __attribute__(( target( "sse4.1" ) ))
+        static inline int histogram_search_sse41( const uint16_t* counts, const int rank, int& sum )
+        {
+            __m128i low  = _mm_loadu_si128( (const __m128i*)counts );
+            __m128i high = _mm_loadu_si128( (const __m128i*)(counts + 8) );
+            
+            // running sums. the total is at most 65025, so they fit.
+            low  = _mm_add_epi16( low,  _mm_slli_si128( low,  2 ) );
+            high = _mm_add_epi16( high, _mm_slli_si128( high, 2 ) );
+            low  = _mm_add_epi16( low,  _mm_slli_si128( low,  4 ) );
+            high = _mm_add_epi16( high, _mm_slli_si128( high, 4 ) );
+            low  = _mm_add_epi16( low,  _mm_slli_si128( low,  8 ) );
+            high = _mm_add_epi16( high, _mm_slli_si128( high, 8 ) );
+            const __m128i last = _mm_shufflehi_epi16( low, 0xFF );
+            high = _mm_add_epi16( high, _mm_unpackhi_epi64( last, last ) );
+            
+            // the running sums only grow, so the lanes up to rank are the low bits of the mask.
+            const __m128i limit = _mm_set1_epi16( (short)( rank - sum ) );
+            const __m128i below_low  = _mm_cmpeq_epi16( _mm_min_epu16( low,  limit ), low );
+            const __m128i below_high = _mm_cmpeq_epi16( _mm_min_epu16( high, limit ), high );
+            const int index = __builtin_ctz( ~_mm_movemask_epi8( _mm_packs_epi16( below_low, below_high ) ) );
+            
+            uint16_t sums[16];
+            _mm_storeu_si128( (__m128i*)sums, low );
+            _mm_storeu_si128( (__m128i*)(sums + 8), high );
+            sum += index == 0 ? 0 : sums[ index-1 ];
+            return index;
+        }
+#endif
+        
+        // histogram += add - sub over count bins. the counts may wrap on the way, the result is exact.
+        template <class Count>
+        static inline void histogram_update( Count* histogram, const Count* add, const Count* sub, const int count )
+        {
+            int i = 0;
+#if defined( GAZO_SHORI_X86_SIMD )
+            if( sizeof( Count ) == 2 )
+            {
+                const SimdLevel level = simd_level();
+                if( level == SimdLevel::avx2 )
+                {
+                    i = histogram_update_avx2( (uint16_t*)histogram, (const uint16_t*)add, (const uint16_t*)sub, count );
+                }
+                else if( level == SimdLevel::sse41 )
+                {
+                    i = histogram_update_sse41( (uint16_t*)histogram, (const uint16_t*)add, (const uint16_t*)sub, count );
+                }
+            }
+#endif
+            for( ; i<count; ++i )
+            {
+                histogram[i] = (Count)( histogram[i] + add[i] - sub[i] );
+            }
+        }
+        
+        // [return] value of index rank in the sorted values of a histogram of MEDIAN_BINS.
+        template <class Count>
+        static inline uint8_t histogram_median( const Count* histogram, const int rank )
+        {
+            const Count* coarse = histogram + 256;
+            int sum = 0;
+            int bin = 0;
+            
+#if defined( GAZO_SHORI_X86_SIMD )
+            // without branches, which mispredict on noise.
+            if( sizeof( Count ) == 2 && simd_level() != SimdLevel::none )
+            {
+                bin = histogram_search_sse41( (const uint16_t*)coarse, rank, sum );
+                return (uint8_t)( bin*16 + histogram_search_sse41( (const uint16_t*)histogram + bin*16, rank, sum ) );
+            }
+#endif
+            
+            while( sum + coarse[ bin ] <= rank )
+            {
+                sum += coarse[ bin++ ];
+            }
+            int value = bin * 16;
+            while( sum + histogram[ value ] <= rank )
+            {
+                sum += histogram[ value++ ];
+            }
+            return (uint8_t)value;
+        }
+        
+        /*
+         *  median of the radius*2+1 square around each pixel, for each channel (Perreault and Hebert).
+         *  every column keeps the histogram of its radius*2+1 rows, moved down by one row per output row.
+         *  the histogram of the square is moved right by adding a column and removing a column,
+         *  so the cost per pixel does not depend on radius.
+         *
+         *  [in]color   CHANNEL values of Border::constant.
+         *  [in]Count   counts up to (radius*2+1)^2.
+         *  [out]output must not overlap input.
+         */
+        template <int CHANNEL, class Count>
+        static inline void median_filter( const uint8_t* input, const ptrdiff_t input_stride,
+                                          const int width, const int height, const int radius, const int threads,
+                                          const Border border, const uint8_t* color,
+                                          uint8_t* output, const ptrdiff_t output_stride )
+        {
+            const int side = radius*2 + 1;
+            const int rank = side * side / 2;
+            const int pixel_bins = MEDIAN_BINS * CHANNEL;
+            
+            // columns of the positions -radius to width+radius-1. column width has the border color.
+            std::vector< int > columns( width + radius*2 );
+            for( int x=0; x<width + radius*2; ++x )
+            {
+                const int index = border_index( x - radius, width, border );
+                columns[x] = index < 0 ? width : index;
+            }
+            
+            // rows of Border::constant.
+            ScratchVector< uint8_t > border_row( (size_t)width * CHANNEL );
+            for( int x=0; x<width; ++x )
+            {
+                std::copy( color, color + CHANNEL, &border_row[ (size_t)x * CHANNEL ] );
+            }
+            
+            const int bands = band_count( height, threads );
+            const size_t scratch = (size_t)pixel_bins * ( width + 2 );
+            ScratchVector< Count > buffer( scratch * bands );
+            const ScratchVector< Count > zero( pixel_bins );
+            
+            parallel_bands( height, threads, [&]( const int band, const int begin, const int end )
+            {
+                Count* p_columns = &buffer[ scratch * band ];
+                Count* p_kernel = p_columns + (size_t)pixel_bins * ( width + 1 );
+                
+                auto column = [p_columns, pixel_bins]( const int x ){ return p_columns + (size_t)pixel_bins * x; };
+                
+                // adds delta to the column histograms for row y.
+                auto add_row = [&]( const int y, const int delta )
+                {
+                    const int index = border_index( y, height, border );
+                    const uint8_t* p_row = index < 0 ? &border_row[0] : offset_row( input, index*input_stride );
+                    
+                    for( int x=0; x<width; ++x )
+                    {
+                        for( int c=0; c<CHANNEL; ++c )
+                        {
+                            const int value = p_row[ x*CHANNEL + c ];
+                            Count* p_histogram = column( x ) + MEDIAN_BINS * c;
+                            p_histogram[ value ] = (Count)( p_histogram[ value ] + delta );
+                            p_histogram[ 256 + ( value >> 4 ) ] = (Count)( p_histogram[ 256 + ( value >> 4 ) ] + delta );
+                        }
+                    }
+                };
+                
+                std::fill( p_columns, p_kernel, (Count)0 );
+                for( int c=0; c<CHANNEL; ++c )
+                {
+                    Count* p_histogram = column( width ) + MEDIAN_BINS * c;
+                    p_histogram[ color[c] ] = (Count)side;
+                    p_histogram[ 256 + ( color[c] >> 4 ) ] = (Count)side;
+                }
+                for( int i=-radius; i<=radius; ++i )
+                {
+                    add_row( begin + i, 1 );
+                }
+                
+                for( int y=begin; y<end; ++y )
+                {
+                    if( y != begin )
+                    {
+                        add_row( y - radius - 1, -1 );
+                        add_row( y + radius, 1 );
+                    }
+                    
+                    std::fill( p_kernel, p_kernel + pixel_bins, (Count)0 );
+                    for( int i=0; i<side; ++i )
+                    {
+                        histogram_update( p_kernel, column( columns[i] ), &zero[0], pixel_bins );
+                    }
+                    
+                    uint8_t* p_output = offset_row( output, y*output_stride );
+                    for( int x=0; x<width; ++x )
+                    {
+                        for( int c=0; c<CHANNEL; ++c )
+                        {
+                            p_output[ x*CHANNEL + c ] = histogram_median( p_kernel + MEDIAN_BINS * c, rank );
+                        }
+                        if( x+1 < width )
+                        {
+                            histogram_update( p_kernel, column( columns[ x+side ] ), column( columns[x] ), pixel_bins );
+                        }
+                    }
+                }
+            } );
+        }
+        
+#if defined( GAZO_SHORI_X86_SIMD )
+        __attribute__(( target( "avx2" ) ))
+        static inline int compare_bytes_avx2( uint8_t* output, const uint8_t* left, const uint8_t* right,
+                                              const int count, const bool minimum )
+        {
+            int i = 0;
+            for( ; i+32<=count; i+=32 )
+            {
+                const __m256i a = _mm256_loadu_si256( (const __m256i*)(left + i) );
+                const __m256i b = _mm256_loadu_si256( (const __m256i*)(right + i) );
+                _mm256_storeu_si256( (__m256i*)(output + i), minimum ? _mm256_min_epu8( a, b ) : _mm256_max_epu8( a, b ) );
+            }
+            return i;
+        }
+        
+        __attribute__(( target( "sse4.1" ) ))
+        static inline int compare_bytes_sse41( uint8_t* output, const uint8_t* left, const uint8_t* right,
+                                               const int count, const bool minimum )
+        {
+            int i = 0;
+            for( ; i+16<=count; i+=16 )
+            {
+                const __m128i a = _mm_loadu_si128( (const __m128i*)(left + i) );
+                const __m128i b = _mm_loadu_si128( (const __m128i*)(right + i) );
+                _mm_storeu_si128( (__m128i*)(output + i), minimum ? _mm_min_epu8( a, b ) : _mm_max_epu8( a, b ) );
+            }
+            return i;
+        }
+#endif
+        
+        // output = ColorBuffer::compare_min() or compare_max() of left and right, pixel by pixel. output may be left.
+        template <class T, class ColorBuffer>
+        static inline void compare_lines( T* output, const T* left, const T* right, const int count, const bool minimum )
+        {
+            int x = 0;
+#if defined( GAZO_SHORI_X86_SIMD )
+            // 8bit channels are compared as flat bytes. a pixel split at the end is compared again below.
+            if( T::TYPE_BYTE == 1 )
+            {
+                const SimdLevel level = simd_level();
+                if( level == SimdLevel::avx2 )
+                {
+                    x = compare_bytes_avx2( (uint8_t*)output, (const uint8_t*)left, (const uint8_t*)right,
+                                            count * T::CHANNEL, minimum ) / T::CHANNEL;
+                }
+                else if( level == SimdLevel::sse41 )
+                {
+                    x = compare_bytes_sse41( (uint8_t*)output, (const uint8_t*)left, (const uint8_t*)right,
+                                             count * T::CHANNEL, minimum ) / T::CHANNEL;
+                }
+            }
+#endif
+            if( minimum )
+            {
+                for( ; x<count; ++x )
+                {
+                    output[x] = ColorBuffer::compare_min( left[x], right[x] );
+                }
+            }
+            else
+            {
+                for( ; x<count; ++x )
+                {
+                    output[x] = ColorBuffer::compare_max( left[x], right[x] );
+                }
+            }
+        }
+        
+        /*
+         *  min or max of every side consecutive lines of count pixels (van Herk and Gil-Werman).
+         *  the lines are cut into blocks of side lines. a window spans the suffix of one block and
+         *  the prefix of the next, so each output costs three comparisons for any side.
+         *
+         *  [in]line   line( i ) is input line i. i is 0 to lines+side-2.
+         *  [in]suffix scratch of side*count pixels.
+         *  [in]prefix scratch of count pixels.
+         *  [in]store  store( x, pixels ) receives output line x, the window of input lines x to x+side-1.
+         */
+        template <class T, class ColorBuffer, class Line, class Store>
+        static inline void van_herk_lines( const int lines, const int side, const int count, const bool minimum,
+                                           const Line& line, T* suffix, T* prefix, const Store& store )
+        {
+            for( int block=0; block<lines; block+=side )
+            {
+                const T* p_last = line( block + side - 1 );
+                std::copy( p_last, p_last + count, suffix + (size_t)( side - 1 ) * count );
+                for( int i=side-2; i>=0; --i )
+                {
+                    compare_lines< T, ColorBuffer >( suffix + (size_t)i * count, line( block + i ),
+                                                     suffix + (size_t)( i + 1 ) * count, count, minimum );
+                }
+                store( block, suffix );
+                
+                for( int i=1; i<side && block+i<lines; ++i )
+                {
+                    const T* p_line = line( block + side + i - 1 );
+                    T* p_output = suffix + (size_t)i * count;
+                    
+                    if( i == 1 )
+                    {
+                        std::copy( p_line, p_line + count, prefix );
+                    }
+                    else
+                    {
+                        compare_lines< T, ColorBuffer >( prefix, prefix, p_line, count, minimum );
+                    }
+                    compare_lines< T, ColorBuffer >( p_output, p_output, prefix, count, minimum );
+                    store( block + i, p_output );
+                }
+            }
+        }
+        
+        // vertical pass of morphology_filter(), over blocks of columns side by side.
+        template <class T, class ColorBuffer>
+        static inline void morphology_columns( const T* input, const ptrdiff_t input_stride,
+                                               const int width, const int height, const int radius, const bool minimum,
+                                               const int threads, const Border border, const T color,
+                                               T* output, const ptrdiff_t output_stride )
+        {
+            const int BLOCK = 128;
+            const int side = radius*2 + 1;
+            const int blocks = ( width + BLOCK - 1 ) / BLOCK;
+            const size_t scratch = (size_t)BLOCK * ( side + 1 );
+            ScratchBuffer< T > buffer( scratch * band_count( blocks, threads ) );
+            
+            // rows of Border::constant point to this row.
+            const ScratchVector< T > border_row( border == Border::constant ? BLOCK : 0, color );
+            
+            parallel_bands( blocks, threads, [&]( const int band, const int begin, const int end )
+            {
+                T* p_suffix = &buffer[ scratch * band ];
+                T* p_prefix = p_suffix + (size_t)BLOCK * side;
+                
+                for( int block=begin; block<end; ++block )
+                {
+                    const int x0 = block * BLOCK;
+                    const int count = fast_min( BLOCK, width - x0 );
+                    
+                    van_herk_lines< T, ColorBuffer >( height, side, count, minimum,
+                        [&]( const int i )
+                        {
+                            const int index = border_index( i - radius, height, border );
+                            return index < 0 ? &border_row[0] : offset_row( input, index*input_stride ) + x0;
+                        },
+                        p_suffix, p_prefix,
+                        [&]( const int y, const T* p_pixels )
+                        {
+                            std::copy( p_pixels, p_pixels + count, offset_row( output, y*output_stride ) + x0 );
+                        } );
+                }
+            } );
+        }
+        
+        /*
+         *  horizontal pass of morphology_filter(). ROWS rows are gathered side by side,
+         *  so the comparisons run over lines of ROWS pixels like the vertical pass.
+         */
+        template <class T, class ColorBuffer>
+        static inline void morphology_rows( const T* input, const ptrdiff_t input_stride,
+                                            const int width, const int height, const int radius, const bool minimum,
+                                            const int threads, const Border border, const T color,
+                                            T* output, const ptrdiff_t output_stride )
+        {
+            const int ROWS = 32;
+            const int side = radius*2 + 1;
+            const int line = width + radius*2;
+            const size_t scratch = (size_t)ROWS * ( line + side + 1 );
+            ScratchBuffer< T > buffer( scratch * band_count( height, threads ) );
+            const ScratchVector< T > color_line( ROWS, color );
+            
+            parallel_bands( height, threads, [&]( const int band, const int begin, const int end )
+            {
+                T* p_gather = &buffer[ scratch * band ];
+                T* p_suffix = p_gather + (size_t)ROWS * line;
+                T* p_prefix = p_suffix + (size_t)ROWS * side;
+                
+                for( int y0=begin; y0<end; y0+=ROWS )
+                {
+                    const int rows = fast_min( ROWS, end - y0 );
+                    
+                    // column x of row y0+r is at line x+radius, r. missing rows are the border color.
+                    if( rows < ROWS )
+                    {
+                        std::fill( p_gather, p_gather + (size_t)ROWS * line, color );
+                    }
+                    for( int r=0; r<rows; ++r )
+                    {
+                        const T* p_input = offset_row( input, (y0+r)*input_stride );
+                        
+                        for( int x=0; x<width; ++x )
+                        {
+                            p_gather[ (size_t)( x + radius ) * ROWS + r ] = p_input[x];
+                        }
+                    }
+                    fill_border_columns( p_gather + (size_t)radius * ROWS, width, radius, ROWS, border, &color_line[0] );
+                    
+                    van_herk_lines< T, ColorBuffer >( width, side, ROWS, minimum,
+                        [&]( const int i ){ return (const T*)p_gather + (size_t)i * ROWS; },
+                        p_suffix, p_prefix,
+                        [&]( const int x, const T* p_pixels )
+                        {
+                            for( int r=0; r<rows; ++r )
+                            {
+                                offset_row( output, (y0+r)*output_stride )[x] = p_pixels[r];
+                            }
+                        } );
+                }
+            } );
+        }
+        
+        /*
+         *  min (erosion) or max (dilation) of the (radius_x*2+1) x (radius_y*2+1) rectangle around each
+         *  pixel by ColorBuffer::compare_min() or compare_max(). the vertical pass runs first.
+         *
+         *  [in]color  pixel of Border::constant.
+         *  [out]output may be input.
+         */
+        template <class T, class ColorBuffer>
+        static inline void morphology_filter( const T* input, const ptrdiff_t input_stride,
+                                              const int width, const int height, const int radius_x, const int radius_y,
+                                              const bool minimum, const int threads, const Border border, const T color,
+                                              T* output, const ptrdiff_t output_stride )
+        {
+            if( radius_y == 0 )
+            {
+                if( radius_x != 0 )
+                {
+                    morphology_rows< T, ColorBuffer >( input, input_stride, width, height, radius_x, minimum, threads,
+                                                       border, color, output, output_stride );
+                }
+                else if( input != output )
+                {
+                    for( int y=0; y<height; ++y )
+                    {
+                        const T* p_input = offset_row( input, y*input_stride );
+                        std::copy( p_input, p_input + width, offset_row( output, y*output_stride ) );
+                    }
+                }
+                return;
+            }
+            
+            ScratchBuffer< T > middle( (size_t)width * height );
+            const ptrdiff_t middle_stride = (ptrdiff_t)( sizeof( T ) * width );
+            
+            // columns are read after rows above them are written, so the vertical pass never writes output.
+            morphology_columns< T, ColorBuffer >( input, input_stride, width, height, radius_y, minimum, threads,
+                                                  border, color, &middle[0], middle_stride );
+            if( radius_x == 0 )
+            {
+                for( int y=0; y<height; ++y )
+                {
+                    const T* p_middle = &middle[ (size_t)width * y ];
+                    std::copy( p_middle, p_middle + width, offset_row( output, y*output_stride ) );
+                }
+                return;
+            }
+            morphology_rows< T, ColorBuffer >( &middle[0], middle_stride, width, height, radius_x, minimum, threads,
+                                               border, color, output, output_stride );
+        }
+        
+        static inline uint8_t rgb_to_gray( const int R, const int G, const int B )
+        {
+            return (uint8_t)((R*306 + G*601 + B * 117) >> 10);
+        }
+        
+        static inline RGB hmb_to_rgb( const HMB hmb )
+        {
+            static const RGB table[7] = {
+                {255,  0,  0}, {255,255,  0}, {  0,255,  0}, {  0,255,255},
+                {  0,  0,255}, {255,  0,255}, {255,  0,  0},
+            };
+            
+            const float angle         = hmb.H + (360.0f*2.0f); // Make it a positive number.
+            const int   angle_integer = (int)(angle / 60.0f);
+            const float alpha         = (angle - angle_integer * 60.0f) / 60.0f;
+            const int   index         = angle_integer % 6;
+            const float f_magnitude   = hmb.M / 255.0f;
+            const float R = (table[index].R * (1.0f - alpha) + table[index+1].R * alpha) * f_magnitude;
+            const float G = (table[index].G * (1.0f - alpha) + table[index+1].G * alpha) * f_magnitude;
+            const float B = (table[index].B * (1.0f - alpha) + table[index+1].B * alpha) * f_magnitude;
+            
+            RGB color;
+            color.R = fast_min( (int)(R + hmb.B), 255 );
+            color.G = fast_min( (int)(G + hmb.B), 255 );
+            color.B = fast_min( (int)(B + hmb.B), 255 );
+            return color;
+        }
+        
+        static inline HMB rgb_to_hmb( const RGB rgb )
+        {
+            const Vector2   degree0_R(  1.0f,  0.0f      );
+            const Vector2 degree120_G( -0.5f,  0.866025f );
+            const Vector2 degree240_B( -0.5f, -0.866025f );
+            
+            const float base = (float)fast_min( rgb.R, fast_min( rgb.G, rgb.B) );
+            const float R = rgb.R - base;
+            const float G = rgb.G - base;
+            const float B = rgb.B - base;
+            const Vector2 vec = (degree0_R * R) + (degree120_G * G) + (degree240_B * B);
+            
+            HMB color;
+            color.H = core::radian_to_degree( atan2( vec.y, vec.x ) );
+            color.M = fast_max( rgb.R, fast_max( rgb.G, rgb.B) ) - base;
+            color.B = base;
+            return color;
+        }
+        
+        /*
+         *  [return] hue angle between the max channel and the middle channel in 1/HUE_SCALE degree.
+         *           entry of ( max, middle ) is at max*(max+1)/2 + middle. 0 <= middle <= max <= 255.
+         *           the channels are differences from the min channel.
+         */
+        static inline const uint16_t* hue_q_table()
+        {
+            static const std::vector< uint16_t > table = []
+            {
+                std::vector< uint16_t > table( 256*257/2 );
+                
+                for( int max=0; max<256; ++max )
+                {
+                    for( int middle=0; middle<=max; ++middle )
+                    {
+                        const float angle = max == 0 ? 0.0f :
+                            core::radian_to_degree( atan2( 0.866025f * middle, max - 0.5f * middle ) );
+                        
+                        table[ max*(max+1)/2 + middle ] = (uint16_t)(angle * HMB_Q::HUE_SCALE + 0.5f);
+                    }
+                }
+                return table;
+            }();
+            
+            return table.data();
+        }
+        
+        // same as rgb_to_hmb() within 1/HUE_SCALE degree of H, without atan2.
+        static inline HMB_Q rgb_to_hmb_q( const RGB rgb )
+        {
+            const int base = fast_min( rgb.R, fast_min( rgb.G, rgb.B ) );
+            const int R = rgb.R - base;
+            const int G = rgb.G - base;
+            const int B = rgb.B - base;
+            const uint16_t* table = hue_q_table();
+            auto hue = [table]( const int max, const int middle ){ return (int)table[ max*(max+1)/2 + middle ]; };
+            
+            // degree of each sector from -180.
+            int H;
+            if( B == 0 )
+            {
+                H = R >= G ? 180*HMB_Q::HUE_SCALE + hue( R, G ) : 300*HMB_Q::HUE_SCALE - hue( G, R );
+            }
+            else if( R == 0 )
+            {
+                H = G >= B ? 300*HMB_Q::HUE_SCALE + hue( G, B ) :  60*HMB_Q::HUE_SCALE - hue( B, G );
+            }
+            else
+            {
+                H = B >= R ?  60*HMB_Q::HUE_SCALE + hue( B, R ) : 180*HMB_Q::HUE_SCALE - hue( R, B );
+            }
+            
+            return { (uint16_t)H, (uint8_t)fast_max( R, fast_max( G, B ) ), (uint8_t)base };
+        }
+        
+        // BMP pixels are B, G, R and an optional A/X byte, or one gray byte.
+        template <class T>
+        static inline void decode_bitmap_pixel( const uint8_t* bytes, const int byte_count, T& pixel )
+        {
+            if( byte_count < 3 )
+            {
+                for( int c=0; c<T::CHANNEL && c<3; ++c )
+                {
+                    pixel[c] = bytes[0];
+                }
+            }
+            else if( T::CHANNEL < 3 )
+            {
+                pixel[0] = rgb_to_gray( bytes[2], bytes[1], bytes[0] );
+            }
+            else
+            {
+                pixel[0] = bytes[2];
+                pixel[1] = bytes[1];
+                pixel[2] = bytes[0];
+            }
+            if( T::CHANNEL == 4 )
+            {
+                // 24bit pixels are opaque.
+                pixel[T::CHANNEL-1] = byte_count == 4 ? bytes[3] : 255;
+            }
+        }
+        
+        // 8bit pixels are indices of palette.
+        template <class T>
+        static inline void decode_bitmap_pixel( const uint8_t* bytes, const int byte_count,
+                                                const uint8_t (*palette)[3], T& pixel )
+        {
+            if( byte_count == 1 )
+            {
+                decode_bitmap_pixel( palette[ bytes[0] ], 3, pixel );
+            }
+            else
+            {
+                decode_bitmap_pixel( bytes, byte_count, pixel );
+            }
+        }
+        
+        // [return] entries of the color table of an 8bit bitmap. at most 256, and no more than fit before bfOffBits.
+        static inline int bitmap_colors( const BitmapHeader& header )
+        {
+            int colors = header.biClrUsed != 0 && header.biClrUsed < 256 ? (int)header.biClrUsed : 256;
+            
+            if( header.bfOffBits != 0 )
+            {
+                const int64_t table_bytes = (int64_t)header.bfOffBits - (int64_t)sizeof(BitmapHeader);
+                colors = (int)std::max< int64_t >( 0, std::min< int64_t >( colors, table_bytes / 4 ) );
+            }
+            return colors;
+        }
+        
+        /*
+         *  [in]table    colors entries of B, G, R and a reserved byte.
+         *  [out]palette B, G, R of the 256 indices. indices past the table are gray.
+         *  [return]     true when the table is the gray ramp, B = G = R = index, so indices are luminance.
+         */
+        static inline bool bitmap_palette( const uint8_t* table, const int colors, uint8_t (*palette)[3] )
+        {
+            bool gray = true;
+            
+            for( int i=0; i<256; ++i )
+            {
+                palette[i][0] = palette[i][1] = palette[i][2] = (uint8_t)i;
+            }
+            for( int i=0; i<colors; ++i )
+            {
+                const uint8_t* p_color = table + i*4;
+                
+                std::copy( p_color, p_color + 3, palette[i] );
+                gray = gray && p_color[0] == i && p_color[1] == i && p_color[2] == i;
+            }
+            return gray;
+        }
+        
+        // [return] palette of the bitmap file data by bitmap_palette(). the gray ramp unless biBitCount is 8.
+        static inline bool bitmap_palette( const std::vector< uint8_t >& image_data, uint8_t (*palette)[3] )
+        {
+            const BitmapHeader* header = (const BitmapHeader*)&image_data[0];
+            int colors = 0;
+            
+            if( header->biBitCount == 8 && image_data.size() > sizeof(BitmapHeader) )
+            {
+                colors = (int)std::min< size_t >( bitmap_colors( *header ),
+                                                  ( image_data.size() - sizeof(BitmapHeader) ) / 4 );
+            }
+            return bitmap_palette( colors != 0 ? &image_data[ sizeof(BitmapHeader) ] : nullptr, colors, palette );
+        }
+        
+        // [return] true for an 8bit bitmap of the gray ramp. a palette of colors needs a color image.
+        static inline bool gray_bitmap( const std::vector< uint8_t >& image_data )
+        {
+            uint8_t palette[256][3];
+            
+            return ( (const BitmapHeader*)&image_data[0] )->biBitCount == 8 && bitmap_palette( image_data, palette );
+        }
+        
+        /*
+         *  reads the header and the color table of a bitmap, and seeks to the pixels.
+         *
+         *  [out]palette colors of 8bit pixels by bitmap_palette().
+         */
+        static inline void read_bitmap_header( std::istream& stream, BitmapHeader& header, uint8_t (*palette)[3] )
+        {
+            uint8_t table[ 4*256 ];
+            
+            stream.read( (char*)&header, sizeof(BitmapHeader) );
+            
+            const int colors = header.biBitCount == 8 ? bitmap_colors( header ) : 0;
+            stream.read( (char*)table, colors*4 );
+            bitmap_palette( table, colors, palette );
+            
+            // bfOffBits already skips the ColorTable.
+            if( header.bfOffBits != 0 )
+            {
+                stream.seekg( header.bfOffBits, std::ios_base::beg );
+            }
+            else if( header.biBitCount == 8 ) // ColorTable
+            {
+                stream.seekg( sizeof(BitmapHeader) + 4*256, std::ios_base::beg );
+            }
+        }
+        
+        template <class T>
+        static inline void encode_bitmap_pixel( const T& pixel, uint8_t* bytes )
+        {
+            if( T::CHANNEL < 3 )
+            {
+                bytes[0] = pixel[0];
+            }
+            else
+            {
+                bytes[0] = pixel[2];
+                bytes[1] = pixel[1];
+                bytes[2] = pixel[0];
+            }
+            if( T::CHANNEL == 4 )
+            {
+                bytes[3] = pixel[T::CHANNEL-1];
+            }
+        }
+        
+        enum class Initialize
+        {
+            zero,
+            none, // for outputs that are overwritten anyway.
+        };
+        
+        // reference counted, ROW_ALIGNMENT aligned memory block. shared by copy-on-write images.
+        class SharedBuffer
+        {
+        private:
+            std::atomic< int > m_references;
+            Allocator* m_allocator;
+            size_t     m_block_size;
+            uint8_t*   m_data;
+            size_t     m_capacity;
+            
+            SharedBuffer( Allocator* allocator, const size_t block_size, uint8_t* data, const size_t capacity )
+                : m_references( 1 )
+            {
+                m_allocator  = allocator;
+                m_block_size = block_size;
+                m_data       = data;
+                m_capacity   = capacity;
+            }
+            
+        public:
+            SharedBuffer( const SharedBuffer& ) = delete;
+            SharedBuffer& operator=( const SharedBuffer& ) = delete;
+            
+            // one block holds this header and the data. the creator holds the first reference.
+            static SharedBuffer* create( const size_t size, Allocator* allocator )
+            {
+                const size_t header = align_size( sizeof(SharedBuffer), ROW_ALIGNMENT );
+                const size_t block_size = header + size + ROW_ALIGNMENT - 1;
+                uint8_t* block = (uint8_t*)allocator->allocate( block_size );
+                uint8_t* data  = (uint8_t*)align_size( (size_t)block + header, ROW_ALIGNMENT );
+                
+                return new( block ) SharedBuffer( allocator, block_size, data, size );
+            }
+            
+            inline void retain()
+            {
+                m_references.fetch_add( 1, std::memory_order_relaxed );
+            }
+            
+            inline void release()
+            {
+                if( m_references.fetch_sub( 1, std::memory_order_acq_rel ) == 1 )
+                {
+                    Allocator* allocator = m_allocator;
+                    const size_t block_size = m_block_size;
+                    
+                    this->~SharedBuffer();
+                    allocator->deallocate( this, block_size );
+                }
+            }
+            
+            inline bool unique() const
+            {
+                return m_references.load( std::memory_order_acquire ) == 1;
+            }
+            
+            inline uint8_t* data() const{ return m_data; }
+            inline size_t capacity() const{ return m_capacity; }
+            inline Allocator* allocator() const{ return m_allocator; }
+        };
+        
+        template <class T, class ColorBuffer> class Image;
+        
+        /*
+         *  Non-owning pixels. (pointer, size, stride)
+         *
+         *  stride is the byte distance between rows. it is negative for bottom-up data.
+         *  Image is a view of its own buffer, so every operation accepts views as input,
+         *  and crops or ROIs are processed without copy.
+         *
+         *  A view of an Image remembers the buffer, and an Image made from it shares
+         *  the pixels until one side is modified. Writes through a view are not copied.
+         */
+        template <class T, class ColorBuffer> class ImageView
+        {
+            friend class Image<T,ColorBuffer>;
+        public:
+            using View      = ImageView;
+            using ImageType = Image<T,ColorBuffer>;
+            using Pixel     = T;
+            
+            union
+            {
+                struct
+                {
+                    const int width = 0;
+                    const int height = 0;
+                };
+                const SizeI size;
+            };
+            const uint64_t length = 0;
+            const ptrdiff_t stride = 0;
+            
+        protected:
+            T* m_pixels = nullptr;
+            SharedBuffer* m_buffer = nullptr; // owner of m_pixels. not referenced by views.
+            
+            inline void set_view( T* pixels, const SizeI& size, const ptrdiff_t stride )
+            {
+                (SizeI&)this->size = size;
+                (uint64_t&)length = (uint64_t)size.width*size.height;
+                (ptrdiff_t&)this->stride = stride;
+                m_pixels = pixels;
+            }
+            
+        public:
+            class Move
+            {
+                friend class Image<T,ColorBuffer>;
+            private:
+                SizeI size = {};
+                ptrdiff_t stride = 0;
+                T* pixels = nullptr;
+                SharedBuffer* buffer = nullptr;
+                
+            public:
+                Move( ImageType&& image );
+                Move( Move&& value ) noexcept
+                {
+                    size   = value.size;
+                    stride = value.stride;
+                    pixels = value.pixels;
+                    buffer = value.buffer;
+                    value.buffer = nullptr;
+                }
+                Move( const Move& ) = delete;
+                ~Move()
+                {
+                    if( buffer != nullptr )
+                    {
+                        buffer->release();
+                    }
+                }
+            };
+            
+        public:
+            ImageView() noexcept{}
+            ImageView( const ImageView& value ) noexcept
+            {
+                set_view( value.m_pixels, value.size, value.stride );
+                m_buffer = value.m_buffer;
+            }
+            ImageView( T* pixels, const SizeI& size, const ptrdiff_t stride ) noexcept{ set_view( pixels, size, stride ); }
+            
+            ImageView& operator=( const ImageView& value ) noexcept
+            {
+                set_view( value.m_pixels, value.size, value.stride );
+                m_buffer = value.m_buffer;
+                return *this;
+            }
+            
+            inline T* row( const int y ){ return offset_row( m_pixels, y*stride ); }
+            inline const T* row( const int y ) const{ return offset_row( (const T*)m_pixels, y*stride ); }
+            // row-major pixel index. use row() in loops.
+            inline T& operator[]( const uint64_t index ){ return row( (int)(index / width) )[ index % width ]; };
+            inline const T& operator[]( const uint64_t index ) const{ return row( (int)(index / width) )[ index % width ]; };
+            inline T& operator[]( const PointI& point ){ return row( point.y )[ point.x ]; };
+            inline const T& operator[]( const PointI& point ) const{ return row( point.y )[ point.x ]; };
+            
+            inline bool contiguous() const
+            {
+                return stride == (ptrdiff_t)(width*sizeof(T));
+            }
+            
+            ImageView view( const RectangleI& rectangle ) const
+            {
+                if( rectangle.x < 0 || rectangle.y < 0 ||
+                    rectangle.x + rectangle.width > width || rectangle.y + rectangle.height > height )
+                {
+                    throw std::range_error( "view : rectangle is out of image" );
+                }
+                ImageView output( (T*)&(*this)[ rectangle.point ], rectangle.size, stride );
+                output.m_buffer = m_buffer;
+                return output;
+            }
+            
+            inline T get_nearest_pixel( const float x, const float y ) const
+            {
+                return (*this)[ { (int)(x+0.5f), (int)(y+0.5f) } ];
+            }
+
+            inline T get_nearest_pixel_safe_out_of_range( const float x, const float y ) const
+            {
+                return (*this)[ { limit( (int)(x+0.5f), 0, width-1), limit( (int)(y+0.5f), 0, height-1 ) } ];
+            }
+            
+            inline T get_bilinear_pixel( const float x, const float y ) const
+            {
+                const int ix = (int)x;
+                const int iy = (int)y;
+                const int fx = (int)((1.0f - (x - (float)ix))*1024.0f);
+                const int fy = (int)((1.0f - (y - (float)iy))*1024.0f);
+                
+                const int x1 = fast_min( ix+1, width-1 );
+                const int y1 = fast_min( iy+1, height-1 );
+                
+                const ColorBuffer c1 = (*this)[ { ix, iy } ];
+                const ColorBuffer c2 = (*this)[ { x1, iy } ];
+                const ColorBuffer c3 = (*this)[ { ix, y1 } ];
+                const ColorBuffer c4 = (*this)[ { x1, y1 } ];
+
+                return (((c1*fx + c2*(1024-fx))>>10) * fy + ((c3*fx + c4*(1024-fx))>>10) * (1024-fy)) >> 10;
+            }
+
+            inline T get_bilinear_pixel_safe_out_of_range( const float x, const float y ) const
+            {
+                const int ix = (int)x;
+                const int iy = (int)y;
+                const float fx = x >= 0.0f ? 1.0f - (x - (float)ix) : 1.0f + (x - (float)ix);
+                const float fy = y >= 0.0f ? 1.0f - (y - (float)iy) : 1.0f + (y - (float)iy);
+                const int aix = limit( ix, 0, width - 2 );
+                const int aiy = limit( iy, 0, height- 2 );
+                
+                const T* base = &(*this)[ { aix+0, aiy+0 } ];
+                const ColorBuffer c1 = base[0];      // { ix+0, iy+0 }
+                const ColorBuffer c2 = base[1];      // { ix+1, iy+0 }
+                const ColorBuffer c3 = offset_row( base, stride )[0]; // { ix+0, iy+1 }
+                const ColorBuffer c4 = offset_row( base, stride )[1]; // { ix+1, iy+1 }
+
+                return (((c1*fx + c2*(1024-fx))>>10) * fy + ((c3*fx + c4*(1024-fx))>>10) * (1024-fy)) >> 10;
+            }
+            
+            // area average of Interpolation::super. positions and steps are in 1/1024 pixels.
+            inline T get_super_pixel( const int x_pos_super, const int y_pos_super,
+                                      const int x_step_super, const int y_step_super ) const
+            {
+                ColorBuffer color;
+                int weight = 0;
+                int y_rem = 1024 - (y_pos_super - (y_pos_super&0xFFFFFC00));
+                int y_area = y_step_super;
+                
+                for( int yy=(y_pos_super>>10); y_area > 0; ++yy )
+                {
+                    int x_rem = 1024 - (x_pos_super - (x_pos_super&0xFFFFFC00));
+
+                    if( y_area <= 1024 )
+                    {
+                        y_rem = y_area;
+                    }
+                    y_area -= y_rem;
+                    
+                    int x_area = x_step_super;
+                    
+                    for( int xx=(x_pos_super>>10); x_area > 0; ++xx )
+                    {
+                        if( x_area <= 1024 )
+                        {
+                            x_rem = x_area;
+                        }
+                        color += ColorBuffer( (*this)[{xx,yy}] ) * ((x_rem*y_rem)>>10);
+                        weight += ((x_rem*y_rem) >> 10);
+                        x_area -= x_rem;
+                        x_rem = 1024;
+                    }
+                    y_rem = 1024;
+                }
+                return color / weight;
+            }
+            
+            inline T get_bicubic_pixel( const float x, const float y, const bicubic_table& table=default_bicubic_table ) const
+            {
+                const int ix = (int)x;
+                const int iy = (int)y;
+                const float fx = x - (float)ix;
+                const float fy = y - (float)iy;
+                const int fx100 = (int)(fx * 100);
+                const int fy100 = (int)(fy * 100);
+                
+                const int x0 = fast_max( ix-1, 0 );
+                const int x1 = ix;
+                const int x2 = fast_min( ix+1, width-1 );
+                const int x3 = fast_min( ix+2, width-1 );
+
+                const int y0 = fast_max( iy-1, 0 );
+                const int y1 = iy;
+                const int y2 = fast_min( iy+1, height-1 );
+                const int y3 = fast_min( iy+2, height-1 );
+                
+                const ColorBuffer color[16] =
+                {
+                    (*this)[ {x0, y0} ], (*this)[ {x1, y0} ], (*this)[ {x2, y0} ], (*this)[ {x3, y0} ],
+                    (*this)[ {x0, y1} ], (*this)[ {x1, y1} ], (*this)[ {x2, y1} ], (*this)[ {x3, y1} ],
+                    (*this)[ {x0, y2} ], (*this)[ {x1, y2} ], (*this)[ {x2, y2} ], (*this)[ {x3, y2} ],
+                    (*this)[ {x0, y3} ], (*this)[ {x1, y3} ], (*this)[ {x2, y3} ], (*this)[ {x3, y3} ],
+                };
+                
+                const int ti_x0 = fx100 + 100;
+                const int ti_x1 = fx100;
+                const int ti_x2 = 100 - fx100;
+                const int ti_x3 = 200 - fx100;
+
+                const int ti_y0 = fy100 + 100;
+                const int ti_y1 = fy100;
+                const int ti_y2 = 100 - fy100;
+                const int ti_y3 = 200 - fy100;
+
+                const int weight_x = table[ ti_x0 ] + table[ ti_x1 ] + table[ ti_x2 ] + table[ ti_x3 ];
+                const int weight_y = table[ ti_y0 ] + table[ ti_y1 ] + table[ ti_y2 ] + table[ ti_y3 ];
+                
+                const ColorBuffer result =
+                    ((
+                        color[ 0] * table[ ti_x0 ] + color[ 1] * table[ ti_x1 ] +
+                        color[ 2] * table[ ti_x2 ] + color[ 3] * table[ ti_x3 ]
+                    ) / weight_x ) * table[ ti_y0 ] +
+                
+                    ((
+                        color[ 4] * table[ ti_x0 ] + color[ 5] * table[ ti_x1 ] +
+                        color[ 6] * table[ ti_x2 ] + color[ 7] * table[ ti_x3 ]
+                    ) / weight_x ) * table[ ti_y1 ] +
+                
+                    ((
+                        color[ 8] * table[ ti_x0 ] + color[ 9] * table[ ti_x1 ] +
+                        color[10] * table[ ti_x2 ] + color[11] * table[ ti_x3 ]
+                    ) / weight_x ) * table[ ti_y2 ] +
+                
+                    ((
+                        color[12] * table[ ti_x0 ] + color[13] * table[ ti_x1 ] +
+                        color[14] * table[ ti_x2 ] + color[15] * table[ ti_x3 ]
+                    ) / weight_x) * table[ ti_y3 ];
+            
+                return (result / weight_y).limit_min_max();
+            }
+            
+            inline T get_bicubic_pixel_safe_out_of_range( const float x, const float y,
+                                                         const bicubic_table& table=default_bicubic_table ) const
+            {
+                const int ix = (int)x;
+                const int iy = (int)y;
+                const float fx = x >= 0.0f ? 1.0f - (x - (float)ix) : 1.0f + (x - (float)ix);
+                const float fy = y >= 0.0f ? 1.0f - (y - (float)iy) : 1.0f + (y - (float)iy);
+                const int fx100 = (int)(fx * 100 + 100);
+                const int fy100 = (int)(fy * 100 + 100);
+                
+                const int x0 = limit( ix-1, 0, width -  1);
+                const int x1 = limit( ix  , 0, width -  1);
+                const int x2 = limit( ix+1, 0, width -  1);
+                const int x3 = limit( ix+2, 0, width -  1);
+                
+                const int y0 = limit( iy-1, 0, height - 1);
+                const int y1 = limit( iy  , 0, height - 1);
+                const int y2 = limit( iy+1, 0, height - 1);
+                const int y3 = limit( iy+2, 0, height - 1);
+                
+                const ColorBuffer color[16] =
+                {
+                    (*this)[ {x0, y0} ], (*this)[ {x1, y0} ], (*this)[ {x2, y0} ], (*this)[ {x3, y0} ],
+                    (*this)[ {x0, y1} ], (*this)[ {x1, y1} ], (*this)[ {x2, y1} ], (*this)[ {x3, y1} ],
+                    (*this)[ {x0, y2} ], (*this)[ {x1, y2} ], (*this)[ {x2, y2} ], (*this)[ {x3, y2} ],
+                    (*this)[ {x0, y3} ], (*this)[ {x1, y3} ], (*this)[ {x2, y3} ], (*this)[ {x3, y3} ],
+                };
+                
+                const int ti_x0 = fx100 + 100;
+                const int ti_x1 = fx100;
+                const int ti_x2 = 100 - fx100;
+                const int ti_x3 = 200 - fx100;
+                
+                const int ti_y0 = fy100 + 100;
+                const int ti_y1 = fy100;
+                const int ti_y2 = 100 - fy100;
+                const int ti_y3 = 200 - fy100;
+                
+                const int weight_x = table[ ti_x0 ] + table[ ti_x1 ] + table[ ti_x2 ] + table[ ti_x3 ];
+                const int weight_y = table[ ti_y0 ] + table[ ti_y1 ] + table[ ti_y2 ] + table[ ti_y3 ];
+                
+                const ColorBuffer result =
+                    ((
+                      color[ 0] * table[ ti_x0 ] + color[ 1] * table[ ti_x1 ] +
+                      color[ 2] * table[ ti_x2 ] + color[ 3] * table[ ti_x3 ]
+                      ) / weight_x ) * table[ ti_y0 ] +
+                    
+                    ((
+                      color[ 4] * table[ ti_x0 ] + color[ 5] * table[ ti_x1 ] +
+                      color[ 6] * table[ ti_x2 ] + color[ 7] * table[ ti_x3 ]
+                      ) / weight_x ) * table[ ti_y1 ] +
+                    
+                    ((
+                      color[ 8] * table[ ti_x0 ] + color[ 9] * table[ ti_x1 ] +
+                      color[10] * table[ ti_x2 ] + color[11] * table[ ti_x3 ]
+                      ) / weight_x ) * table[ ti_y2 ] +
+                    
+                    ((
+                      color[12] * table[ ti_x0 ] + color[13] * table[ ti_x1 ] +
+                      color[14] * table[ ti_x2 ] + color[15] * table[ ti_x3 ]
+                      ) / weight_x) * table[ ti_y3 ];
+                
+                return (result / weight_y).limit_min_max();
+            }
+            
+            inline void fill(const T color)
+            {
+                for( int y=0; y<height; ++y )
+                {
+                    std::fill( row( y ), row( y ) + width, color );
+                }
+            }
+           
+            void fill(const T color, const RectangleI& rectangle)
+            {
+                const int begin_x = fast_max( rectangle.point.x, 0 );
+                const int end_x   = fast_min( rectangle.point.x + rectangle.size.width, width );
+                const int begin_y = fast_max( rectangle.point.y, 0 );
+                const int end_y   = fast_min( rectangle.point.y + rectangle.size.height, height );
+                
+                for( int y = begin_y; y<end_y; ++y )
+                {
+                    for( int x= begin_x; x<end_x; ++x )
+                    {
+                        (*this)[ {x, y} ] = color;
+                    }
+                }
+            }
+
+            void fill(const T color, const CircleF& circle)
+            {
+                const int begin_x = fast_max( (int)(circle.point.x - circle.radius-1),      0 );
+                const int end_x   = fast_min( (int)(circle.point.x + circle.radius+1),  width );
+                const int begin_y = fast_max( (int)(circle.point.y - circle.radius-1),      0 );
+                const int end_y   = fast_min( (int)(circle.point.y + circle.radius+1), height );
+                const float radius_square = circle.radius * circle.radius;
+                
+                for( int y = begin_y; y<end_y; ++y )
+                {
+                    const float sub_y = y - circle.point.y;
+                    const float square_y = sub_y * sub_y;
+
+                    for( int x= begin_x; x<end_x; ++x )
+                    {
+                        const float sub_x = x - circle.point.x;
+                        const float square_x = sub_x * sub_x;
+                        
+                        if( square_x + square_y <= radius_square )
+                        {
+                            (*this)[ {x, y} ] = color;
+                        }
+                    }
+                }
+            }
+            
+            // copy of the rectangle. use view() to process it without copy.
+            Move trimming( const RectangleI& rectangle ) const
+            {
+                ImageType output( view( rectangle ) );
+                
+                return std::move(output);
+            }
+    
+            Move resize( const SizeI& size, const Interpolation interpo = Interpolation::bicubic ) const
+            {
+                if( size.width <= 0 )
+                {
+                    throw std::range_error( "resize : size.width <= 0" );
+                }
+                if( size.height <= 0)
+                {
+                    throw std::range_error( "resize : size.height <= 0" );
+                }
+                
+                ImageType output;
+                
+                if( this->size == size )
+                {
+                    output = *this;
+                }
+                else
+                {
+                    output.create( size, Initialize::none );
+                    
+                    const float x_step = (float)(width  - 1) / (size.width  - 1);
+                    const float y_step = (float)(height - 1) / (size.height - 1);
+                    
+                    float y_pos = 0;
+                    
+                    if( interpo == Interpolation::nearest )
+                    {
+                        for( int y=0; y<size.height; ++y, y_pos += y_step )
+                        {
+                            T* p_output = output.row( y );
+                            float x_pos = 0;
+                            for( int x=0; x<size.width; ++x, x_pos += x_step, ++p_output )
+                            {
+                                *p_output = get_nearest_pixel( x_pos, y_pos );
+                            }
+                        }
+                    }
+                    if( interpo == Interpolation::bilinear )
+                    {
+                        for( int y=0; y<size.height; ++y, y_pos += y_step )
+                        {
+                            T* p_output = output.row( y );
+                            float x_pos = 0;
+                            for( int x=0; x<size.width; ++x, x_pos += x_step, ++p_output )
+                            {
+                                *p_output = get_bilinear_pixel( x_pos, y_pos );
+                            }
+                        }
+                    }
+                    if( interpo == Interpolation::bicubic )
+                    {
+                        for( int y=0; y<size.height; ++y, y_pos += y_step )
+                        {
+                            T* p_output = output.row( y );
+                            float x_pos = 0;
+                            for( int x=0; x<size.width; ++x, x_pos += x_step, ++p_output )
+                            {
+                                *p_output = get_bicubic_pixel( x_pos, y_pos );
+                            }
+                        }
+                    }
+                    if( interpo == Interpolation::super )
+                    {
+                        int y_pos_super =  0;
+
+                        const int x_step_super = (int)((float)width  / (size.width)  * 1024);
+                        const int y_step_super = (int)((float)height / (size.height) * 1024);
+
+                        for( int y=0; y<size.height; ++y, y_pos_super += y_step_super )
+                        {
+                            T* p_output = output.row( y );
+                            int x_pos_super = 0;
+
+                            for( int x=0; x<size.width; ++x, x_pos_super += x_step_super, ++p_output )
+                            {
+                                *p_output = get_super_pixel( x_pos_super, y_pos_super, x_step_super, y_step_super );
+                            }
+                        }
+                    }
+                }
+                return std::move(output);
+            }
+
+            inline Move resize( const float scaling, const Interpolation interpo = Interpolation::bicubic ) const
+            {
+                return resize( {width*scaling+0.5f, height*scaling+0.5f}, interpo );
+            }
+            
+            // a copy with Border::mirror pixels around it. the radius may be larger than the image.
+            Move mirror_border( const int width_radius, const int height_radius ) const
+            {
+                if( ( width == 0 && width_radius > 0 ) || ( height == 0 && height_radius > 0 ) )
+                {
+                    throw std::range_error( "mirror_border : no pixel to mirror" );
+                }
+                ImageType output( {width+width_radius*2, height+height_radius*2}, Initialize::none );
+                
+                for( int y=0; y<output.height; ++y )
+                {
+                    const T* p_input = row( border_index( y-height_radius, height, Border::mirror ) );
+                    T* p_output = output.row( y ) + width_radius;
+                    
+                    std::copy( p_input, p_input + width, p_output );
+                    fill_border_columns( p_output, width, width_radius, 1, Border::mirror, (const T*)nullptr );
+                }
+                return std::move(output);
+            }
+            
+            /*
+             *  [in]kernel side*side weights. column i of row j is kernel[ i*side + j ].
+             *             a kernel that splits into separable passes within filter_tolerance() runs as them,
+             *             2*side taps per pass instead of side*side. from fft_filter_radius(), a kernel runs
+             *             by FFT convolution when the transforms of the image take less work than the taps.
+             */
+            Move filter( const std::vector< float >& kernel, const Border border = Border::mirror,
+                         const T border_color = T() ) const
+            {
+                const int side = (int)sqrt( kernel.size() );
+                const int radius = side / 2;
+                
+                ImageType output( size, Initialize::none );
+                if( length == 0 )
+                {
+                    return std::move( output );
+                }
+                // the work of every path in taps. passes are only split while they cost less than the others.
+                const double area = (double)width * height;
+                double cost = area * side * side;
+                bool fft = false;
+                
+                if( radius >= fft_filter_radius() && fft_filter_cost( width, height, side ) < cost )
+                {
+                    cost = fft_filter_cost( width, height, side );
+                    fft = true;
+                }
+                const int max_passes = (int)std::min< double >( ( side - 1 ) / 2, cost / ( area * side * 2 ) );
+                
+                std::vector< float > vertical, horizontal;
+                const int passes = separable_kernel( kernel, side, filter_tolerance(), max_passes, vertical, horizontal );
+                
+                if( passes == 0 && fft )
+                {
+                    using Channel = typename T::Type;
+                    float color[ T::CHANNEL ];
+                    
+                    for( int c=0; c<T::CHANNEL; ++c )
+                    {
+                        color[c] = (float)border_color[c];
+                    }
+                    fft_filter< T::CHANNEL >( (const Channel*)row( 0 ), stride, width, height, kernel, side,
+                                              border, color, (Channel*)output.row( 0 ), output.stride );
+                    return std::move( output );
+                }
+                BorderRing< T > ring( width, radius, border, border_color );
+                std::vector< const T* > rows( side );
+                
+                if( passes != 0 )
+                {
+                    // weights in 1/1024. 4 bits are dropped after the vertical sums, so the sums fit int.
+                    std::vector< int > ivertical( vertical.size() );
+                    std::vector< int > ihorizontal( horizontal.size() );
+                    
+                    for( size_t i=0; i<vertical.size(); ++i )
+                    {
+                        ivertical[i]   = (int)lround( vertical[i] * 1024.0f );
+                        ihorizontal[i] = (int)lround( horizontal[i] * 1024.0f );
+                    }
+                    
+                    const int line = width + radius*2;
+                    std::vector< ColorBuffer > columns( line );
+                    std::vector< ColorBuffer > sums( width );
+                    
+                    for( int y=0; y<height; ++y )
+                    {
+                        ring.seek( *this, y );
+                        for( int j=0; j<side; ++j )
+                        {
+                            rows[j] = ring.row( j-radius ) - radius;
+                        }
+                        std::fill( sums.begin(), sums.end(), ColorBuffer() );
+                        
+                        for( int pass=0; pass<passes; ++pass )
+                        {
+                            const int* p_vertical   = &ivertical[ pass*side ];
+                            const int* p_horizontal = &ihorizontal[ pass*side ];
+                            
+                            for( int x=0; x<line; ++x )
+                            {
+                                ColorBuffer color;
+                                for( int j=0; j<side; ++j )
+                                {
+                                    color += ColorBuffer( rows[j][x] ) * p_vertical[j];
+                                }
+                                columns[x] = color >> 4;
+                            }
+                            for( int x=0; x<width; ++x )
+                            {
+                                ColorBuffer color;
+                                for( int i=0; i<side; ++i )
+                                {
+                                    color += columns[x+i] * p_horizontal[i];
+                                }
+                                sums[x] += color;
+                            }
+                        }
+                        
+                        T* p_output = output.row( y );
+                        for( int x=0; x<width; ++x )
+                        {
+                            p_output[x] = ( sums[x] >> 16 ).limit();
+                        }
+                    }
+                    return std::move( output );
+                }
+                
+                std::vector< int > ikernel( kernel.size() );
+                
+                for( size_t i=0; i<kernel.size(); ++i )
+                {
+                    ikernel[i] = (int)lround( kernel[i] * 1024.0f );
+                }
+                
+                for( int y=0; y<height; ++y )
+                {
+                    ring.seek( *this, y );
+                    for( int j=0; j<side; ++j )
+                    {
+                        rows[j] = ring.row( j-radius ) - radius;
+                    }
+                    
+                    T* p_output = output.row( y );
+                    for( int x=0; x<width; ++x )
+                    {
+                        ColorBuffer color;
+                        for( int i=0; i<side; ++i )
+                        {
+                            const int tx = x+i;
+                            
+                            for( int j=0; j<side; ++j )
+                            {
+                                color += ColorBuffer( rows[j][ tx ] ) * ikernel[ i*side + j ];
+                            }
+                        }
+                        p_output[x] = (color >> 10).limit();
+                    }
+                }
+                return std::move( output );
+            }
+            
+            inline Move gaussian( const float sigma, const int threads = 1,
+                                  const Border border = Border::mirror, const T border_color = T() ) const
+            {
+                ImageType output;
+                
+                gaussian_into( output, sigma, threads, border, border_color );
+                return std::move( output );
+            }
+            
+            /*
+             *  gaussian_fir_into(), or gaussian_recursive_into() from kernel radius recursive_gaussian_radius().
+             *  the recursive filter reads every pixel of a row and a column, not only those within the radius.
+             */
+            void gaussian_into( ImageType& output, const float sigma, const int threads = 1,
+                                const Border border = Border::mirror, const T border_color = T() ) const
+            {
+                if( sigma < 0.0f )
+                {
+                    throw std::range_error( "gaussian : sigma < 0.0f" );
+                }
+                ScratchVector< int > kernel;
+                if( gaussian_kernel( sigma, kernel ) >= recursive_gaussian_radius() )
+                {
+                    gaussian_recursive_into( output, sigma, threads, border, border_color );
+                    return;
+                }
+                gaussian_fir_into( output, sigma, threads, border, border_color );
+            }
+            
+            inline Move gaussian_fir( const float sigma, const int threads = 1,
+                                      const Border border = Border::mirror, const T border_color = T() ) const
+            {
+                ImageType output;
+                
+                gaussian_fir_into( output, sigma, threads, border, border_color );
+                return std::move( output );
+            }
+            
+            /*
+             *  gaussian by the kernel of gaussian_kernel(). an output pixel depends only on the pixels
+             *  within the kernel radius, so tiles of an image blur to the same pixels as the whole image.
+             *
+             *  [in]output  the buffer is reused when it is large enough. may be this image.
+             *  [in]threads cap of the threads. bands of rows are blurred at the same time,
+             *              each from its own rows plus the radius. the result does not depend on it.
+             *  [in]border  pixels read outside of the image. the radius may be larger than the image.
+             */
+            void gaussian_fir_into( ImageType& output, const float sigma, const int threads = 1,
+                                    const Border border = Border::mirror, const T border_color = T() ) const
+            {
+                if( sigma < 0.0f )
+                {
+                    throw std::range_error( "gaussian : sigma < 0.0f" );
+                }
+                
+                ScratchVector< int > kernel;
+                const int radius = gaussian_kernel( sigma, kernel );
+                
+                if( radius == 0 || length == 0 )
+                {
+                    output = *this;
+                    return;
+                }
+                
+                // a reference to our pixels, so output allocates new ones if it shares them.
+                ImageType shared;
+                if( m_buffer != nullptr )
+                {
+                    shared = *this;
+                }
+                const View input = *this;
+                
+                output.create( size, Initialize::none );
+                
+                // rows are written through this pointer. Image::row() would detach in every thread.
+                T* const output_pixels = output.row( 0 );
+                const ptrdiff_t output_stride = output.stride;
+                const int bands = band_count( output.height, threads );
+                const int side = radius*2 + 1;
+                
+                // rows of Border::constant point to this row.
+                const ScratchVector< T > border_row( border == Border::constant ? width : 0, border_color );
+                
+                int kernel_sum = 0;
+                for( int i=0; i<side; ++i )
+                {
+                    kernel_sum += kernel[i];
+                }
+                
+                // 8bit channels run as flat uint8_t rows. the loops below are the reference.
+                if( T::TYPE_BYTE == 1 && simd_level() != SimdLevel::none )
+                {
+                    const int line = ( width + radius*2 ) * T::CHANNEL;
+                    ScratchVector< int16_t > vertical( (size_t)line * bands );
+                    ScratchVector< const uint8_t* > rows( (size_t)side * bands );
+                    
+                    // the vertical filter of a column of the border color.
+                    int16_t border_vertical[ T::CHANNEL ];
+                    for( int c=0; c<T::CHANNEL; ++c )
+                    {
+                        border_vertical[c] = (int16_t)( ( (int)border_color[c] * kernel_sum ) >> 6 );
+                    }
+                    
+                    parallel_bands( output.height, threads, [&]( const int band, const int begin, const int end )
+                    {
+                        int16_t* p_vertical = &vertical[ (size_t)line * band ];
+                        const uint8_t** p_rows = &rows[ (size_t)side * band ];
+                        
+                        for( int y=begin; y<end; ++y )
+                        {
+                            for( int i=0; i<side; ++i )
+                            {
+                                const int index = border_index( y+i-radius, input.height, border );
+                                p_rows[i] = (const uint8_t*)( index < 0 ? &border_row[0] : input.row( index ) );
+                            }
+                            gaussian_vertical_u8( p_rows, &kernel[0], side, p_vertical + radius*T::CHANNEL, input.width * T::CHANNEL );
+                            fill_border_columns( p_vertical + radius*T::CHANNEL, input.width, radius, T::CHANNEL, border, border_vertical );
+                            gaussian_horizontal_u8( p_vertical, T::CHANNEL, &kernel[0], side,
+                                                    (uint8_t*)offset_row( output_pixels, y*output_stride ), input.width * T::CHANNEL );
+                        }
+                    } );
+                    return;
+                }
+                
+                const int line = width + radius*2;
+                ScratchVector< ColorBuffer > horizontal( (size_t)line * bands );
+                ScratchVector< const T* > rows( (size_t)side * bands );
+                const ColorBuffer border_vertical = ( ColorBuffer( border_color ) * kernel_sum ) >> 6;
+                
+                const int block = vertical_block();
+                
+                parallel_bands( output.height, threads, [&]( const int band, const int begin, const int end )
+                {
+                    // locals. the stores below may alias values captured by reference.
+                    const int columns = input.width;
+                    const int block_columns = block;
+                    
+                    ColorBuffer* p_horizontal = &horizontal[ (size_t)line * band ];
+                    ColorBuffer* p_sum = p_horizontal + radius;
+                    const T** p_rows = &rows[ (size_t)side * band ];
+                    
+                    for( int y=begin; y<end; ++y )
+                    {
+                        T* p_output = offset_row( output_pixels, y*output_stride );
+                        
+                        for( int i=0; i<side; ++i )
+                        {
+                            const int index = border_index( y+i-radius, input.height, border );
+                            p_rows[i] = index < 0 ? &border_row[0] : input.row( index );
+                        }
+                        
+                        // vertical filter. summed in blocks of columns, one row after another.
+                        for( int x0=0; x0<columns; x0+=block_columns )
+                        {
+                            const int x1 = fast_min( x0 + block_columns, columns );
+                            const T* p_input = p_rows[0];
+                            const int k = kernel[0];
+                            
+                            for( int x=x0; x<x1; ++x )
+                            {
+                                p_sum[x] = ColorBuffer( p_input[x] ) * k;
+                            }
+                            for( int i=1; i<side; ++i )
+                            {
+                                const T* p_input = p_rows[i];
+                                const int k = kernel[i];
+                                
+                                for( int x=x0; x<x1; ++x )
+                                {
+                                    p_sum[x] += ColorBuffer( p_input[x] ) * k;
+                                }
+                            }
+                            for( int x=x0; x<x1; ++x )
+                            {
+                                p_sum[x] >>= 6;
+                            }
+                        }
+                        fill_border_columns( p_sum, columns, radius, 1, border, &border_vertical );
+                        
+                        // horizontal filter.
+                        unrolled_taps( side, [&]( const auto constant )
+                        {
+                            gaussian_horizontal_line< decltype( constant )::value >( p_horizontal, &kernel[0], side,
+                                                                                   p_output, columns );
+                        } );
+                    }
+                } );
+            }
+            
+            inline Move gaussian_recursive( const float sigma, const int threads = 1,
+                                            const Border border = Border::mirror, const T border_color = T() ) const
+            {
+                ImageType output;
+                
+                gaussian_recursive_into( output, sigma, threads, border, border_color );
+                return std::move( output );
+            }
+            
+            /*
+             *  gaussian() by the recursive filter. the cost per pixel does not depend on sigma.
+             *  it has the deviation and the gain of the kernel of gaussian(), and is within 1 level on average.
+             *  next to hard edges it differs by up to about 12 levels, where the kernel is cut at 2 deviations.
+             *
+             *  [in]output may be this image.
+             */
+            void gaussian_recursive_into( ImageType& output, const float sigma, const int threads = 1,
+                                          const Border border = Border::mirror, const T border_color = T() ) const
+            {
+                if( sigma < 0.0f )
+                {
+                    throw std::range_error( "gaussian : sigma < 0.0f" );
+                }
+                
+                ScratchVector< int > kernel;
+                const int radius = gaussian_kernel( sigma, kernel );
+                
+                if( radius == 0 || length == 0 )
+                {
+                    output = *this;
+                    return;
+                }
+                
+                using Channel = typename T::Type;
+                const RecursiveGaussian g( kernel_deviation( kernel ), kernel_gain( kernel ) );
+                float color[ T::CHANNEL ];
+                
+                for( int c=0; c<T::CHANNEL; ++c )
+                {
+                    color[c] = (float)border_color[c];
+                }
+                
+                // every pixel is read before output is created, so output may be this image.
+                const int width  = this->width;
+                const int height = this->height;
+                ScratchBuffer< float > horizontal( (size_t)length * T::CHANNEL );
+                recursive_gaussian_rows< T::CHANNEL >( (const Channel*)row( 0 ), stride, width, height, g, threads,
+                                                        border, color, &horizontal[0] );
+                
+                output.create( { width, height }, Initialize::none );
+                recursive_gaussian_columns< T::CHANNEL >( &horizontal[0], width, height, g, threads, border, color,
+                                                           (Channel*)output.row( 0 ), output.stride );
+            }
+            
+            inline Move gaussian_approx( const float sigma, const int threads = 1,
+                                         const Border border = Border::mirror, const T border_color = T() ) const
+            {
+                ImageType output;
+                
+                gaussian_approx_into( output, sigma, threads, border, border_color );
+                return std::move( output );
+            }
+            
+            /*
+             *  gaussian() by three box filters of running sums, for previews. the cost per pixel does not
+             *  depend on sigma. the boxes have the deviation and the gain of the kernel of gaussian().
+             *  from sigma 4 the result is within 5 levels of gaussian(), 0.5 on average. below that the
+             *  boxes are too coarse, up to 46 levels off on noise at sigma 2.
+             *
+             *  [in]output may be this image.
+             */
+            void gaussian_approx_into( ImageType& output, const float sigma, const int threads = 1,
+                                       const Border border = Border::mirror, const T border_color = T() ) const
+            {
+                if( sigma < 0.0f )
+                {
+                    throw std::range_error( "gaussian : sigma < 0.0f" );
+                }
+                
+                ScratchVector< int > kernel;
+                const int radius = gaussian_kernel( sigma, kernel );
+                
+                if( radius == 0 || length == 0 )
+                {
+                    output = *this;
+                    return;
+                }
+                
+                using Channel = typename T::Type;
+                using Sum = typename BoxSum< Channel >::Type;
+                int radii[3];
+                box_cascade_radii( kernel_deviation( kernel ), radii );
+                Sum color[ T::CHANNEL ];
+                
+                for( int c=0; c<T::CHANNEL; ++c )
+                {
+                    store_box( color[c], (float)border_color[c] * BoxSum< Channel >::scale() );
+                }
+                
+                // every pixel is read before output is created, so output may be this image.
+                const int width  = this->width;
+                const int height = this->height;
+                ScratchBuffer< Sum > horizontal( (size_t)length * T::CHANNEL );
+                box_gaussian_rows< T::CHANNEL >( (const Channel*)row( 0 ), stride, width, height, radii, threads,
+                                                 border, color, &horizontal[0] );
+                
+                output.create( { width, height }, Initialize::none );
+                box_gaussian_columns< T::CHANNEL >( &horizontal[0], width, height, radii, kernel_gain( kernel ), threads,
+                                                    border, color, (Channel*)output.row( 0 ), output.stride );
+            }
+            
+            inline Move median( const int radius, const int threads = 1,
+                                const Border border = Border::mirror, const T border_color = T() ) const
+            {
+                ImageType output;
+                
+                median_into( output, radius, threads, border, border_color );
+                return std::move( output );
+            }
+            
+            /*
+             *  median of the radius*2+1 square around each pixel, for each channel of 8bit images.
+             *  the cost per pixel does not depend on radius.
+             *
+             *  [in]output may be this image.
+             *  [in]border pixels read outside of the image. the radius may be larger than the image.
+             */
+            void median_into( ImageType& output, const int radius, const int threads = 1,
+                              const Border border = Border::mirror, const T border_color = T() ) const
+            {
+                static_assert( T::TYPE_BYTE == 1, "median : channels of T must be 8bit" );
+                
+                if( radius < 0 )
+                {
+                    throw std::range_error( "median : radius < 0" );
+                }
+                if( radius == 0 || length == 0 )
+                {
+                    output = *this;
+                    return;
+                }
+                
+                // a reference to our pixels, so output allocates new ones if it shares them.
+                ImageType shared;
+                if( m_buffer != nullptr )
+                {
+                    shared = *this;
+                }
+                const View input = *this;
+                uint8_t color[ T::CHANNEL ];
+                
+                for( int c=0; c<T::CHANNEL; ++c )
+                {
+                    color[c] = (uint8_t)border_color[c];
+                }
+                
+                output.create( size, Initialize::none );
+                
+                // 16bit counts while the square has less than 65536 pixels.
+                if( radius <= 127 )
+                {
+                    median_filter< T::CHANNEL, uint16_t >( (const uint8_t*)input.row( 0 ), input.stride, width, height,
+                                                           radius, threads, border, color,
+                                                           (uint8_t*)output.row( 0 ), output.stride );
+                }
+                else
+                {
+                    median_filter< T::CHANNEL, uint32_t >( (const uint8_t*)input.row( 0 ), input.stride, width, height,
+                                                           radius, threads, border, color,
+                                                           (uint8_t*)output.row( 0 ), output.stride );
+                }
+            }
+            
+            inline Move erode( const int radius_x, const int radius_y, const int threads = 1,
+                               const Border border = Border::mirror, const T border_color = T() ) const
+            {
+                ImageType output;
+                
+                morphology_into( output, Morphology::erode, radius_x, radius_y, threads, border, border_color );
+                return std::move( output );
+            }
+            
+            inline Move dilate( const int radius_x, const int radius_y, const int threads = 1,
+                                const Border border = Border::mirror, const T border_color = T() ) const
+            {
+                ImageType output;
+                
+                morphology_into( output, Morphology::dilate, radius_x, radius_y, threads, border, border_color );
+                return std::move( output );
+            }
+            
+            inline Move open( const int radius_x, const int radius_y, const int threads = 1,
+                              const Border border = Border::mirror, const T border_color = T() ) const
+            {
+                ImageType output;
+                
+                morphology_into( output, Morphology::open, radius_x, radius_y, threads, border, border_color );
+                return std::move( output );
+            }
+            
+            inline Move close( const int radius_x, const int radius_y, const int threads = 1,
+                               const Border border = Border::mirror, const T border_color = T() ) const
+            {
+                ImageType output;
+                
+                morphology_into( output, Morphology::close, radius_x, radius_y, threads, border, border_color );
+                return std::move( output );
+            }
+            
+            inline Move morphology_gradient( const int radius_x, const int radius_y, const int threads = 1,
+                                             const Border border = Border::mirror, const T border_color = T() ) const
+            {
+                ImageType output;
+                
+                morphology_into( output, Morphology::gradient, radius_x, radius_y, threads, border, border_color );
+                return std::move( output );
+            }
+            
+            /*
+             *  morphology with the (radius_x*2+1) x (radius_y*2+1) rectangle, for each channel.
+             *  the min and max run as separable passes of three comparisons per pixel for any radius.
+             *
+             *  [in]output    may be this image.
+             *  [in]threads   cap of the threads. the result does not depend on it.
+             *  [in]border    pixels read outside of the image, in every pass of open and close.
+             */
+            void morphology_into( ImageType& output, const Morphology operation, const int radius_x, const int radius_y,
+                                  const int threads = 1, const Border border = Border::mirror,
+                                  const T border_color = T() ) const
+            {
+                if( radius_x < 0 || radius_y < 0 )
+                {
+                    throw std::range_error( "morphology : radius < 0" );
+                }
+                if( length == 0 )
+                {
+                    output = *this;
+                    return;
+                }
+                
+                // a reference to our pixels, so output allocates new ones if it shares them.
+                ImageType shared;
+                if( m_buffer != nullptr )
+                {
+                    shared = *this;
+                }
+                const View input = *this;
+                
+                if( operation == Morphology::erode || operation == Morphology::dilate )
+                {
+                    output.create( size, Initialize::none );
+                    morphology_filter< T, ColorBuffer >( input.row( 0 ), input.stride, width, height, radius_x, radius_y,
+                                                         operation == Morphology::erode, threads, border, border_color,
+                                                         output.row( 0 ), output.stride );
+                }
+                else if( operation == Morphology::open || operation == Morphology::close )
+                {
+                    const bool minimum = operation == Morphology::open;
+                    ImageType middle( size, Initialize::none );
+                    
+                    morphology_filter< T, ColorBuffer >( input.row( 0 ), input.stride, width, height, radius_x, radius_y,
+                                                         minimum, threads, border, border_color,
+                                                         middle.row( 0 ), middle.stride );
+                    output.create( size, Initialize::none );
+                    morphology_filter< T, ColorBuffer >( middle.row( 0 ), middle.stride, width, height, radius_x, radius_y,
+                                                         !minimum, threads, border, border_color,
+                                                         output.row( 0 ), output.stride );
+                }
+                else
+                {
+                    ImageType eroded( size, Initialize::none );
+                    
+                    morphology_filter< T, ColorBuffer >( input.row( 0 ), input.stride, width, height, radius_x, radius_y,
+                                                         true, threads, border, border_color,
+                                                         eroded.row( 0 ), eroded.stride );
+                    output.create( size, Initialize::none );
+                    morphology_filter< T, ColorBuffer >( input.row( 0 ), input.stride, width, height, radius_x, radius_y,
+                                                         false, threads, border, border_color,
+                                                         output.row( 0 ), output.stride );
+                    
+                    using Channel = typename T::Type;
+                    for( int y=0; y<height; ++y )
+                    {
+                        const T* p_eroded = eroded.row( y );
+                        T* p_output = output.row( y );
+                        
+                        for( int x=0; x<width; ++x )
+                        {
+                            for( int c=0; c<T::CHANNEL; ++c )
+                            {
+                                p_output[x][c] = (Channel)( p_output[x][c] - p_eroded[x][c] );
+                            }
+                        }
+                    }
+                }
+            }
+
+#define BlendConcept( FORE ) \
+            ImageType output( size, Initialize::none ); \
+            \
+            const int ialpha = (int)(alpha * 1024.0f); \
+            \
+            for( int y=0; y<height; ++y ) \
+            { \
+                const T* back = row( y ); \
+                T* p_output = output.row( y ); \
+                \
+                for( int x=0; x<width; ++x ) \
+                { \
+                    p_output[x] = gs::alpha_blend( back[x], FORE, ialpha ); \
+                } \
+            } \
+            \
+            return std::move(output)
+            
+#define fore_color ColorBuffer(fore.row(y)[x])
+#define back_color ColorBuffer(back[x])
+#define args_color ColorBuffer(color)
+
+            Move alpha_blend( const ImageView& fore, float alpha ) const
+            {
+                BlendConcept( fore_color );
+            }
+
+            Move alpha_blend( const T color, float alpha ) const
+            {
+                BlendConcept( args_color );
+            }
+
+            // blends into this view. fore may be this view.
+            void alpha_blend_inplace( const ImageView& fore, float alpha )
+            {
+                const int ialpha = (int)(alpha * 1024.0f);
+                
+                for( int y=0; y<height; ++y )
+                {
+                    T* back = row( y );
+                    
+                    for( int x=0; x<width; ++x )
+                    {
+                        back[x] = gs::alpha_blend( back[x], fore_color, ialpha );
+                    }
+                }
+            }
+            
+            void alpha_blend_inplace( const T color, float alpha )
+            {
+                const int ialpha = (int)(alpha * 1024.0f);
+                
+                for( int y=0; y<height; ++y )
+                {
+                    T* back = row( y );
+                    
+                    for( int x=0; x<width; ++x )
+                    {
+                        back[x] = gs::alpha_blend( back[x], args_color, ialpha );
+                    }
+                }
+            }
+            
+            Move addition_blend( const ImageView& fore, float alpha ) const
+            {
+                BlendConcept( ( back_color + fore_color ).limit_max() );
+            }
+
+            Move addition_blend( const T color, float alpha ) const
+            {
+                BlendConcept( ( back_color + args_color ).limit_max() );
+            }
+            
+            Move subtract_blend( const ImageView& fore, float alpha ) const
+            {
+                BlendConcept( ( back_color - fore_color ).limit_min() );
+            }
+            
+            Move multiply_blend( const ImageView& fore, float alpha ) const
+            {
+                BlendConcept( back_color * fore_color / 255 );
+            }
+            
+            Move difference_blend( const ImageView& fore, float alpha ) const
+            {
+                BlendConcept( ( fore_color - back_color ).abs() );
+            }
+            
+            Move color_burn_blend( const ImageView& fore, float alpha ) const
+            {
+                BlendConcept(
+                    (ColorBuffer(255) -
+                     (( ColorBuffer(255) - back_color ) * 255 / fore_color.max(1) )).limit_min()
+                );
+            }
+            
+            Move darken_blend( const ImageView& fore, float alpha ) const
+            {
+                BlendConcept( ColorBuffer::compare_min( back_color, fore_color ) );
+            }
+            
+            Move lighten_blend( const ImageView& fore, float alpha ) const
+            {
+                BlendConcept( ColorBuffer::compare_max( back_color, fore_color ) );
+            }
+
+            Move linear_burn_blend( const ImageView& fore, float alpha ) const
+            {
+                BlendConcept( (back_color + fore_color - 255).limit_min() );
+            }
+
+            Move screen_blend( const ImageView& fore, float alpha ) const
+            {
+                BlendConcept( back_color + fore_color - back_color * fore_color / 255 );
+            }
+
+            Move color_dodge_blend( const ImageView& fore, float alpha ) const
+            {
+                BlendConcept( (back_color * 255 / (ColorBuffer(255) - fore_color).max(1)).limit_max() );
+            }
+
+            Move exclusion_blend( const ImageView& fore, float alpha ) const
+            {
+                BlendConcept( ( back_color + fore_color - 2 * back_color * fore_color / 255).limit_min() );
+            }
+            
+#undef BlendConcept
+#undef fore_color
+#undef back_color
+#undef args_color
+
+#define BlendConceptChannel( FORE ) \
+    ImageType output( size, Initialize::none ); \
+    \
+    const int ialpha = (int)(alpha * 1024.0f); \
+    \
+    for( int y=0; y<height; ++y ) \
+    { \
+        const T* back = row( y ); \
+        T* p_output = output.row( y ); \
+        \
+        for( int x=0; x<width; ++x ) \
+        { \
+            for( int c=0; c<T::CHANNEL; ++c ) \
+            { \
+                p_output[x][c] = gs::alpha_blend( back[x][c], (typename T::Type)(FORE), ialpha ); \
+            } \
+        } \
+    } \
+    \
+    return std::move(output)
+            
+#define fore_color (fore.row(y)[x][c])
+#define back_color (back[x][c])
+#define args_color (color[c])
+
+            Move overlay_blend( const ImageView& fore, float alpha ) const
+            {
+                BlendConceptChannel( back_color < 128 ?
+                             back_color*fore_color*2/255 :
+                             2*(back_color+fore_color-back_color*fore_color/255)-255 );
+            }
+
+            Move overlay_blend( const T color, float alpha ) const
+            {
+                BlendConceptChannel( back_color < 128 ?
+                                    back_color*args_color*2/255 :
+                                    2*(back_color+args_color-back_color*args_color/255)-255 );
+            }
+            
+            Move soft_light_blend( const ImageView& fore, float alpha ) const
+            {
+                BlendConceptChannel( fore_color < 128 ?
+                             std::pow( back_color / 255.0f, 2.0f * (1.0f - fore_color / 255.0f) ) * 255.0f :
+                             std::pow( back_color / 255.0f, 2.0f * (1.0f / (2.0f * fore_color / 255.0f) ) ) * 255.0f );
+            }
+
+            Move soft_light_blend( const T color, float alpha ) const
+            {
+                BlendConceptChannel( args_color < 128 ?
+                                    std::pow( back_color / 255.0f, 2.0f * (1.0f - args_color / 255.0f) ) * 255.0f :
+                                    std::pow( back_color / 255.0f, 2.0f * (1.0f / (2.0f * args_color / 255.0f) ) ) * 255.0f );
+            }
+            
+            Move hard_light_blend( const ImageView& fore, float alpha ) const
+            {
+                BlendConceptChannel( fore_color < 128 ?
+                             back_color*fore_color*2/255 :
+                             2*(back_color+fore_color-back_color*fore_color/255) - 255 );
+            }
+
+            Move hard_light_blend( const T color, float alpha ) const
+            {
+                BlendConceptChannel( args_color < 128 ?
+                                    back_color*args_color*2/255 :
+                                    2*(back_color+args_color-back_color*args_color/255) - 255 );
+            }
+            
+            Move vivid_light_blend( const ImageView& fore, float alpha ) const
+            {
+                BlendConceptChannel( fore_color < 128 ?
+                                 back_color < 255-2*fore_color ?
+                                    0 :
+                                    (back_color-(255-2*fore_color)) / (2 * fast_max(fore_color,1)) :
+                                 back_color < 2*(255-fore_color) ?
+                                    back_color / 2*(255-fore_color) :
+                                    255
+                             );
+            }
+
+            Move vivid_light_blend( const T color, float alpha ) const
+            {
+                BlendConceptChannel( args_color < 128 ?
+                                back_color < 255-2*args_color ?
+                                    0 :
+                                    (back_color-(255-2*args_color)) / (2 * fast_max(args_color,1)) :
+                                back_color < 2*(255-args_color) ?
+                                    back_color / 2*(255-args_color) :
+                                    255
+                                    );
+            }
+            
+            Move linear_light_blend( const ImageView& fore, float alpha ) const
+            {
+                BlendConceptChannel( fore_color < 128 ?
+                                 back_color < 255 - 2 * fore_color ?
+                                    0 :
+                                    fast_min( 2 * fore_color + back_color + 255, 255 ) :
+                             
+                                 back_color < 2 * (255-fore_color) ?
+                                    fast_min( 2 * fore_color + back_color + 255, 255 ) :
+                                    255
+                             );
+            }
+
+            Move linear_light_blend( const T color, float alpha ) const
+            {
+                BlendConceptChannel( args_color < 128 ?
+                                    back_color < 255 - 2 * args_color ?
+                                        0 :
+                                        fast_min( 2 * args_color + back_color + 255, 255 ) :
+                                    
+                                    back_color < 2 * (255-args_color) ?
+                                        fast_min( 2 * args_color + back_color + 255, 255 ) :
+                                        255
+                                    );
+            }
+            
+            Move pin_light_blend( const ImageView& fore, float alpha ) const
+            {
+                BlendConceptChannel( fore_color < 128 ?
+                                 back_color < 255 - 2 * fore_color ?
+                                    back_color :
+                                    2 * fore_color :
+                                 
+                                 back_color < 2 * fore_color - 255 ?
+                                    2 * fore_color - 255 :
+                                    back_color
+                             );
+            }
+
+            Move pin_light_blend( const T color, float alpha ) const
+            {
+                BlendConceptChannel( args_color < 128 ?
+                                    back_color < 255 - 2 * args_color ?
+                                    back_color :
+                                    2 * args_color :
+                                    
+                                    back_color < 2 * args_color - 255 ?
+                                    2 * args_color - 255 :
+                                    back_color
+                                    );
+            }
+            
+#undef BlendConceptChannel
+#undef fore_color
+#undef back_color
+#undef args_color
+
+            void write( std::ostream& output ) const
+            {
+                output.clear();
+                
+                core::BitmapHeader header;
+                ScratchVector< uint8_t > line( align_size( width*sizeof(T), 4 ) );
+                
+                header.biWidth     = width;
+                header.biHeight    = height;
+                header.biBitCount  = sizeof(T)*8;
+                header.biSizeImage = line.size()*height;
+                header.bfOffBits   = sizeof(core::BitmapHeader);
+                if( header.biBitCount == 8 )
+                {
+                    header.bfOffBits += 4 * 256; //ColorTable
+                }
+                header.bfSize = header.bfOffBits + header.biSizeImage;
+                
+                output.write( (char*)&header, sizeof(core::BitmapHeader) );
+                
+                if( header.biBitCount == 8 ) // ColorTable
+                {
+                    uint8_t table[4] = { 0, 0, 0, 255 };
+                    for( int i=0; i<256; ++i )
+                    {
+                        table[0] = table[1] = table[2] = i;
+                        output.write( (char*)table, 4 );
+                    }
+                }
+                
+                for( int y=height-1; y>=0; --y )
+                {
+                    const T* p_input = row( y );
+                    uint8_t* data = &line[0];
+                    
+                    for( int x=0; x<width; ++x, data += sizeof(T) )
+                    {
+                        encode_bitmap_pixel( p_input[x], data );
+                    }
+                    output.write( (const char*)&line[0], line.size() );
+                }
+            }
+            
+            void write( const std::string& filepath ) const
+            {
+                std::fstream file;
+                file.open( filepath, std::ios::out | std::ios::binary );
+                write( file );
+                file.close();
+            }
+            
+            inline const ImageView& operator>>( const std::string& filepath ) const
+            {
+                write( filepath );
+                return *this;
+            }
+        };
+        
+        template <class T, class ColorBuffer> class Image : public ImageView<T,ColorBuffer>
+        {
+        public:
+            using View = ImageView<T,ColorBuffer>;
+            using Move = typename View::Move;
+            
+        private:
+            friend Move;
+            
+            Allocator* m_allocator = nullptr;
+            
+            // takes a reference to buffer.
+            void share( SharedBuffer* buffer, T* pixels, const SizeI& size, const ptrdiff_t stride )
+            {
+                if( buffer != nullptr )
+                {
+                    buffer->retain();
+                }
+                if( this->m_buffer != nullptr )
+                {
+                    this->m_buffer->release();
+                }
+                this->m_buffer = buffer;
+                this->set_view( pixels, size, stride );
+            }
+            
+            // rows start at ROW_ALIGNMENT boundaries. pixels are not initialized.
+            // size is taken by value, it may be our own size.
+            void allocate( const SizeI size )
+            {
+                const ptrdiff_t stride = (ptrdiff_t)align_size( size.width*sizeof(T), ROW_ALIGNMENT );
+                const size_t bytes = stride*size.height;
+                
+                // the current buffer is reused when nobody else sees it.
+                if( this->m_buffer == nullptr || !this->m_buffer->unique() ||
+                    this->m_buffer->capacity() < bytes || this->m_buffer->allocator() != allocator() )
+                {
+                    SharedBuffer* buffer = SharedBuffer::create( bytes, allocator() );
+                    
+                    share( buffer, nullptr, SizeI( 0, 0 ), 0 );
+                    buffer->release();
+                }
+                this->set_view( (T*)this->m_buffer->data(), size, stride );
+            }
+            
+            // copy-on-write. called before every mutable access.
+            inline void detach()
+            {
+                if( this->m_buffer != nullptr && !this->m_buffer->unique() )
+                {
+                    const View shared = *this;
+                    
+                    this->m_buffer->retain();
+                    allocate( shared.size );
+                    for( int y=0; y<shared.height; ++y )
+                    {
+                        memcpy( View::row( y ), shared.row( y ), sizeof(T)*shared.width );
+                    }
+                    shared.m_buffer->release();
+                }
+            }
+            
+            void convert( const ImageView<GRAY,ColorBufferGRAY>& ){ throw std::bad_function_call(); }
+            void convert( const ImageView<RGB,ColorBufferRGB>& ){ throw std::bad_function_call(); }
+            void convert( const ImageView<HMB,ColorBufferHMB>& ){ throw std::bad_function_call(); }
+            void convert( const ImageView<RGBA,ColorBufferRGBA>& ){ throw std::bad_function_call(); }
+            void convert( const ImageView<GRAY_F,ColorBufferGRAY_F>& ){ throw std::bad_function_call(); }
+            
+        public:
+            Image() noexcept{}
+            Image( const Image& value ) noexcept{ *this = value; }
+            explicit Image( const View& value ){ *this = value; }
+            Image( Image&& value ) noexcept{ *this = std::forward<Image>(value); }
+            Image( Move&& value ) noexcept{ *this = std::forward<Move>(value); }
+            Image( const SizeI& size, const Initialize initialize = Initialize::zero ){ create( size, initialize ); }
+            virtual ~Image()
+            {
+                if( this->m_buffer != nullptr )
+                {
+                    this->m_buffer->release();
+                }
+            }
+            virtual void create( const SizeI& size, const Initialize initialize = Initialize::zero )
+            {
+                allocate( size );
+                if( initialize == Initialize::zero )
+                {
+                    memset( this->m_buffer->data(), 0, this->stride*size.height );
+                }
+            }
+            
+            // allocator of the next buffers. nullptr follows default_allocator() of the calling thread.
+            inline Allocator* allocator() const
+            {
+                return m_allocator != nullptr ? m_allocator : default_allocator();
+            }
+            inline void set_allocator( Allocator* allocator )
+            {
+                m_allocator = allocator;
+            }
+            
+            // copies the pixels into a buffer of allocator(), never shares.
+            Image& copy( const View& value )
+            {
+                if( value.m_buffer == this->m_buffer && value.m_buffer != nullptr )
+                {
+                    // a view of this image.
+                    Image output;
+                    output.set_allocator( m_allocator );
+                    output.copy( View( value.m_pixels, value.size, value.stride ) );
+                    return *this = std::move( output );
+                }
+                allocate( value.size );
+                for( int y=0; y<value.height; ++y )
+                {
+                    memcpy( View::row( y ), value.row( y ), sizeof(T)*value.width );
+                }
+                return *this;
+            }
+            virtual void clear()
+            {
+                share( nullptr, nullptr, SizeI( 0, 0 ), 0 );
+            }
+            
+            inline T* row( const int y ){ detach(); return View::row( y ); }
+            inline const T* row( const int y ) const{ return View::row( y ); }
+            inline T& operator[]( const uint64_t index ){ detach(); return View::operator[]( index ); };
+            inline const T& operator[]( const uint64_t index ) const{ return View::operator[]( index ); };
+            inline T& operator[]( const PointI& point ){ detach(); return View::operator[]( point ); };
+            inline const T& operator[]( const PointI& point ) const{ return View::operator[]( point ); };
+            
+            // writable view. the pixels are detached from other images first.
+            inline View view( const RectangleI& rectangle ){ detach(); return View::view( rectangle ); }
+            inline const View view( const RectangleI& rectangle ) const{ return View::view( rectangle ); }
+            
+            inline void fill( const T color ){ detach(); View::fill( color ); }
+            inline void fill( const T color, const RectangleI& rectangle ){ detach(); View::fill( color, rectangle ); }
+            inline void fill( const T color, const CircleF& circle ){ detach(); View::fill( color, circle ); }
+            
+            inline void alpha_blend_inplace( const View& fore, float alpha ){ detach(); View::alpha_blend_inplace( fore, alpha ); }
+            inline void alpha_blend_inplace( const T color, float alpha ){ detach(); View::alpha_blend_inplace( color, alpha ); }
+            
+            // shares the pixels of an image view, copies other views.
+            Image& operator=( const View& value )
+            {
+                if( value.m_buffer != nullptr )
+                {
+                    share( value.m_buffer, (T*)value.row( 0 ), value.size, value.stride );
+                    return *this;
+                }
+                if( this->m_pixels == value.row( 0 ) && this->size == value.size )
+                {
+                    return *this;
+                }
+                return copy( value );
+            }
+            
+            inline Image& operator=( const Image& value )
+            {
+                return *this = (const View&)value;
+            }
+            
+            template <class C, class B>
+            Image& operator=( const ImageView<C,B>& image )
+            {
+                convert( image );
+                return *this;
+            }
+            
+            inline Image& operator=( Image&& value )
+            {
+                if( this != &value )
+                {
+                    std::swap( this->m_buffer, value.m_buffer );
+                    this->set_view( value.m_pixels, value.size, value.stride );
+                    value.share( nullptr, nullptr, SizeI( 0, 0 ), 0 );
+                }
+                return *this;
+            }
+            
+            inline Image& operator=( Move&& value )
+            {
+                std::swap( this->m_buffer, value.buffer );
+                this->set_view( value.pixels, value.size, value.stride );
+                value.pixels = nullptr;
+                value.size   = SizeI( 0, 0 );
+                value.stride = 0;
+                if( value.buffer != nullptr )
+                {
+                    value.buffer->release();
+                    value.buffer = nullptr;
+                }
+                return *this;
+            }
+            
+            /*
+             *  [return] top-down view of the bottom-up rows in image_data. (no copy)
+             *
+             *  [in]image_data
+             *       bitmap file data. must outlive the view.
+             *       only single channel images are mapped, multi channel bitmaps are stored in BGR order.
+             */
+            static const View map_bitmap( const std::vector< uint8_t >& image_data )
+            {
+                if( T::CHANNEL != 1 )
+                {
+                    throw std::bad_function_call();
+                }
+                
+                const core::BitmapHeader* header = (const core::BitmapHeader*)&image_data[0];
+                int index = sizeof(core::BitmapHeader);
+                
+                if( header->bfOffBits != 0 )
+                {
+                    index = header->bfOffBits;
+                }
+                else if( header->biBitCount == 8 ) // ColorTable
+                {
+                    index += 4*256;
+                }
+                if( header->biBitCount != sizeof(T)*8 )
+                {
+                    throw std::range_error( "map_bitmap : biBitCount != sizeof(T)*8" );
+                }
+                if( header->biBitCount == 8 && !core::gray_bitmap( image_data ) )
+                {
+                    throw std::range_error( "map_bitmap : the color table is not gray" );
+                }
+                
+                const ptrdiff_t stride = (ptrdiff_t)align_size( header->biWidth*sizeof(T), 4 );
+                const uint8_t* bottom = &image_data[index];
+                
+                return View( (T*)(bottom + stride*(header->biHeight-1)), { header->biWidth, header->biHeight }, -stride );
+            }
+
+            void read( const std::vector< uint8_t >& image_data )
+            {
+                const core::BitmapHeader* header = (const core::BitmapHeader*)&image_data[0];
+                int index = sizeof(core::BitmapHeader);
+                
+                // bfOffBits already skips the ColorTable.
+                if( header->bfOffBits != 0 )
+                {
+                    index = header->bfOffBits;
+                }
+                else if( header->biBitCount == 8 ) // ColorTable
+                {
+                    index += 4*256;
+                }
+                
+                const int byte_count = header->biBitCount/8;
+                if( byte_count != 1 && byte_count != 3 && byte_count != 4 )
+                {
+                    throw std::range_error( "read : biBitCount is not 8, 24 or 32" );
+                }
+                
+                uint8_t palette[256][3];
+                bitmap_palette( image_data, palette );
+                
+                allocate( {header->biWidth, header->biHeight} );
+                
+                const size_t row_bytes = align_size( this->width*byte_count, 4 );
+                
+                for( int y=this->height-1; y>=0; --y, index += row_bytes )
+                {
+                    const uint8_t* data = &image_data[index];
+                    T* p_output = View::row( y );
+                    
+                    for( int x=0; x<this->width; ++x, data += byte_count )
+                    {
+                        decode_bitmap_pixel( data, byte_count, palette, p_output[x] );
+                    }
+                }
+            }
+
+            void read( std::istream& stream )
+            {
+                core::BitmapHeader header;
+                uint8_t palette[256][3];
+                
+                read_bitmap_header( stream, header, palette );
+                
+                const int byte_count = header.biBitCount/8;
+                if( byte_count != 1 && byte_count != 3 && byte_count != 4 )
+                {
+                    throw std::range_error( "read : biBitCount is not 8, 24 or 32" );
+                }
+                
+                allocate( {header.biWidth, header.biHeight} );
+                
+                ScratchVector< uint8_t > line( align_size( this->width*byte_count, 4 ) );
+                
+                for( int y=this->height-1; y>=0; --y )
+                {
+                    const uint8_t* data = &line[0];
+                    T* p_output = View::row( y );
+                    
+                    stream.read( (char*)&line[0], line.size() );
+                    for( int x=0; x<this->width; ++x, data += byte_count )
+                    {
+                        decode_bitmap_pixel( data, byte_count, palette, p_output[x] );
+                    }
+                }
+            }
+            
+            void read( const std::string& filepath )
+            {
+                std::ifstream file;
+                
+                file.open( filepath, std::ios::in | std::ios::binary );
+                read( file );
+                file.close();
+            }
+            
+            inline Image& operator<<(const std::string& filepath)
+            {
+                read( filepath );
+                return *this;
+            }
+        };
+        
+        template <class T, class ColorBuffer>
+        ImageView<T,ColorBuffer>::Move::Move( ImageType&& image )
+        {
+            size   = image.size;
+            stride = image.stride;
+            pixels = image.m_pixels;
+            buffer = image.m_buffer;
+            
+            image.m_buffer = nullptr;
+            image.set_view( nullptr, SizeI( 0, 0 ), 0 );
+        }
+
+        template<> void Image<GRAY, ColorBufferGRAY>::convert( const ImageView<RGB, ColorBufferRGB>& image )
+        {
+            allocate( image.size );
+            for( int y=0; y<height; ++y )
+            {
+                const RGB* p_input = image.row( y );
+                GRAY* p_output = View::row( y );
+                
+                for( int x=0; x<width; ++x )
+                {
+                    p_output[x].L = rgb_to_gray( p_input[x].R, p_input[x].G, p_input[x].B );
+                }
+            }
+        }
+        
+        template<> void Image<RGB, ColorBufferRGB>::convert( const ImageView<GRAY, ColorBufferGRAY>& image )
+        {
+            allocate( image.size );
+            for( int y=0; y<height; ++y )
+            {
+                const GRAY* p_input = image.row( y );
+                RGB* p_output = View::row( y );
+                
+                for( int x=0; x<width; ++x )
+                {
+                    p_output[x] = { p_input[x].L, p_input[x].L, p_input[x].L };
+                }
+            }
+        }
+
+        template<> void Image<GRAY_F, ColorBufferGRAY_F>::convert( const ImageView<GRAY, ColorBufferGRAY>& image )
+        {
+            allocate( image.size );
+            for( int y=0; y<height; ++y )
+            {
+                const GRAY* p_input = image.row( y );
+                GRAY_F* p_output = View::row( y );
+                
+                for( int x=0; x<width; ++x )
+                {
+                    p_output[x].L = p_input[x].L;
+                }
+            }
+        }
+        
+        template<> void Image<GRAY_F, ColorBufferGRAY_F>::convert( const ImageView<RGB, ColorBufferRGB>& image )
+        {
+            allocate( image.size );
+            for( int y=0; y<height; ++y )
+            {
+                const RGB* p_input = image.row( y );
+                GRAY_F* p_output = View::row( y );
+                
+                for( int x=0; x<width; ++x )
+                {
+                    p_output[x].L = rgb_to_gray( p_input[x].R, p_input[x].G, p_input[x].B );
+                }
+            }
+        }
+        
+        // rounded and limited to 0-255.
+        template<> void Image<GRAY, ColorBufferGRAY>::convert( const ImageView<GRAY_F, ColorBufferGRAY_F>& image )
+        {
+            allocate( image.size );
+            for( int y=0; y<height; ++y )
+            {
+                const GRAY_F* p_input = image.row( y );
+                GRAY* p_output = View::row( y );
+                
+                for( int x=0; x<width; ++x )
+                {
+                    p_output[x].L = (uint8_t)ColorBufferGRAY_F( p_input[x].L + 0.5f ).limit_min_max().L;
+                }
+            }
+        }
+        
+        // RGBX. the pixels are opaque.
+        template<> void Image<RGBA, ColorBufferRGBA>::convert( const ImageView<RGB, ColorBufferRGB>& image )
+        {
+            allocate( image.size );
+            for( int y=0; y<height; ++y )
+            {
+                const RGB* p_input = image.row( y );
+                RGBA* p_output = View::row( y );
+                
+                for( int x=0; x<width; ++x )
+                {
+                    p_output[x] = { p_input[x].R, p_input[x].G, p_input[x].B, 255 };
+                }
+            }
+        }
+        
+        // alpha is dropped. unpremultiply() or composite_over() an opaque back first if needed.
+        template<> void Image<RGB, ColorBufferRGB>::convert( const ImageView<RGBA, ColorBufferRGBA>& image )
+        {
+            allocate( image.size );
+            for( int y=0; y<height; ++y )
+            {
+                const RGBA* p_input = image.row( y );
+                RGB* p_output = View::row( y );
+                
+                for( int x=0; x<width; ++x )
+                {
+                    p_output[x] = { p_input[x].R, p_input[x].G, p_input[x].B };
+                }
+            }
+        }
+        
+        template<> void Image<RGB, ColorBufferRGB>::convert( const ImageView<HMB, ColorBufferHMB>& image )
+        {
+            allocate( image.size );
+            for( int y=0; y<height; ++y )
+            {
+                const HMB* p_input = image.row( y );
+                RGB* p_output = View::row( y );
+                
+                for( int x=0; x<width; ++x )
+                {
+                    p_output[x] = hmb_to_rgb( p_input[x] );
+                }
+            }
+        }
+
+        template<> void Image<HMB, ColorBufferHMB>::convert( const ImageView<RGB, ColorBufferRGB>& image )
+        {
+            allocate( image.size );
+            for( int y=0; y<height; ++y )
+            {
+                const RGB* p_input = image.row( y );
+                HMB* p_output = View::row( y );
+                
+                for( int x=0; x<width; ++x )
+                {
+                    p_output[x] = rgb_to_hmb( p_input[x] );
+                }
+            }
+        }
+        
+        /*
+         *  channels of T in separate planes of uint8_t. every plane row starts at a ROW_ALIGNMENT
+         *  boundary, so the kernels run over contiguous 8bit arrays with 16/32bit accumulators
+         *  instead of ColorBuffer lanes. deinterleave() and interleave() at the I/O boundaries.
+         *
+         *  the results are identical to the same operation of Image<T,ColorBuffer>.
+         */
+        template <class T, class ColorBuffer> class PlanarImage
+        {
+            static_assert( T::TYPE_BYTE == 1, "PlanarImage : channels of T must be 8bit" );
+            
+        public:
+            static const int CHANNEL = T::CHANNEL;
+            using Plane     = Image< GRAY, ColorBufferGRAY >;
+            using ImageType = Image< T, ColorBuffer >;
+            using View      = ImageView< T, ColorBuffer >;
+            
+            union
+            {
+                struct
+                {
+                    const int width = 0;
+                    const int height = 0;
+                };
+                const SizeI size;
+            };
+            
+        private:
+            std::array< Plane, CHANNEL > m_planes;
+            
+            inline void set_size( const SizeI& size )
+            {
+                (SizeI&)this->size = size;
+            }
+            
+            // horizontal and vertical sampling positions of resize(). same steps as Image::resize.
+            struct ResizeAxis
+            {
+                ScratchVector< int > index[4];
+                ScratchVector< int > weight[4];
+                ScratchVector< int > weight_sum;
+                
+                void setup( const int source, const int destination, const Interpolation interpo,
+                            const bicubic_table& table )
+                {
+                    const float step = (float)(source - 1) / (destination - 1);
+                    
+                    for( int i=0; i<4; ++i )
+                    {
+                        index[i].resize( destination );
+                        weight[i].resize( destination );
+                    }
+                    weight_sum.resize( destination );
+                    
+                    float pos = 0;
+                    for( int d=0; d<destination; ++d, pos += step )
+                    {
+                        const int ipos = (int)pos;
+                        
+                        if( interpo == Interpolation::nearest )
+                        {
+                            index[0][d] = (int)(pos+0.5f);
+                        }
+                        if( interpo == Interpolation::bilinear )
+                        {
+                            index[0][d] = ipos;
+                            index[1][d] = fast_min( ipos+1, source-1 );
+                            weight[0][d] = (int)((1.0f - (pos - (float)ipos))*1024.0f);
+                            weight[1][d] = 1024 - weight[0][d];
+                        }
+                        if( interpo == Interpolation::bicubic )
+                        {
+                            const int f100 = (int)((pos - (float)ipos) * 100);
+                            
+                            index[0][d] = fast_max( ipos-1, 0 );
+                            index[1][d] = ipos;
+                            index[2][d] = fast_min( ipos+1, source-1 );
+                            index[3][d] = fast_min( ipos+2, source-1 );
+                            weight[0][d] = table[ f100 + 100 ];
+                            weight[1][d] = table[ f100 ];
+                            weight[2][d] = table[ 100 - f100 ];
+                            weight[3][d] = table[ 200 - f100 ];
+                            weight_sum[d] = weight[0][d] + weight[1][d] + weight[2][d] + weight[3][d];
+                        }
+                    }
+                }
+            };
+            
+        public:
+            PlanarImage() noexcept{}
+            PlanarImage( const PlanarImage& value ) noexcept{ *this = value; }
+            PlanarImage( PlanarImage&& value ) noexcept{ *this = std::forward<PlanarImage>(value); }
+            explicit PlanarImage( const View& value ){ deinterleave( value ); }
+            PlanarImage( const SizeI& size, const Initialize initialize = Initialize::zero ){ create( size, initialize ); }
+            
+            void create( const SizeI& size, const Initialize initialize = Initialize::zero )
+            {
+                for( auto& plane : m_planes )
+                {
+                    plane.create( size, initialize );
+                }
+                set_size( size );
+            }
+            void clear()
+            {
+                for( auto& plane : m_planes )
+                {
+                    plane.clear();
+                }
+                set_size( SizeI( 0, 0 ) );
+            }
+            void set_allocator( Allocator* allocator )
+            {
+                for( auto& plane : m_planes )
+                {
+                    plane.set_allocator( allocator );
+                }
+            }
+            
+            inline Plane& plane( const int channel ){ return m_planes[ channel ]; }
+            inline const Plane& plane( const int channel ) const{ return m_planes[ channel ]; }
+            inline uint8_t* row( const int channel, const int y ){ return (uint8_t*)m_planes[ channel ].row( y ); }
+            inline const uint8_t* row( const int channel, const int y ) const{ return (const uint8_t*)m_planes[ channel ].row( y ); }
+            
+            // the planes are shared copy-on-write like Image.
+            PlanarImage& operator=( const PlanarImage& value )
+            {
+                m_planes = value.m_planes;
+                set_size( value.size );
+                return *this;
+            }
+            PlanarImage& operator=( PlanarImage&& value )
+            {
+                if( this != &value )
+                {
+                    for( int c=0; c<CHANNEL; ++c )
+                    {
+                        m_planes[c] = std::move( value.m_planes[c] );
+                    }
+                    set_size( value.size );
+                    value.set_size( SizeI( 0, 0 ) );
+                }
+                return *this;
+            }
+            inline PlanarImage& operator=( const View& image )
+            {
+                deinterleave( image );
+                return *this;
+            }
+            
+            void deinterleave( const View& image )
+            {
+                create( image.size, Initialize::none );
+                const int width = this->width;
+                
+                for( int y=0; y<height; ++y )
+                {
+                    const T* p_input = image.row( y );
+                    
+                    for( int c=0; c<CHANNEL; ++c )
+                    {
+                        uint8_t* p_output = row( c, y );
+                        
+                        for( int x=0; x<width; ++x )
+                        {
+                            p_output[x] = p_input[x][c];
+                        }
+                    }
+                }
+            }
+            
+            void interleave_into( ImageType& output ) const
+            {
+                output.create( size, Initialize::none );
+                const int width = this->width;
+                
+                for( int y=0; y<height; ++y )
+                {
+                    T* p_output = output.row( y );
+                    
+                    for( int c=0; c<CHANNEL; ++c )
+                    {
+                        const uint8_t* p_input = row( c, y );
+                        
+                        for( int x=0; x<width; ++x )
+                        {
+                            p_output[x][c] = p_input[x];
+                        }
+                    }
+                }
+            }
+            
+            typename ImageType::Move interleave() const
+            {
+                ImageType output;
+                
+                interleave_into( output );
+                return std::move( output );
+            }
+            
+            // every plane gets the gray level.
+            PlanarImage& operator=( const ImageView< GRAY, ColorBufferGRAY >& image )
+            {
+                for( auto& plane : m_planes )
+                {
+                    plane.copy( image );
+                }
+                set_size( image.size );
+                return *this;
+            }
+            
+            void convert_into( Image< GRAY, ColorBufferGRAY >& output ) const
+            {
+                static_assert( CHANNEL >= 3, "PlanarImage : GRAY needs R, G and B planes" );
+                
+                output.create( size, Initialize::none );
+                const int width = this->width;
+                
+                for( int y=0; y<height; ++y )
+                {
+                    const uint8_t* R = row( 0, y );
+                    const uint8_t* G = row( 1, y );
+                    const uint8_t* B = row( 2, y );
+                    uint8_t* p_output = (uint8_t*)output.row( y );
+                    
+                    for( int x=0; x<width; ++x )
+                    {
+                        p_output[x] = rgb_to_gray( R[x], G[x], B[x] );
+                    }
+                }
+            }
+            
+            PlanarImage& operator=( const ImageView< HMB, ColorBufferHMB >& image )
+            {
+                static_assert( CHANNEL == 3, "PlanarImage : HMB has R, G and B planes" );
+                
+                create( image.size, Initialize::none );
+                const int width = this->width;
+                
+                for( int y=0; y<height; ++y )
+                {
+                    const HMB* p_input = image.row( y );
+                    uint8_t* R = row( 0, y );
+                    uint8_t* G = row( 1, y );
+                    uint8_t* B = row( 2, y );
+                    
+                    for( int x=0; x<width; ++x )
+                    {
+                        const RGB rgb = hmb_to_rgb( p_input[x] );
+                        
+                        R[x] = rgb.R;
+                        G[x] = rgb.G;
+                        B[x] = rgb.B;
+                    }
+                }
+                return *this;
+            }
+            
+            void convert_into( Image< HMB, ColorBufferHMB >& output ) const
+            {
+                static_assert( CHANNEL == 3, "PlanarImage : HMB has R, G and B planes" );
+                
+                output.create( size, Initialize::none );
+                const int width = this->width;
+                
+                for( int y=0; y<height; ++y )
+                {
+                    const uint8_t* R = row( 0, y );
+                    const uint8_t* G = row( 1, y );
+                    const uint8_t* B = row( 2, y );
+                    HMB* p_output = output.row( y );
+                    
+                    for( int x=0; x<width; ++x )
+                    {
+                        p_output[x] = rgb_to_hmb( { R[x], G[x], B[x] } );
+                    }
+                }
+            }
+            
+            /*
+             *  blurs rows [begin, end) of one plane. the bounds are parameters, so no int32_t store
+             *  may alias them and the loops vectorize.
+             *
+             *  [in]block           columns summed at a time. see vertical_block().
+             *  [in]border_row      width values of Border::constant.
+             *  [in]border_vertical the vertical filter of a column of Border::constant.
+             *  [in]p_sum, p_line   width + radius*2 values. p_rows radius*2 + 1 pointers.
+             */
+            static void gaussian_rows( const Plane& input, uint8_t* output, const ptrdiff_t output_stride,
+                                       const int* kernel, const int radius, const int width, const int height,
+                                       const int begin, const int end, const int block, const Border border,
+                                       const uint8_t* border_row, const uint16_t border_vertical,
+                                       int32_t* p_sum, uint16_t* p_line, const uint8_t** p_rows )
+            {
+                const int side = radius * 2 + 1;
+                
+                for( int y=begin; y<end; ++y )
+                {
+                    for( int i=0; i<side; ++i )
+                    {
+                        const int index = border_index( y+i-radius, height, border );
+                        p_rows[i] = index < 0 ? border_row : (const uint8_t*)input.row( index );
+                    }
+                    
+                    // vertical filter.
+                    uint16_t* p_horizontal = p_line + radius;
+                    uint8_t* p_output = offset_row( output, y*output_stride );
+                    
+                    // the same sums by the flat uint8_t kernels of ImageView::gaussian_into(). they fit int16.
+                    if( simd_level() != SimdLevel::none )
+                    {
+                        gaussian_vertical_u8( p_rows, kernel, side, (int16_t*)p_horizontal, width );
+                        fill_border_columns( p_horizontal, width, radius, 1, border, &border_vertical );
+                        gaussian_horizontal_u8( (const int16_t*)p_line, 1, kernel, side, p_output, width );
+                        continue;
+                    }
+                    
+                    for( int x0=0; x0<width; x0+=block )
+                    {
+                        const int x1 = fast_min( x0 + block, width );
+                        
+                        for( int x=x0; x<x1; ++x )
+                        {
+                            p_sum[x] = 0;
+                        }
+                        for( int i=0; i<side; ++i )
+                        {
+                            const uint8_t* p_input = p_rows[i];
+                            const int16_t k = (int16_t)kernel[i];
+                            
+                            for( int x=x0; x<x1; ++x )
+                            {
+                                p_sum[x] += p_input[x] * k;
+                            }
+                        }
+                        for( int x=x0; x<x1; ++x )
+                        {
+                            p_horizontal[x] = (uint16_t)(p_sum[x] >> 6);
+                        }
+                    }
+                    fill_border_columns( p_horizontal, width, radius, 1, border, &border_vertical );
+                    
+                    // horizontal filter.
+                    for( int x0=0; x0<width; x0+=block )
+                    {
+                        const int x1 = fast_min( x0 + block, width );
+                        
+                        for( int x=x0; x<x1; ++x )
+                        {
+                            p_sum[x] = 0;
+                        }
+                        for( int i=0; i<side; ++i )
+                        {
+                            const uint16_t* p_input = p_line + i;
+                            const int16_t k = (int16_t)kernel[i];
+                            
+                            for( int x=x0; x<x1; ++x )
+                            {
+                                p_sum[x] += p_input[x] * k;
+                            }
+                        }
+                        for( int x=x0; x<x1; ++x )
+                        {
+                            p_output[x] = (uint8_t)(p_sum[x] >> 18);
+                        }
+                    }
+                }
+            }
+            
+            PlanarImage gaussian( const float sigma, const int threads = 1,
+                                  const Border border = Border::mirror, const T border_color = T() ) const
+            {
+                PlanarImage output;
+                
+                gaussian_into( output, sigma, threads, border, border_color );
+                return std::move( output );
+            }
+            
+            /*
+             *  the FIR kernel of ImageView::gaussian_fir_into() at every radius.
+             *
+             *  [in]output  may be this image.
+             *  [in]threads cap of the threads for bands of rows. the result does not depend on it.
+             *  [in]border  pixels read outside of the image. the radius may be larger than the image.
+             */
+            void gaussian_into( PlanarImage& output, const float sigma, const int threads = 1,
+                                const Border border = Border::mirror, const T border_color = T() ) const
+            {
+                if( sigma < 0.0f )
+                {
+                    throw std::range_error( "gaussian : sigma < 0.0f" );
+                }
+                
+                ScratchVector< int > kernel;
+                const int radius = gaussian_kernel( sigma, kernel );
+                
+                if( radius == 0 || width == 0 || height == 0 )
+                {
+                    output = *this;
+                    return;
+                }
+                
+                // uint8_t stores may alias members, so the loop bounds are kept in locals.
+                const int width  = this->width;
+                const int height = this->height;
+                const int side = radius * 2 + 1;
+                const int line = width + radius*2;
+                const int bands = band_count( height, threads );
+                ScratchVector< int32_t > sum( (size_t)line * bands );
+                ScratchVector< uint16_t > horizontal( (size_t)line * bands );
+                ScratchVector< const uint8_t* > rows( (size_t)side * bands );
+                ScratchVector< uint8_t > border_row( border == Border::constant ? width : 0 );
+                const int block = vertical_block();
+                
+                int kernel_sum = 0;
+                for( int i=0; i<side; ++i )
+                {
+                    kernel_sum += kernel[i];
+                }
+                
+                for( int c=0; c<CHANNEL; ++c )
+                {
+                    std::fill( border_row.begin(), border_row.end(), border_color[c] );
+                    const uint16_t border_vertical = (uint16_t)( ( border_color[c] * kernel_sum ) >> 6 );
+                    
+                    // shared with this image, so output allocates new pixels if it is this image.
+                    const Plane input = m_planes[c];
+                    Plane& plane = output.m_planes[c];
+                    
+                    plane.create( size, Initialize::none );
+                    
+                    // rows are written through this pointer. Image::row() would detach in every thread.
+                    uint8_t* const plane_pixels = (uint8_t*)plane.row( 0 );
+                    const ptrdiff_t plane_stride = plane.stride;
+                    
+                    parallel_bands( height, threads, [&]( const int band, const int begin, const int end )
+                    {
+                        gaussian_rows( input, plane_pixels, plane_stride, &kernel[0], radius, width, height, begin, end,
+                                       block, border, border_row.data(), border_vertical,
+                                       &sum[ (size_t)line * band ], &horizontal[ (size_t)line * band ], &rows[ (size_t)side * band ] );
+                    } );
+                }
+                output.set_size( size );
+            }
+            
+            PlanarImage resize( const SizeI& size, const Interpolation interpo = Interpolation::bicubic ) const
+            {
+                if( size.width <= 0 )
+                {
+                    throw std::range_error( "resize : size.width <= 0" );
+                }
+                if( size.height <= 0)
+                {
+                    throw std::range_error( "resize : size.height <= 0" );
+                }
+                
+                PlanarImage output;
+                
+                if( this->size == size )
+                {
+                    output = *this;
+                    return std::move( output );
+                }
+                output.create( size, Initialize::none );
+                
+                if( interpo == Interpolation::super )
+                {
+                    for( int c=0; c<CHANNEL; ++c )
+                    {
+                        resize_super( m_planes[c], output.m_planes[c] );
+                    }
+                    return std::move( output );
+                }
+                
+                const bicubic_table& table = default_bicubic_table;
+                ResizeAxis x_axis;
+                ResizeAxis y_axis;
+                
+                const int output_width = size.width;
+                
+                x_axis.setup( width, size.width, interpo, table );
+                y_axis.setup( height, size.height, interpo, table );
+                
+                // bicubic rows interpolated horizontally, cached by source row.
+                ScratchVector< int > lines[4];
+                int line_y[4] = { -1, -1, -1, -1 };
+                
+                for( auto& line : lines )
+                {
+                    line.resize( size.width );
+                }
+                
+                for( int c=0; c<CHANNEL; ++c )
+                {
+                    line_y[0] = line_y[1] = line_y[2] = line_y[3] = -1;
+                    
+                    for( int y=0; y<size.height; ++y )
+                    {
+                        uint8_t* p_output = output.row( c, y );
+                        
+                        if( interpo == Interpolation::nearest )
+                        {
+                            const uint8_t* p_input = row( c, y_axis.index[0][y] );
+                            const int* ix = &x_axis.index[0][0];
+                            
+                            for( int x=0; x<output_width; ++x )
+                            {
+                                p_output[x] = p_input[ ix[x] ];
+                            }
+                        }
+                        if( interpo == Interpolation::bilinear )
+                        {
+                            const uint8_t* p_input0 = row( c, y_axis.index[0][y] );
+                            const uint8_t* p_input1 = row( c, y_axis.index[1][y] );
+                            const int* ix0 = &x_axis.index[0][0];
+                            const int* ix1 = &x_axis.index[1][0];
+                            const int* fx0 = &x_axis.weight[0][0];
+                            const int* fx1 = &x_axis.weight[1][0];
+                            const int fy0 = y_axis.weight[0][y];
+                            const int fy1 = y_axis.weight[1][y];
+                            
+                            for( int x=0; x<output_width; ++x )
+                            {
+                                const int top    = (p_input0[ ix0[x] ] * fx0[x] + p_input0[ ix1[x] ] * fx1[x]) >> 10;
+                                const int bottom = (p_input1[ ix0[x] ] * fx0[x] + p_input1[ ix1[x] ] * fx1[x]) >> 10;
+                                
+                                p_output[x] = (uint8_t)((top * fy0 + bottom * fy1) >> 10);
+                            }
+                        }
+                        if( interpo == Interpolation::bicubic )
+                        {
+                            const int* p_line[4];
+                            
+                            for( int i=0; i<4; ++i )
+                            {
+                                p_line[i] = bicubic_line( c, y_axis.index[i][y], x_axis, lines, line_y, y_axis, y );
+                            }
+                            
+                            const int ty0 = y_axis.weight[0][y];
+                            const int ty1 = y_axis.weight[1][y];
+                            const int ty2 = y_axis.weight[2][y];
+                            const int ty3 = y_axis.weight[3][y];
+                            const int weight_y = y_axis.weight_sum[y];
+                            
+                            for( int x=0; x<output_width; ++x )
+                            {
+                                const int color =
+                                    (p_line[0][x] * ty0 + p_line[1][x] * ty1 + p_line[2][x] * ty2 + p_line[3][x] * ty3) / weight_y;
+                                
+                                p_output[x] = (uint8_t)limit( color, 0, 255 );
+                            }
+                        }
+                    }
+                }
+                return std::move( output );
+            }
+            
+            inline PlanarImage resize( const float scaling, const Interpolation interpo = Interpolation::bicubic ) const
+            {
+                return resize( {width*scaling+0.5f, height*scaling+0.5f}, interpo );
+            }
+            
+        private:
+            // row sy of plane c interpolated horizontally. kept while the rows of output y still need it.
+            const int* bicubic_line( const int c, const int sy, const ResizeAxis& x_axis,
+                                     ScratchVector< int >* lines, int* line_y, const ResizeAxis& y_axis, const int y ) const
+            {
+                int slot = -1;
+                for( int i=0; i<4; ++i )
+                {
+                    if( line_y[i] == sy )
+                    {
+                        return &lines[i][0];
+                    }
+                }
+                for( int i=0; i<4 && slot < 0; ++i )
+                {
+                    bool used = false;
+                    for( int j=0; j<4; ++j )
+                    {
+                        used |= ( line_y[i] == y_axis.index[j][y] );
+                    }
+                    if( !used )
+                    {
+                        slot = i;
+                    }
+                }
+                
+                const uint8_t* p_input = row( c, sy );
+                int* p_line = &lines[slot][0];
+                const int* ix0 = &x_axis.index[0][0];
+                const int* ix1 = &x_axis.index[1][0];
+                const int* ix2 = &x_axis.index[2][0];
+                const int* ix3 = &x_axis.index[3][0];
+                const int* tx0 = &x_axis.weight[0][0];
+                const int* tx1 = &x_axis.weight[1][0];
+                const int* tx2 = &x_axis.weight[2][0];
+                const int* tx3 = &x_axis.weight[3][0];
+                const int* weight_x = &x_axis.weight_sum[0];
+                
+                for( int x=0; x<(int)lines[slot].size(); ++x )
+                {
+                    p_line[x] = ( p_input[ ix0[x] ] * tx0[x] + p_input[ ix1[x] ] * tx1[x] +
+                                  p_input[ ix2[x] ] * tx2[x] + p_input[ ix3[x] ] * tx3[x] ) / weight_x[x];
+                }
+                line_y[slot] = sy;
+                return p_line;
+            }
+            
+            // area average of Interpolation::super.
+            static void resize_super( const Plane& input, Plane& output )
+            {
+                int y_pos_super =  0;
+                
+                const int x_step_super = (int)((float)input.width  / (output.width)  * 1024);
+                const int y_step_super = (int)((float)input.height / (output.height) * 1024);
+                
+                for( int y=0; y<output.height; ++y, y_pos_super += y_step_super )
+                {
+                    uint8_t* p_output = (uint8_t*)output.row( y );
+                    int x_pos_super = 0;
+                    
+                    for( int x=0; x<output.width; ++x, x_pos_super += x_step_super )
+                    {
+                        int color = 0;
+                        int weight = 0;
+                        int y_rem = 1024 - (y_pos_super - (y_pos_super&0xFFFFFC00));
+                        int y_area = y_step_super;
+                        
+                        for( int yy=(y_pos_super>>10); y_area > 0; ++yy )
+                        {
+                            const uint8_t* p_input = (const uint8_t*)input.row( yy );
+                            int x_rem = 1024 - (x_pos_super - (x_pos_super&0xFFFFFC00));
+                            
+                            if( y_area <= 1024 )
+                            {
+                                y_rem = y_area;
+                            }
+                            y_area -= y_rem;
+                            
+                            int x_area = x_step_super;
+                            
+                            for( int xx=(x_pos_super>>10); x_area > 0; ++xx )
+                            {
+                                if( x_area <= 1024 )
+                                {
+                                    x_rem = x_area;
+                                }
+                                color += p_input[xx] * ((x_rem*y_rem)>>10);
+                                weight += ((x_rem*y_rem) >> 10);
+                                x_area -= x_rem;
+                                x_rem = 1024;
+                            }
+                            y_rem = 1024;
+                        }
+                        p_output[x] = (uint8_t)(color / weight);
+                    }
+                }
+            }
+            
+        public:
+            
+#define PlanarBlendConcept( FORE ) \
+            PlanarImage output( size, Initialize::none ); \
+            \
+            const int width = this->width; \
+            const int ialpha = (int)(alpha * 1024.0f); \
+            \
+            for( int c=0; c<CHANNEL; ++c ) \
+            { \
+                for( int y=0; y<height; ++y ) \
+                { \
+                    const uint8_t* back = row( c, y ); \
+                    uint8_t* p_output = output.row( c, y ); \
+                    \
+                    for( int x=0; x<width; ++x ) \
+                    { \
+                        p_output[x] = gs::alpha_blend( back[x], (uint8_t)(FORE), ialpha ); \
+                    } \
+                } \
+            } \
+            \
+            return std::move(output)
+            
+#define fore_color ((int)fore.row( c, y )[x])
+#define back_color ((int)back[x])
+#define args_color ((int)color[c])
+
+            PlanarImage alpha_blend( const PlanarImage& fore, float alpha ) const
+            {
+                PlanarBlendConcept( fore_color );
+            }
+            
+            PlanarImage alpha_blend( const T color, float alpha ) const
+            {
+                PlanarBlendConcept( args_color );
+            }
+            
+            PlanarImage addition_blend( const PlanarImage& fore, float alpha ) const
+            {
+                PlanarBlendConcept( fast_min( back_color + fore_color, 255 ) );
+            }
+            
+            PlanarImage addition_blend( const T color, float alpha ) const
+            {
+                PlanarBlendConcept( fast_min( back_color + args_color, 255 ) );
+            }
+            
+            PlanarImage subtract_blend( const PlanarImage& fore, float alpha ) const
+            {
+                PlanarBlendConcept( fast_max( back_color - fore_color, 0 ) );
+            }
+            
+            PlanarImage multiply_blend( const PlanarImage& fore, float alpha ) const
+            {
+                PlanarBlendConcept( back_color * fore_color / 255 );
+            }
+            
+            PlanarImage difference_blend( const PlanarImage& fore, float alpha ) const
+            {
+                PlanarBlendConcept( fast_abs( fore_color - back_color ) );
+            }
+            
+            PlanarImage color_burn_blend( const PlanarImage& fore, float alpha ) const
+            {
+                PlanarBlendConcept( fast_max( 255 - (255 - back_color) * 255 / fast_max( fore_color, 1 ), 0 ) );
+            }
+            
+            PlanarImage darken_blend( const PlanarImage& fore, float alpha ) const
+            {
+                PlanarBlendConcept( fast_min( back_color, fore_color ) );
+            }
+            
+            PlanarImage lighten_blend( const PlanarImage& fore, float alpha ) const
+            {
+                PlanarBlendConcept( fast_max( back_color, fore_color ) );
+            }
+            
+            PlanarImage linear_burn_blend( const PlanarImage& fore, float alpha ) const
+            {
+                PlanarBlendConcept( fast_max( back_color + fore_color - 255, 0 ) );
+            }
+            
+            PlanarImage screen_blend( const PlanarImage& fore, float alpha ) const
+            {
+                PlanarBlendConcept( back_color + fore_color - back_color * fore_color / 255 );
+            }
+            
+            PlanarImage color_dodge_blend( const PlanarImage& fore, float alpha ) const
+            {
+                PlanarBlendConcept( fast_min( back_color * 255 / fast_max( 255 - fore_color, 1 ), 255 ) );
+            }
+            
+            PlanarImage exclusion_blend( const PlanarImage& fore, float alpha ) const
+            {
+                PlanarBlendConcept( fast_max( back_color + fore_color - 2 * back_color * fore_color / 255, 0 ) );
+            }
+            
+            PlanarImage overlay_blend( const PlanarImage& fore, float alpha ) const
+            {
+                PlanarBlendConcept( back_color < 128 ?
+                                    back_color*fore_color*2/255 :
+                                    2*(back_color+fore_color-back_color*fore_color/255)-255 );
+            }
+            
+            PlanarImage overlay_blend( const T color, float alpha ) const
+            {
+                PlanarBlendConcept( back_color < 128 ?
+                                    back_color*args_color*2/255 :
+                                    2*(back_color+args_color-back_color*args_color/255)-255 );
+            }
+            
+            PlanarImage soft_light_blend( const PlanarImage& fore, float alpha ) const
+            {
+                PlanarBlendConcept( fore_color < 128 ?
+                                    std::pow( back_color / 255.0f, 2.0f * (1.0f - fore_color / 255.0f) ) * 255.0f :
+                                    std::pow( back_color / 255.0f, 2.0f * (1.0f / (2.0f * fore_color / 255.0f) ) ) * 255.0f );
+            }
+            
+            PlanarImage soft_light_blend( const T color, float alpha ) const
+            {
+                PlanarBlendConcept( args_color < 128 ?
+                                    std::pow( back_color / 255.0f, 2.0f * (1.0f - args_color / 255.0f) ) * 255.0f :
+                                    std::pow( back_color / 255.0f, 2.0f * (1.0f / (2.0f * args_color / 255.0f) ) ) * 255.0f );
+            }
+            
+            PlanarImage hard_light_blend( const PlanarImage& fore, float alpha ) const
+            {
+                PlanarBlendConcept( fore_color < 128 ?
+                                    back_color*fore_color*2/255 :
+                                    2*(back_color+fore_color-back_color*fore_color/255) - 255 );
+            }
+            
+            PlanarImage hard_light_blend( const T color, float alpha ) const
+            {
+                PlanarBlendConcept( args_color < 128 ?
+                                    back_color*args_color*2/255 :
+                                    2*(back_color+args_color-back_color*args_color/255) - 255 );
+            }
+            
+            PlanarImage vivid_light_blend( const PlanarImage& fore, float alpha ) const
+            {
+                PlanarBlendConcept( fore_color < 128 ?
+                                    back_color < 255-2*fore_color ?
+                                        0 :
+                                        (back_color-(255-2*fore_color)) / (2 * fast_max(fore_color,1)) :
+                                    back_color < 2*(255-fore_color) ?
+                                        back_color / 2*(255-fore_color) :
+                                        255
+                                    );
+            }
+            
+            PlanarImage vivid_light_blend( const T color, float alpha ) const
+            {
+                PlanarBlendConcept( args_color < 128 ?
+                                    back_color < 255-2*args_color ?
+                                        0 :
+                                        (back_color-(255-2*args_color)) / (2 * fast_max(args_color,1)) :
+                                    back_color < 2*(255-args_color) ?
+                                        back_color / 2*(255-args_color) :
+                                        255
+                                    );
+            }
+            
+            PlanarImage linear_light_blend( const PlanarImage& fore, float alpha ) const
+            {
+                PlanarBlendConcept( fore_color < 128 ?
+                                    back_color < 255 - 2 * fore_color ?
+                                        0 :
+                                        fast_min( 2 * fore_color + back_color + 255, 255 ) :
+                                    
+                                    back_color < 2 * (255-fore_color) ?
+                                        fast_min( 2 * fore_color + back_color + 255, 255 ) :
+                                        255
+                                    );
+            }
+            
+            PlanarImage linear_light_blend( const T color, float alpha ) const
+            {
+                PlanarBlendConcept( args_color < 128 ?
+                                    back_color < 255 - 2 * args_color ?
+                                        0 :
+                                        fast_min( 2 * args_color + back_color + 255, 255 ) :
+                                    
+                                    back_color < 2 * (255-args_color) ?
+                                        fast_min( 2 * args_color + back_color + 255, 255 ) :
+                                        255
+                                    );
+            }
+            
+            PlanarImage pin_light_blend( const PlanarImage& fore, float alpha ) const
+            {
+                PlanarBlendConcept( fore_color < 128 ?
+                                    back_color < 255 - 2 * fore_color ?
+                                        back_color :
+                                        2 * fore_color :
+                                    
+                                    back_color < 2 * fore_color - 255 ?
+                                        2 * fore_color - 255 :
+                                        back_color
+                                    );
+            }
+            
+            PlanarImage pin_light_blend( const T color, float alpha ) const
+            {
+                PlanarBlendConcept( args_color < 128 ?
+                                    back_color < 255 - 2 * args_color ?
+                                        back_color :
+                                        2 * args_color :
+                                    
+                                    back_color < 2 * args_color - 255 ?
+                                        2 * args_color - 255 :
+                                        back_color
+                                    );
+            }
+            
+#undef PlanarBlendConcept
+#undef fore_color
+#undef back_color
+#undef args_color
+        };
+        
+        enum class TileOrder
+        {
+            row_major,
+            morton, // Z-order. neighbours in both directions are processed close together.
+        };
+        
+        /*
+         *  image stored as TILE_SIZE x TILE_SIZE tiles. every tile is an Image, so no offset exceeds
+         *  one tile and an operation works on one tile and its halo at a time.
+         *  coordinates are int, pixel counts and linear indices are uint64_t.
+         *
+         *  the operations give the same pixels as the same operation on one Image.
+         */
+        template <class T, class ColorBuffer> class TiledImage
+        {
+        public:
+            static const int TILE_SIZE = 256;
+            using ImageType = Image< T, ColorBuffer >;
+            using View      = ImageView< T, ColorBuffer >;
+            using Move      = typename View::Move;
+            
+            union
+            {
+                struct
+                {
+                    const int width = 0;
+                    const int height = 0;
+                };
+                const SizeI size;
+            };
+            const uint64_t length = 0;
+            
+        private:
+            int m_tiles_x = 0;
+            int m_tiles_y = 0;
+            std::vector< ImageType > m_tiles;
+            TileOrder m_order = TileOrder::morton;
+            
+            inline void set_size( const SizeI& size )
+            {
+                (SizeI&)this->size = size;
+                (uint64_t&)length = (uint64_t)size.width*size.height;
+                m_tiles_x = (size.width  + TILE_SIZE - 1) / TILE_SIZE;
+                m_tiles_y = (size.height + TILE_SIZE - 1) / TILE_SIZE;
+            }
+            
+            static inline uint64_t morton_code( const uint32_t x, const uint32_t y )
+            {
+                uint64_t code = 0;
+                for( int bit=0; bit<32; ++bit )
+                {
+                    code |= (uint64_t)((x >> bit) & 1) << (bit*2);
+                    code |= (uint64_t)((y >> bit) & 1) << (bit*2+1);
+                }
+                return code;
+            }
+            
+            // tiles of this image and output must be separate.
+            template <class Function>
+            void process_into( TiledImage& output, const int radius, const Function& func ) const
+            {
+                output.create( size, Initialize::none );
+                
+                ImageType input;
+                ImageType result;
+                
+                for_each_tile( [&]( const int tx, const int ty )
+                {
+                    const RectangleI tile = tile_rectangle( tx, ty );
+                    const int left   = fast_max( tile.x - radius, 0 );
+                    const int top    = fast_max( tile.y - radius, 0 );
+                    const int right  = fast_min( tile.x + tile.width  + radius, width  );
+                    const int bottom = fast_min( tile.y + tile.height + radius, height );
+                    
+                    region_into( input, { left, top, right - left, bottom - top } );
+                    func( input, result );
+                    output.tile( tx, ty ).copy( result.view( { tile.x - left, tile.y - top, tile.width, tile.height } ) );
+                } );
+            }
+            
+        public:
+            TiledImage() noexcept{}
+            TiledImage( const TiledImage& value ){ *this = value; }
+            TiledImage( TiledImage&& value ) noexcept{ *this = std::forward<TiledImage>(value); }
+            explicit TiledImage( const View& value ){ copy( value ); }
+            TiledImage( const SizeI& size, const Initialize initialize = Initialize::zero ){ create( size, initialize ); }
+            
+            void create( const SizeI& size, const Initialize initialize = Initialize::zero )
+            {
+                set_size( size );
+                m_tiles.resize( (size_t)m_tiles_x*m_tiles_y );
+                for( int ty=0; ty<m_tiles_y; ++ty )
+                {
+                    for( int tx=0; tx<m_tiles_x; ++tx )
+                    {
+                        tile( tx, ty ).create( tile_rectangle( tx, ty ).size, initialize );
+                    }
+                }
+            }
+            void clear()
+            {
+                m_tiles.clear();
+                set_size( SizeI( 0, 0 ) );
+            }
+            
+            // tiles share their pixels copy-on-write like Image.
+            TiledImage& operator=( const TiledImage& value )
+            {
+                m_tiles = value.m_tiles;
+                m_order = value.m_order;
+                set_size( value.size );
+                return *this;
+            }
+            TiledImage& operator=( TiledImage&& value )
+            {
+                if( this != &value )
+                {
+                    m_tiles = std::move( value.m_tiles );
+                    m_order = value.m_order;
+                    set_size( value.size );
+                    value.clear();
+                }
+                return *this;
+            }
+            
+            inline TileOrder order() const{ return m_order; }
+            inline void set_order( const TileOrder order ){ m_order = order; }
+            
+            inline int tiles_x() const{ return m_tiles_x; }
+            inline int tiles_y() const{ return m_tiles_y; }
+            inline ImageType& tile( const int tx, const int ty ){ return m_tiles[ (size_t)ty*m_tiles_x + tx ]; }
+            inline const ImageType& tile( const int tx, const int ty ) const{ return m_tiles[ (size_t)ty*m_tiles_x + tx ]; }
+            
+            inline RectangleI tile_rectangle( const int tx, const int ty ) const
+            {
+                const int x = tx*TILE_SIZE;
+                const int y = ty*TILE_SIZE;
+                
+                return { x, y, fast_min( TILE_SIZE, width - x ), fast_min( TILE_SIZE, height - y ) };
+            }
+            
+            // calls func( tx, ty ) for every tile in order().
+            template <class Function>
+            void for_each_tile( const Function& func ) const
+            {
+                if( m_order == TileOrder::row_major )
+                {
+                    for( int ty=0; ty<m_tiles_y; ++ty )
+                    {
+                        for( int tx=0; tx<m_tiles_x; ++tx )
+                        {
+                            func( tx, ty );
+                        }
+                    }
+                    return;
+                }
+                
+                std::vector< std::pair< uint64_t, int > > codes( m_tiles.size() );
+                for( int ty=0; ty<m_tiles_y; ++ty )
+                {
+                    for( int tx=0; tx<m_tiles_x; ++tx )
+                    {
+                        const int index = ty*m_tiles_x + tx;
+                        codes[index] = { morton_code( tx, ty ), index };
+                    }
+                }
+                std::sort( codes.begin(), codes.end() );
+                for( const auto& code : codes )
+                {
+                    func( code.second % m_tiles_x, code.second / m_tiles_x );
+                }
+            }
+            
+            inline T& operator[]( const PointI& point )
+            {
+                return tile( point.x / TILE_SIZE, point.y / TILE_SIZE )[ { point.x % TILE_SIZE, point.y % TILE_SIZE } ];
+            }
+            inline const T& operator[]( const PointI& point ) const
+            {
+                return tile( point.x / TILE_SIZE, point.y / TILE_SIZE )[ { point.x % TILE_SIZE, point.y % TILE_SIZE } ];
+            }
+            // row-major pixel index.
+            inline T& operator[]( const uint64_t index ){ return (*this)[ { (int)(index % width), (int)(index / width) } ]; }
+            inline const T& operator[]( const uint64_t index ) const{ return (*this)[ { (int)(index % width), (int)(index / width) } ]; }
+            
+            void copy( const View& image )
+            {
+                create( image.size, Initialize::none );
+                write_region( { 0, 0 }, image );
+            }
+            inline TiledImage& operator=( const View& image )
+            {
+                copy( image );
+                return *this;
+            }
+            
+            // copies rectangle into output. output keeps its buffer when it is large enough.
+            void region_into( ImageType& output, const RectangleI& rectangle ) const
+            {
+                if( rectangle.x < 0 || rectangle.y < 0 ||
+                    rectangle.x + rectangle.width > width || rectangle.y + rectangle.height > height )
+                {
+                    throw std::range_error( "region : rectangle is out of image" );
+                }
+                output.create( rectangle.size, Initialize::none );
+                
+                for( int ty=rectangle.y / TILE_SIZE; ty*TILE_SIZE < rectangle.y + rectangle.height; ++ty )
+                {
+                    for( int tx=rectangle.x / TILE_SIZE; tx*TILE_SIZE < rectangle.x + rectangle.width; ++tx )
+                    {
+                        const RectangleI tile_rect = tile_rectangle( tx, ty );
+                        const int left   = fast_max( rectangle.x, tile_rect.x );
+                        const int top    = fast_max( rectangle.y, tile_rect.y );
+                        const int right  = fast_min( rectangle.x + rectangle.width,  tile_rect.x + tile_rect.width  );
+                        const int bottom = fast_min( rectangle.y + rectangle.height, tile_rect.y + tile_rect.height );
+                        const ImageType& source = tile( tx, ty );
+                        
+                        for( int y=top; y<bottom; ++y )
+                        {
+                            memcpy( &output.row( y - rectangle.y )[ left - rectangle.x ],
+                                    &source.row( y - tile_rect.y )[ left - tile_rect.x ], sizeof(T)*(right - left) );
+                        }
+                    }
+                }
+            }
+            
+            Move region( const RectangleI& rectangle ) const
+            {
+                ImageType output;
+                
+                region_into( output, rectangle );
+                return std::move( output );
+            }
+            
+            void write_region( const PointI& point, const View& image )
+            {
+                if( point.x < 0 || point.y < 0 || point.x + image.width > width || point.y + image.height > height )
+                {
+                    throw std::range_error( "write_region : image is out of range" );
+                }
+                
+                for( int ty=point.y / TILE_SIZE; ty*TILE_SIZE < point.y + image.height; ++ty )
+                {
+                    for( int tx=point.x / TILE_SIZE; tx*TILE_SIZE < point.x + image.width; ++tx )
+                    {
+                        const RectangleI tile_rect = tile_rectangle( tx, ty );
+                        const int left   = fast_max( point.x, tile_rect.x );
+                        const int top    = fast_max( point.y, tile_rect.y );
+                        const int right  = fast_min( point.x + image.width,  tile_rect.x + tile_rect.width  );
+                        const int bottom = fast_min( point.y + image.height, tile_rect.y + tile_rect.height );
+                        ImageType& destination = tile( tx, ty );
+                        
+                        for( int y=top; y<bottom; ++y )
+                        {
+                            memcpy( &destination.row( y - tile_rect.y )[ left - tile_rect.x ],
+                                    &image.row( y - point.y )[ left - point.x ], sizeof(T)*(right - left) );
+                        }
+                    }
+                }
+            }
+            
+            void fill( const T color )
+            {
+                for( auto& tile : m_tiles )
+                {
+                    tile.fill( color );
+                }
+            }
+            
+            TiledImage gaussian( const float sigma ) const
+            {
+                TiledImage output;
+                
+                gaussian_into( output, sigma );
+                return std::move( output );
+            }
+            
+            /*
+             *  [in]output may be this image.
+             */
+            void gaussian_into( TiledImage& output, const float sigma ) const
+            {
+                if( &output == this )
+                {
+                    TiledImage temp;
+                    
+                    temp.set_order( m_order );
+                    gaussian_into( temp, sigma );
+                    output = std::move( temp );
+                    return;
+                }
+                
+                ScratchVector< int > kernel;
+                const int radius = gaussian_kernel( sigma, kernel );
+                
+                process_into( output, radius, [sigma]( const ImageType& input, ImageType& result )
+                {
+                    // the FIR kernel, so a tile depends only on the pixels within the radius.
+                    input.gaussian_fir_into( result, sigma );
+                } );
+            }
+            
+            TiledImage resize( const SizeI& size, const Interpolation interpo = Interpolation::bicubic ) const
+            {
+                if( size.width <= 0 )
+                {
+                    throw std::range_error( "resize : size.width <= 0" );
+                }
+                if( size.height <= 0)
+                {
+                    throw std::range_error( "resize : size.height <= 0" );
+                }
+                
+                TiledImage output;
+                
+                output.set_order( m_order );
+                if( this->size == size )
+                {
+                    output = *this;
+                    return std::move( output );
+                }
+                output.create( size, Initialize::none );
+                
+                // the same positions as Image::resize.
+                const float x_step = (float)(width  - 1) / (size.width  - 1);
+                const float y_step = (float)(height - 1) / (size.height - 1);
+                const int x_step_super = (int)((float)width  / (size.width)  * 1024);
+                const int y_step_super = (int)((float)height / (size.height) * 1024);
+                
+                ScratchVector< float > x_pos( size.width );
+                ScratchVector< float > y_pos( size.height );
+                float pos = 0;
+                for( int x=0; x<size.width; ++x, pos += x_step )
+                {
+                    x_pos[x] = pos;
+                }
+                pos = 0;
+                for( int y=0; y<size.height; ++y, pos += y_step )
+                {
+                    y_pos[y] = pos;
+                }
+                
+                // source range of destination [begin, end). neighbours of bicubic included.
+                auto source_range = [&]( const ScratchVector< float >& positions, const int step_super,
+                                         const int begin, const int end, const int length ) -> std::pair< int, int >
+                {
+                    if( interpo == Interpolation::super )
+                    {
+                        return { (begin*step_super) >> 10,
+                                 fast_min( ((end-1)*step_super + step_super - 1) >> 10, length-1 ) + 1 };
+                    }
+                    return { fast_max( (int)positions[begin] - 1, 0 ),
+                             fast_min( (int)(positions[end-1] + 0.5f) + 2, length-1 ) + 1 };
+                };
+                
+                ImageType input;
+                
+                output.for_each_tile( [&]( const int tx, const int ty )
+                {
+                    const RectangleI tile = output.tile_rectangle( tx, ty );
+                    const auto xs = source_range( x_pos, x_step_super, tile.x, tile.x + tile.width,  width  );
+                    const auto ys = source_range( y_pos, y_step_super, tile.y, tile.y + tile.height, height );
+                    
+                    region_into( input, { xs.first, ys.first, xs.second - xs.first, ys.second - ys.first } );
+                    
+                    ImageType& destination = output.tile( tx, ty );
+                    
+                    for( int y=0; y<tile.height; ++y )
+                    {
+                        T* p_output = destination.row( y );
+                        const int oy = tile.y + y;
+                        const float local_y = y_pos[oy] - ys.first;
+                        
+                        for( int x=0; x<tile.width; ++x )
+                        {
+                            const int ox = tile.x + x;
+                            const float local_x = x_pos[ox] - xs.first;
+                            
+                            if( interpo == Interpolation::nearest )
+                            {
+                                p_output[x] = input.get_nearest_pixel( local_x, local_y );
+                            }
+                            if( interpo == Interpolation::bilinear )
+                            {
+                                p_output[x] = input.get_bilinear_pixel( local_x, local_y );
+                            }
+                            if( interpo == Interpolation::bicubic )
+                            {
+                                p_output[x] = input.get_bicubic_pixel( local_x, local_y );
+                            }
+                            if( interpo == Interpolation::super )
+                            {
+                                p_output[x] = input.get_super_pixel( ox*x_step_super - (xs.first << 10),
+                                                                     oy*y_step_super - (ys.first << 10),
+                                                                     x_step_super, y_step_super );
+                            }
+                        }
+                    }
+                } );
+                return std::move( output );
+            }
+            
+            inline TiledImage resize( const float scaling, const Interpolation interpo = Interpolation::bicubic ) const
+            {
+                return resize( {width*scaling+0.5f, height*scaling+0.5f}, interpo );
+            }
+            
+#define TiledBlendConcept( NAME ) \
+            TiledImage NAME( const TiledImage& fore, float alpha ) const \
+            { \
+                if( size != fore.size ) \
+                { \
+                    throw std::range_error( #NAME " : size != fore.size" ); \
+                } \
+                TiledImage output( *this ); \
+                \
+                for( size_t i=0; i<m_tiles.size(); ++i ) \
+                { \
+                    output.m_tiles[i] = m_tiles[i].NAME( fore.m_tiles[i], alpha ); \
+                } \
+                return std::move( output ); \
+            }
+            
+#define TiledBlendConceptColor( NAME ) \
+            TiledBlendConcept( NAME ) \
+            TiledImage NAME( const T color, float alpha ) const \
+            { \
+                TiledImage output( *this ); \
+                \
+                for( size_t i=0; i<m_tiles.size(); ++i ) \
+                { \
+                    output.m_tiles[i] = m_tiles[i].NAME( color, alpha ); \
+                } \
+                return std::move( output ); \
+            }
+            
+            TiledBlendConceptColor( alpha_blend )
+            TiledBlendConceptColor( addition_blend )
+            TiledBlendConcept( subtract_blend )
+            TiledBlendConcept( multiply_blend )
+            TiledBlendConcept( difference_blend )
+            TiledBlendConcept( darken_blend )
+            TiledBlendConcept( lighten_blend )
+            TiledBlendConcept( linear_burn_blend )
+            TiledBlendConcept( screen_blend )
+            TiledBlendConceptColor( overlay_blend )
+            TiledBlendConceptColor( soft_light_blend )
+            TiledBlendConceptColor( hard_light_blend )
+            TiledBlendConceptColor( vivid_light_blend )
+            TiledBlendConceptColor( linear_light_blend )
+            TiledBlendConceptColor( pin_light_blend )
+            
+#undef TiledBlendConceptColor
+#undef TiledBlendConcept
+            
+            // streams rows of a BMP into the tiles.
+            void read( std::istream& stream )
+            {
+                BitmapHeader header;
+                uint8_t palette[256][3];
+                
+                read_bitmap_header( stream, header, palette );
+                
+                const int byte_count = header.biBitCount/8;
+                if( byte_count != 1 && byte_count != 3 && byte_count != 4 )
+                {
+                    throw std::range_error( "read : biBitCount is not 8, 24 or 32" );
+                }
+                
+                create( { header.biWidth, header.biHeight }, Initialize::none );
+                
+                ScratchVector< uint8_t > line( align_size( (size_t)width*byte_count, 4 ) );
+                
+                for( int y=height-1; y>=0; --y )
+                {
+                    const uint8_t* data = &line[0];
+                    
+                    stream.read( (char*)&line[0], line.size() );
+                    for( int tx=0; tx<m_tiles_x; ++tx )
+                    {
+                        T* p_output = tile( tx, y / TILE_SIZE ).row( y % TILE_SIZE );
+                        const int tile_width = tile_rectangle( tx, 0 ).width;
+                        
+                        for( int x=0; x<tile_width; ++x, data += byte_count )
+                        {
+                            decode_bitmap_pixel( data, byte_count, palette, p_output[x] );
+                        }
+                    }
+                }
+            }
+            
+            void write( std::ostream& output ) const
+            {
+                output.clear();
+                
+                BitmapHeader header;
+                ScratchVector< uint8_t > line( align_size( (size_t)width*sizeof(T), 4 ) );
+                
+                header.biWidth     = width;
+                header.biHeight    = height;
+                header.biBitCount  = sizeof(T)*8;
+                header.biSizeImage = (uint32_t)(line.size()*height);
+                header.bfOffBits   = sizeof(BitmapHeader);
+                if( header.biBitCount == 8 )
+                {
+                    header.bfOffBits += 4 * 256; //ColorTable
+                }
+                header.bfSize = header.bfOffBits + header.biSizeImage;
+                
+                output.write( (char*)&header, sizeof(BitmapHeader) );
+                
+                if( header.biBitCount == 8 ) // ColorTable
+                {
+                    uint8_t table[4] = { 0, 0, 0, 255 };
+                    for( int i=0; i<256; ++i )
+                    {
+                        table[0] = table[1] = table[2] = i;
+                        output.write( (char*)table, 4 );
+                    }
+                }
+                
+                for( int y=height-1; y>=0; --y )
+                {
+                    uint8_t* data = &line[0];
+                    
+                    for( int tx=0; tx<m_tiles_x; ++tx )
+                    {
+                        const T* p_input = tile( tx, y / TILE_SIZE ).row( y % TILE_SIZE );
+                        const int tile_width = tile_rectangle( tx, 0 ).width;
+                        
+                        for( int x=0; x<tile_width; ++x, data += sizeof(T) )
+                        {
+                            encode_bitmap_pixel( p_input[x], data );
+                        }
+                    }
+                    output.write( (const char*)&line[0], line.size() );
+                }
+            }
+        };
+    }
+    using ImageGRAY   = core::Image< GRAY  , ColorBufferGRAY   >;
+    using ImageGRAY_F = core::Image< GRAY_F, ColorBufferGRAY_F >;
+    using ImageRGB    = core::Image<  RGB  , ColorBufferRGB    >;
+    using ImageARGB   = core::Image< RGBA  , ColorBufferRGBA   >;
+    using ImageHMB    = core::Image<  HMB  , ColorBufferHMB    >;
+    
+    using ImageViewGRAY   = ImageGRAY::View;
+    using ImageViewGRAY_F = ImageGRAY_F::View;
+    using ImageViewRGB    = ImageRGB::View;
+    using ImageViewARGB   = ImageARGB::View;
+    using ImageViewHMB    = ImageHMB::View;
+    
+    using ImagePlanarRGB  = core::PlanarImage< RGB , ColorBufferRGB  >;
+    using ImagePlanarRGBA = core::PlanarImage< RGBA, ColorBufferRGBA >;
+    
+    using ImageTiledRGB   = core::TiledImage< RGB , ColorBufferRGB  >;
+    using ImageTiledRGBA  = core::TiledImage< RGBA, ColorBufferRGBA >;
+    
+    static inline ImageRGB::Move gaussian_keep_edge_hmb( const ImageViewRGB& image,
+            const float sigma, const float hue, const float magnitude, const float base_luminance, const int threads = 1,
+            const Border border = Border::mirror, const RGB border_color = RGB() )
+    {
+        if( sigma < 0.0f )
+        {
+            throw std::range_error( "gaussian : sigma < 0.0f" );
+        }
+        
+        std::vector< int > kernel;
+        const int radius = core::gaussian_kernel( sigma, kernel );
+        
+        ImageRGB output;
+
+        if( radius != 0 && image.length != 0 )
+        {
+            output.create( image.size, core::Initialize::none );
+            
+            // M and B are integers, so only the hue is rounded by the quantization.
+            const int hue_q       = (int)std::floor( hue * HMB_Q::HUE_SCALE );
+            const int magnitude_q = (int)std::floor( magnitude );
+            const int base_q      = (int)std::floor( base_luminance );
+            
+            const int hmb_width = image.width;
+            core::ScratchVector< HMB_Q > hmb( (size_t)image.width*image.height );
+            core::parallel_bands( image.height, threads, [&]( const int, const int begin, const int end )
+            {
+                for( int y=begin; y<end; ++y )
+                {
+                    const RGB* p_input = image.row( y );
+                    HMB_Q* p_hmb = &hmb[ (size_t)y*hmb_width ];
+                    
+                    for( int x=0; x<hmb_width; ++x )
+                    {
+                        p_hmb[x] = core::rgb_to_hmb_q( p_input[x] );
+                    }
+                }
+            } );
+            
+            // rows of Border::constant point to these rows.
+            const HMB_Q border_hmb = core::rgb_to_hmb_q( border_color );
+            const bool constant = border == Border::constant;
+            const core::ScratchVector< RGB > border_rgb_row( constant ? hmb_width : 0, border_color );
+            const core::ScratchVector< HMB_Q > border_hmb_row( constant ? hmb_width : 0, border_hmb );
+            
+            // one line of each per band.
+            const int side = (int)kernel.size();
+            const int bands = core::band_count( output.height, threads );
+            const int hmb_line = hmb_width + radius*2;
+            core::ScratchVector< RGB > horizontal_rgb( (size_t)bands * hmb_line );
+            core::ScratchVector< HMB_Q > horizontal_hmb( (size_t)bands * hmb_line );
+            core::ScratchVector< ColorBufferRGB > vertical_color( (size_t)bands * hmb_width );
+            core::ScratchVector< int > vertical_weight( (size_t)bands * hmb_width );
+            core::ScratchVector< const RGB* > rgb_rows( (size_t)bands * side );
+            core::ScratchVector< const HMB_Q* > hmb_rows( (size_t)bands * side );
+            const int block = core::vertical_block();
+            
+            // rows are written through this pointer. Image::row() would detach in every thread.
+            RGB* const output_pixels = output.row( 0 );
+            const ptrdiff_t output_stride = output.stride;
+            
+            core::parallel_bands( output.height, threads, [&]( const int band, const int begin, const int end )
+            {
+                // locals. the stores below may alias values captured by reference.
+                const int hue_tolerance       = hue_q;
+                const int magnitude_tolerance = magnitude_q;
+                const int base_tolerance      = base_q;
+                const int width = hmb_width;
+                const int line  = hmb_line;
+                const int block_columns = block;
+                
+                RGB* p_horizontal_rgb = &horizontal_rgb[ (size_t)band*line ];
+                HMB_Q* p_horizontal_hmb = &horizontal_hmb[ (size_t)band*line ];
+                ColorBufferRGB* p_vertical_color = &vertical_color[ (size_t)band*width ];
+                int* p_vertical_weight = &vertical_weight[ (size_t)band*width ];
+                const RGB** p_rgb_rows = &rgb_rows[ (size_t)band*side ];
+                const HMB_Q** p_hmb_rows = &hmb_rows[ (size_t)band*side ];
+                
+                for( int y=begin; y<end; ++y )
+                {
+                    const HMB_Q* p_center_hmb = &hmb[ (size_t)y*width ];
+                    RGB* p_output = core::offset_row( output_pixels, y*output_stride );
+                    
+                    for( int i=0; i<side; ++i )
+                    {
+                        const int index = core::border_index( y+i-radius, image.height, border );
+                        p_rgb_rows[i] = index < 0 ? &border_rgb_row[0] : image.row( index );
+                        p_hmb_rows[i] = index < 0 ? &border_hmb_row[0] : &hmb[ (size_t)index*width ];
+                    }
+                    
+                    // vertical filter. accumulated row by row in blocks of columns to read the rows sequentially.
+                    for( int x0=0; x0<width; x0+=block_columns )
+                    {
+                        const int x1 = core::fast_min( x0 + block_columns, width );
+                        
+                        std::fill( p_vertical_color + x0, p_vertical_color + x1, ColorBufferRGB() );
+                        std::fill( p_vertical_weight + x0, p_vertical_weight + x1, 0 );
+                        
+                        for( int i=0; i<side; ++i )
+                        {
+                            const RGB* p_input = p_rgb_rows[i];
+                            const HMB_Q* p_hmb = p_hmb_rows[i];
+                            const int weight = kernel[i];
+                            
+                            for( int x=x0; x<x1; ++x )
+                            {
+                                if( core::fast_abs( p_center_hmb[x].H - p_hmb[x].H ) <= hue_tolerance &&
+                                    core::fast_abs( p_center_hmb[x].M - p_hmb[x].M ) <= magnitude_tolerance &&
+                                    core::fast_abs( p_center_hmb[x].B - p_hmb[x].B ) <= base_tolerance )
+                                {
+                                    p_vertical_color[x] += ColorBufferRGB( p_input[x] ) * weight;
+                                    p_vertical_weight[x] += weight;
+                                }
+                            }
+                        }
+                        for( int x=x0; x<x1; ++x )
+                        {
+                            p_horizontal_rgb[ x+radius ] = p_vertical_color[x] / p_vertical_weight[x];
+                        }
+                    }
+                    
+                    for( int x=0; x<width; ++x )
+                    {
+                        p_horizontal_hmb[ x+radius ] = core::rgb_to_hmb_q( p_horizontal_rgb[ x+radius ] );
+                    }
+                    
+                    // a column of the border color stays the border color.
+                    core::fill_border_columns( p_horizontal_rgb + radius, width, radius, 1, border, &border_color );
+                    core::fill_border_columns( p_horizontal_hmb + radius, width, radius, 1, border, &border_hmb );
+                    
+                    // horizontal filter.
+                    for( int x=0; x<width; ++x, ++p_output )
+                    {
+                        const HMB_Q center_color_hmb = p_horizontal_hmb[ x+radius ];
+                        
+                        ColorBufferRGB color;
+                        int much_weight = 0;
+                        for( int i=0; i<side; ++i )
+                        {
+                            if( core::fast_abs( center_color_hmb.H - p_horizontal_hmb[x+i].H ) <= hue_tolerance &&
+                                core::fast_abs( center_color_hmb.M - p_horizontal_hmb[x+i].M ) <= magnitude_tolerance &&
+                                core::fast_abs( center_color_hmb.B - p_horizontal_hmb[x+i].B ) <= base_tolerance )
+                            {
+                                color += gs::ColorBufferRGB(p_horizontal_rgb[i+x]) * kernel[ i ];
+                                much_weight += kernel[i];
+                            }
+                        }
+                        *p_output = color / much_weight;
+                    }
+                }
+            } );
+        }
+        else
+        {
+            output = image;
+        }
+        
+        return std::move( output );
+    }
+    
+    static inline ImageRGB::Move gaussian_keep_edge_rgb( const ImageViewRGB& image,
+                                                    const float sigma, const uint8_t r, const uint8_t g, const uint8_t b,
+                                                    const int threads = 1,
+                                                    const Border border = Border::mirror, const RGB border_color = RGB() )
+    {
+        if( sigma < 0.0f )
+        {
+            throw std::range_error( "gaussian : sigma < 0.0f" );
+        }
+        
+        std::vector< int > kernel;
+        const int radius = core::gaussian_kernel( sigma, kernel );
+        
+        ImageRGB output;
+        
+        if( radius != 0 && image.length != 0 )
+        {
+            output.create( image.size, core::Initialize::none );
+            
+            // rows of Border::constant point to this row.
+            const core::ScratchVector< RGB > border_row( border == Border::constant ? image.width : 0, border_color );
+            
+            // lines and rows per band.
+            const int side = (int)kernel.size();
+            const int bands = core::band_count( output.height, threads );
+            const int output_line = image.width + radius*2;
+            core::ScratchVector< RGB > horizontal_rgb( (size_t)bands * output_line );
+            core::ScratchVector< ColorBufferRGB > vertical_color( (size_t)bands * image.width );
+            core::ScratchVector< int > vertical_weight( (size_t)bands * image.width );
+            core::ScratchVector< const RGB* > rows( (size_t)bands * side );
+            const int block = core::vertical_block();
+            
+            // rows are written through this pointer. Image::row() would detach in every thread.
+            RGB* const output_pixels = output.row( 0 );
+            const ptrdiff_t output_stride = output.stride;
+            const int output_width = output.width;
+            
+            core::parallel_bands( output.height, threads, [&]( const int band, const int begin, const int end )
+            {
+                // locals. the stores below may alias values captured by reference.
+                const int tolerance_r = r;
+                const int tolerance_g = g;
+                const int tolerance_b = b;
+                const int line  = output_line;
+                const int width = output_width;
+                const int block_columns = block;
+                
+                RGB* p_horizontal_rgb = &horizontal_rgb[ (size_t)band*line ];
+                ColorBufferRGB* p_vertical_color = &vertical_color[ (size_t)band*width ];
+                int* p_vertical_weight = &vertical_weight[ (size_t)band*width ];
+                const RGB** p_rows = &rows[ (size_t)band*side ];
+                
+                for( int y=begin; y<end; ++y )
+                {
+                    const RGB* p_center = image.row( y );
+                    RGB* p_output = core::offset_row( output_pixels, y*output_stride );
+                    
+                    for( int i=0; i<side; ++i )
+                    {
+                        const int index = core::border_index( y+i-radius, image.height, border );
+                        p_rows[i] = index < 0 ? &border_row[0] : image.row( index );
+                    }
+                    
+                    // vertical filter. accumulated row by row in blocks of columns to read the rows sequentially.
+                    for( int x0=0; x0<width; x0+=block_columns )
+                    {
+                        const int x1 = core::fast_min( x0 + block_columns, width );
+                        
+                        std::fill( p_vertical_color + x0, p_vertical_color + x1, ColorBufferRGB() );
+                        std::fill( p_vertical_weight + x0, p_vertical_weight + x1, 0 );
+                        
+                        for( int i=0; i<side; ++i )
+                        {
+                            const RGB* p_input = p_rows[i];
+                            const int weight = kernel[i];
+                            
+                            for( int x=x0; x<x1; ++x )
+                            {
+                                if( core::fast_abs( p_center[x].R - p_input[x].R ) <= tolerance_r &&
+                                    core::fast_abs( p_center[x].G - p_input[x].G ) <= tolerance_g &&
+                                    core::fast_abs( p_center[x].B - p_input[x].B ) <= tolerance_b )
+                                {
+                                    p_vertical_color[x] += ColorBufferRGB( p_input[x] ) * weight;
+                                    p_vertical_weight[x] += weight;
+                                }
+                            }
+                        }
+                        for( int x=x0; x<x1; ++x )
+                        {
+                            p_horizontal_rgb[ x+radius ] = p_vertical_color[x] / p_vertical_weight[x];
+                        }
+                    }
+                    
+                    // a column of the border color stays the border color.
+                    core::fill_border_columns( p_horizontal_rgb + radius, width, radius, 1, border, &border_color );
+                    
+                    // horizontal filter.
+                    for( int x=0; x<width; ++x, ++p_output )
+                    {
+                        RGB center_color_rgb = p_horizontal_rgb[ x+radius ];
+                        
+                        ColorBufferRGB color;
+                        int much_weight = 0;
+                        for( int i=0; i<side; ++i )
+                        {
+                            if( core::fast_abs(center_color_rgb.R - p_horizontal_rgb[x+i].R) <= tolerance_r &&
+                                core::fast_abs(center_color_rgb.G - p_horizontal_rgb[x+i].G) <= tolerance_g &&
+                                core::fast_abs(center_color_rgb.B - p_horizontal_rgb[x+i].B) <= tolerance_b )
+                            {
+                                color += gs::ColorBufferRGB(p_horizontal_rgb[i+x]) * kernel[ i ];
+                                much_weight += kernel[i];
+                            }
+                        }
+                        *p_output = color / much_weight;
+                    }
+                }
+            } );
+        }
+        else
+        {
+            output = image;
+        }
+        
+        return std::move( output );
+    }
+    
+    namespace core
+    {
+        /*
+         *  permutohedral lattice of Adams, Baek and Davis. a value is splatted onto the D+1 vertices of
+         *  the simplex around its position, the vertices are blurred along the D+1 lattice directions,
+         *  and the value is sliced back from the same vertices. the vertices are kept in a hash table,
+         *  so only the occupied part of the D dimensional space costs memory and time. positions are in
+         *  deviations of the gaussian, so the cost does not grow with the deviation.
+         */
+        template <int D, int V>
+        class PermutohedralLattice
+        {
+        private:
+            // the key is kept in the slot, so a lookup reads one place of memory.
+            struct Slot
+            {
+                int key[ D ];
+                int vertex; // -1 is empty.
+            };
+            
+            std::vector< Slot >  m_table;  // hash table of the vertices.
+            std::vector< Slot >  m_recent; // direct mapped cache of the table. neighbouring positions share vertices.
+            std::vector< int >   m_keys;   // D coordinates per vertex. the last one is minus their sum.
+            std::vector< float > m_values; // V per vertex.
+            int m_vertices;
+            float m_scale[ D ];            // of the positions onto the lattice.
+            
+            // the low bits of a product only depend on the low bits of the keys, so the high bits are mixed in.
+            static inline size_t hash( const int* key )
+            {
+                uint64_t value = 0;
+                for( int i=0; i<D; ++i )
+                {
+                    value = ( value + (uint32_t)key[i] ) * 2531011;
+                }
+                value ^= value >> 33;
+                value *= 0xff51afd7ed558ccdULL;
+                return (size_t)( value ^ ( value >> 33 ) );
+            }
+            
+            // [return] slot of the key, or the empty slot it would take.
+            const Slot& slot( const int* key ) const
+            {
+                const size_t mask = m_table.size() - 1;
+                for( size_t index = hash( key ) & mask; ; index = ( index + 1 ) & mask )
+                {
+                    const Slot& slot = m_table[ index ];
+                    if( slot.vertex < 0 || std::equal( key, key + D, slot.key ) )
+                    {
+                        return slot;
+                    }
+                }
+            }
+            
+            void grow()
+            {
+                std::vector< Slot > table( m_table.size() * 2 );
+                for( auto& empty : table )
+                {
+                    empty.vertex = -1;
+                }
+                table.swap( m_table );
+                
+                for( const auto& filled : table )
+                {
+                    if( filled.vertex >= 0 )
+                    {
+                        const_cast< Slot& >( slot( filled.key ) ) = filled;
+                    }
+                }
+            }
+            
+        public:
+            PermutohedralLattice() : m_table( 1 << 12 ), m_recent( 1 << 13 ), m_vertices( 0 )
+            {
+                for( auto& empty : m_table )
+                {
+                    empty.vertex = -1;
+                }
+                for( auto& empty : m_recent )
+                {
+                    empty.vertex = -1;
+                }
+                for( int i=0; i<D; ++i )
+                {
+                    m_scale[i] = (float)( ( D+1 ) * sqrt( 2.0 / 3.0 ) / sqrt( ( i+1.0 ) * ( i+2.0 ) ) );
+                }
+            }
+            
+            inline int vertices() const
+            {
+                return m_vertices;
+            }
+            
+            // [return] vertex of the key. added with zero values when it is not in the lattice.
+            int vertex( const int* key )
+            {
+                Slot& recent = m_recent[ hash( key ) & ( m_recent.size() - 1 ) ];
+                if( recent.vertex >= 0 && std::equal( key, key + D, recent.key ) )
+                {
+                    return recent.vertex;
+                }
+                
+                if( ( m_vertices + 1 ) * 2 > (int)m_table.size() )
+                {
+                    grow();
+                }
+                Slot& found = const_cast< Slot& >( slot( key ) );
+                if( found.vertex < 0 )
+                {
+                    std::copy( key, key + D, found.key );
+                    found.vertex = m_vertices++;
+                    m_keys.insert( m_keys.end(), key, key + D );
+                    m_values.resize( m_values.size() + V, 0.0f );
+                }
+                recent = found;
+                return found.vertex;
+            }
+            
+            /*
+             *  adds value to the D+1 vertices around a position.
+             *
+             *  [in]position D coordinates in deviations of the gaussian.
+             *  [in]value    V values. the last one is usually 1, to normalize the sliced values by.
+             *  [out]vertices D+1 vertices for slice().
+             *  [out]weights  D+1 barycentric weights for slice().
+             */
+            void splat( const float* position, const float* value, int* vertices, float* weights )
+            {
+                // the position on the hyperplane of the lattice, whose D+1 coordinates sum to 0.
+                float elevated[ D+1 ];
+                float sum = 0.0f;
+                for( int i=D; i>0; --i )
+                {
+                    const float scaled = position[i-1] * m_scale[i-1];
+                    elevated[i] = sum - i * scaled;
+                    sum += scaled;
+                }
+                elevated[0] = sum;
+                
+                // the nearest vertex of remainder 0, and the order of the differences from it.
+                int greedy[ D+1 ];
+                int rank[ D+1 ] = {};
+                int remainder_sum = 0;
+                for( int i=0; i<=D; ++i )
+                {
+                    // floor without the library call of std::floor.
+                    const float v = elevated[i] * ( 1.0f / ( D+1 ) );
+                    int down = (int)v;
+                    down -= (float)down > v;
+                    down *= D+1;
+                    greedy[i] = elevated[i] - down > ( D+1 ) * 0.5f ? down + ( D+1 ) : down;
+                    remainder_sum += greedy[i];
+                }
+                remainder_sum /= D+1;
+                
+                // without branches. the comparisons are as random as the noise of the image.
+                float delta[ D+1 ];
+                for( int i=0; i<=D; ++i )
+                {
+                    delta[i] = elevated[i] - greedy[i];
+                }
+                for( int i=0; i<D; ++i )
+                {
+                    for( int j=i+1; j<=D; ++j )
+                    {
+                        const int less = delta[i] < delta[j];
+                        rank[i] += less;
+                        rank[j] += 1 - less;
+                    }
+                }
+                
+                // moves the vertex back onto the hyperplane.
+                for( int i=0; i<=D; ++i )
+                {
+                    if( remainder_sum > 0 && rank[i] >= D+1 - remainder_sum )
+                    {
+                        greedy[i] -= D+1;
+                        rank[i] += remainder_sum - ( D+1 );
+                    }
+                    else if( remainder_sum < 0 && rank[i] < -remainder_sum )
+                    {
+                        greedy[i] += D+1;
+                        rank[i] += remainder_sum + ( D+1 );
+                    }
+                    else
+                    {
+                        rank[i] += remainder_sum;
+                    }
+                }
+                
+                float barycentric[ D+2 ] = {};
+                for( int i=0; i<=D; ++i )
+                {
+                    const float weight = ( elevated[i] - greedy[i] ) * ( 1.0f / ( D+1 ) );
+                    barycentric[ D - rank[i] ] += weight;
+                    barycentric[ D+1 - rank[i] ] -= weight;
+                }
+                barycentric[0] += 1.0f + barycentric[ D+1 ];
+                
+                for( int remainder=0; remainder<=D; ++remainder )
+                {
+                    // the vertex of the canonical simplex of the remainder, moved to the position.
+                    int key[ D ];
+                    for( int i=0; i<D; ++i )
+                    {
+                        key[i] = greedy[i] + ( rank[i] > D - remainder ? remainder - ( D+1 ) : remainder );
+                    }
+                    
+                    const int found = vertex( key );
+                    float* p_value = &m_values[ (size_t)found*V ];
+                    for( int v=0; v<V; ++v )
+                    {
+                        p_value[v] += barycentric[ remainder ] * value[v];
+                    }
+                    vertices[ remainder ] = found;
+                    weights[ remainder ] = barycentric[ remainder ];
+                }
+            }
+            
+            /*
+             *  adds the vertices and values of a lattice of other positions.
+             *
+             *  [out]remap vertex of this lattice for every vertex of lattice.
+             */
+            void merge( const PermutohedralLattice& lattice, std::vector< int >& remap )
             {
-                BlendConceptChannel( args_color < 128 ?
-                                    back_color < 255 - 2 * args_color ?
-                                    back_color :
-                                    2 * args_color :
-                                    
-                                    back_color < 2 * args_color - 255 ?
-                                    2 * args_color - 255 :
-                                    back_color
-                                    );
+                remap.resize( lattice.m_vertices );
+                for( int i=0; i<lattice.m_vertices; ++i )
+                {
+                    remap[i] = vertex( &lattice.m_keys[ (size_t)i*D ] );
+                    
+                    const float* p_input = &lattice.m_values[ (size_t)i*V ];
+                    float* p_value = &m_values[ (size_t)remap[i]*V ];
+                    for( int v=0; v<V; ++v )
+                    {
+                        p_value[v] += p_input[v];
+                    }
+                }
+            }
+            
+            // blurs the vertices by [1 2 1]/4 along each of the D+1 directions.
+            void blur( const int threads )
+            {
+                std::vector< float > blurred( m_values.size() );
+                const std::vector< float > zero( V, 0.0f );
+                
+                for( int direction=0; direction<=D; ++direction )
+                {
+                    parallel_bands( m_vertices, threads, [&]( const int, const int begin, const int end )
+                    {
+                        for( int i=begin; i<end; ++i )
+                        {
+                            const int* key = &m_keys[ (size_t)i*D ];
+                            int minus[ D ], plus[ D ];
+                            for( int k=0; k<D; ++k )
+                            {
+                                minus[k] = key[k] + ( k == direction ? -D : 1 );
+                                plus[k]  = key[k] + ( k == direction ?  D : -1 );
+                            }
+                            const int minus_vertex = slot( minus ).vertex;
+                            const int plus_vertex  = slot( plus ).vertex;
+                            const float* p_minus = minus_vertex < 0 ? &zero[0] : &m_values[ (size_t)minus_vertex*V ];
+                            const float* p_plus  = plus_vertex  < 0 ? &zero[0] : &m_values[ (size_t)plus_vertex*V ];
+                            const float* p_value = &m_values[ (size_t)i*V ];
+                            float* p_blurred = &blurred[ (size_t)i*V ];
+                            
+                            for( int v=0; v<V; ++v )
+                            {
+                                p_blurred[v] = ( p_minus[v] + p_plus[v] ) * 0.25f + p_value[v] * 0.5f;
+                            }
+                        }
+                    } );
+                    m_values.swap( blurred );
+                }
+            }
+            
+            // [out]value V values at a position, from the vertices and weights of splat().
+            void slice( const int* vertices, const float* weights, float* value ) const
+            {
+                std::fill( value, value + V, 0.0f );
+                for( int remainder=0; remainder<=D; ++remainder )
+                {
+                    const float* p_value = &m_values[ (size_t)vertices[ remainder ]*V ];
+                    for( int v=0; v<V; ++v )
+                    {
+                        value[v] += weights[ remainder ] * p_value[v];
+                    }
+                }
+            }
+        };
+        
+        /*
+         *  gaussian of the edge keeping filters over the position and 3 color coordinates.
+         *  every band splats into a lattice of its own, and the lattices are merged into the first one.
+         *
+         *  [in]deviation spatial deviation in pixels.
+         *  [in]color     color( rgb, coordinates ) stores the 3 color coordinates of a pixel in deviations.
+         */
+        template <class Color>
+        static inline void keep_edge_lattice( const ImageViewRGB& image, const double deviation, const int threads,
+                                              const Color& color, ImageRGB& output )
+        {
+            using Lattice = PermutohedralLattice< 5, 4 >;
+            const int width = image.width;
+            const size_t length = (size_t)image.width * image.height;
+            const int bands = band_count( image.height, threads );
+            
+            std::vector< Lattice > lattices( bands );
+            ScratchBuffer< int > vertices( length * 6 );
+            ScratchBuffer< float > weights( length * 6 );
+            
+            parallel_bands( image.height, threads, [&]( const int band, const int begin, const int end )
+            {
+                const float scale = (float)( 1.0 / deviation );
+                Lattice& lattice = lattices[ band ];
+                
+                for( int y=begin; y<end; ++y )
+                {
+                    const RGB* p_input = image.row( y );
+                    for( int x=0; x<width; ++x )
+                    {
+                        const size_t index = (size_t)y*width + x;
+                        const float value[4] = { (float)p_input[x].R, (float)p_input[x].G, (float)p_input[x].B, 1.0f };
+                        float position[5] = { x * scale, y * scale };
+                        
+                        color( p_input[x], position + 2 );
+                        lattice.splat( position, value, &vertices[ index*6 ], &weights[ index*6 ] );
+                    }
+                }
+            } );
+            
+            // the vertices of the other bands are renumbered into the first lattice.
+            std::vector< std::vector< int > > remaps( bands );
+            for( int band=1; band<bands; ++band )
+            {
+                lattices[0].merge( lattices[ band ], remaps[ band ] );
+                lattices[ band ] = Lattice();
+            }
+            Lattice& lattice = lattices[0];
+            lattice.blur( threads );
+            
+            output.create( image.size, Initialize::none );
+            RGB* const output_pixels = output.row( 0 );
+            const ptrdiff_t output_stride = output.stride;
+            
+            parallel_bands( image.height, threads, [&]( const int band, const int begin, const int end )
+            {
+                const std::vector< int >& remap = remaps[ band ];
+                for( int y=begin; y<end; ++y )
+                {
+                    RGB* p_output = offset_row( output_pixels, y*output_stride );
+                    for( int x=0; x<width; ++x )
+                    {
+                        const size_t index = (size_t)y*width + x;
+                        int* p_vertices = &vertices[ index*6 ];
+                        if( band != 0 )
+                        {
+                            for( int i=0; i<6; ++i )
+                            {
+                                p_vertices[i] = remap[ p_vertices[i] ];
+                            }
+                        }
+                        
+                        float value[4];
+                        lattice.slice( p_vertices, &weights[ index*6 ], value );
+                        
+                        const float scale = 1.0f / value[3];
+                        p_output[x].R = (uint8_t)limit( (int)( value[0] * scale + 0.5f ), 0, 255 );
+                        p_output[x].G = (uint8_t)limit( (int)( value[1] * scale + 0.5f ), 0, 255 );
+                        p_output[x].B = (uint8_t)limit( (int)( value[2] * scale + 0.5f ), 0, 255 );
+                    }
+                }
+            } );
+        }
+        
+        /*
+         *  [return] deviation of the color weight of a tolerance. a color at the tolerance still weighs 0.6
+         *           of an equal color, so the noise within the tolerance is blurred as by the threshold.
+         *           a tolerance of 0 keeps only equal colors.
+         */
+        static inline float tolerance_deviation( const float tolerance )
+        {
+            return std::max( tolerance, 1.0f / 3.0f );
+        }
+    }
+    
+    /*
+     *  gaussian_keep_edge_hmb() by a permutohedral lattice. colors within the tolerances are blurred
+     *  together as before, but the color weight falls off as a gaussian instead of a hard threshold,
+     *  and pixels outside the image are not sampled. the work does not depend on sigma, so this is
+     *  for large sigma. it overtakes gaussian_keep_edge_hmb() at about sigma 20, while small sigma
+     *  splits the image into so many lattice vertices that it is several times slower.
+     *
+     *  [in]hue, magnitude, base_luminance tolerances as in gaussian_keep_edge_hmb(). 0 or more.
+     */
+    static inline ImageRGB::Move gaussian_keep_edge_hmb_approx( const ImageViewRGB& image,
+            const float sigma, const float hue, const float magnitude, const float base_luminance, const int threads = 1 )
+    {
+        if( sigma < 0.0f )
+        {
+            throw std::range_error( "gaussian : sigma < 0.0f" );
+        }
+        if( !( hue >= 0.0f && magnitude >= 0.0f && base_luminance >= 0.0f ) )
+        {
+            throw std::range_error( "gaussian_keep_edge_hmb_approx : tolerance < 0.0f" );
+        }
+        
+        std::vector< int > kernel;
+        const int radius = core::gaussian_kernel( sigma, kernel );
+        
+        ImageRGB output;
+        
+        if( radius != 0 && image.length != 0 )
+        {
+            // in the units of HMB_Q. M and B are integers.
+            const float hue_scale       = 1.0f / core::tolerance_deviation( hue * HMB_Q::HUE_SCALE );
+            const float magnitude_scale = 1.0f / core::tolerance_deviation( std::floor( magnitude ) );
+            const float base_scale      = 1.0f / core::tolerance_deviation( std::floor( base_luminance ) );
+            
+            core::keep_edge_lattice( image, core::kernel_deviation( kernel ), threads,
+                [=]( const RGB rgb, float* coordinates )
+                {
+                    const HMB_Q hmb = core::rgb_to_hmb_q( rgb );
+                    coordinates[0] = hmb.H * hue_scale;
+                    coordinates[1] = hmb.M * magnitude_scale;
+                    coordinates[2] = hmb.B * base_scale;
+                }, output );
+        }
+        else
+        {
+            output = image;
+        }
+        
+        return std::move( output );
+    }
+    
+    /*
+     *  gaussian_keep_edge_rgb() by a permutohedral lattice. see gaussian_keep_edge_hmb_approx().
+     *
+     *  [in]r, g, b tolerances as in gaussian_keep_edge_rgb().
+     */
+    static inline ImageRGB::Move gaussian_keep_edge_rgb_approx( const ImageViewRGB& image,
+                                                    const float sigma, const uint8_t r, const uint8_t g, const uint8_t b,
+                                                    const int threads = 1 )
+    {
+        if( sigma < 0.0f )
+        {
+            throw std::range_error( "gaussian : sigma < 0.0f" );
+        }
+        
+        std::vector< int > kernel;
+        const int radius = core::gaussian_kernel( sigma, kernel );
+        
+        ImageRGB output;
+        
+        if( radius != 0 && image.length != 0 )
+        {
+            const float r_scale = 1.0f / core::tolerance_deviation( r );
+            const float g_scale = 1.0f / core::tolerance_deviation( g );
+            const float b_scale = 1.0f / core::tolerance_deviation( b );
+            
+            core::keep_edge_lattice( image, core::kernel_deviation( kernel ), threads,
+                [=]( const RGB rgb, float* coordinates )
+                {
+                    coordinates[0] = rgb.R * r_scale;
+                    coordinates[1] = rgb.G * g_scale;
+                    coordinates[2] = rgb.B * b_scale;
+                }, output );
+        }
+        else
+        {
+            output = image;
+        }
+        
+        return std::move( output );
+    }
+    
+    static inline ImageRGB::Move restore_material(
+            const ImageViewRGB& blur_image, const ImageViewRGB& original_image, const float strength )
+    {
+        if( strength < 0.0f )
+        {
+            throw std::range_error( "strength < 0.0f" );
+        }
+        if( strength > 1.0f )
+        {
+            throw std::range_error( "strength > 1.0f" );
+        }
+        if( blur_image.size != original_image.size )
+        {
+            throw std::range_error( "blur_image.size != original_image.size" );
+        }
+        
+        ImageRGB output( blur_image.size, core::Initialize::none );
+
+        int istrength = (int)(strength * 1024.0f);
+        
+        for( int y=0; y<output.height; ++y )
+        {
+            const RGB* p_blur = blur_image.row( y );
+            const RGB* p_original = original_image.row( y );
+            RGB* p_output = output.row( y );
+            
+            for( int x=0; x<output.width; ++x )
+            {
+                const int min1 =
+                    core::fast_min( p_blur[x].R, core::fast_min(p_blur[x].G, p_blur[x].B) );
+                const int min2 =
+                    core::fast_min( p_original[x].R, core::fast_min(p_original[x].G, p_original[x].B) );
+                
+                const int add = ((min2 - min1) * istrength) >> 10;
+                
+                p_output[x] = (gs::ColorBufferRGB(p_blur[x]) + add).limit_min_max();
+            }
+        }
+        
+        return std::move( output );
+    }
+    
+    namespace core
+    {
+        // fore color of correct_color_temperature. throws range_error for invalid parameters.
+        static inline const RGB color_of_temperature( const float temperature, const float strength )
+        {
+            if( temperature < -1.0f )
+            {
+                throw std::range_error( "correct_color_temperature : correct_color_temperature < -1.0f" );
+            }
+            if( temperature > 1.0f )
+            {
+                throw std::range_error( "correct_color_temperature : correct_color_temperature > 1.0f" );
+            }
+            if( strength < 0.0f )
+            {
+                throw std::range_error( "correct_color_temperature : strength < 0.0f" );
+            }
+            if( strength > 1.0f )
+            {
+                throw std::range_error( "correct_color_temperature : strength > 1.0f" );
+            }
+            
+            const RGB table[6] = {
+                {255,  0,  0}, {255,255,  0}, {255,255,255},
+                {  0,255,255}, {  0,  0,255}, {  0,  0,255}, /* last data is sentinel. */
+            };
+            
+            if( temperature == 0.0f )
+            {
+                return table[2];
+            }
+            
+            int index = 0;
+            int alpha = 0;
+            if( temperature < 0.0f )
+            {
+                index = (1.0f+temperature) / 0.5f;
+                alpha = (int)(((1.0f+temperature) - index*0.5f) / 0.5f * 1024.0f);
+            }
+            else
+            {
+                index = temperature / 0.5f + 2;
+                alpha = (int)((temperature - (index-2)*0.5f) / 0.5f * 1024.0f);
+            }
+            
+            return gs::alpha_blend( table[index], table[index+1], alpha );
+        }
+    }
+    
+    /*
+     *  [return] correct image.
+     *
+     *  [in]image
+     *　　　　process image.
+     *
+     *  [in]temperature
+     *　　　　kelvin correct. [-1.0] - [1.0]
+     *       -1.0 Red. 0.0 White. 1.0 Blue
+     *
+     *  [in]strength [0.0] - [1.0]
+     */
+    static inline ImageRGB::Move correct_color_temperature( const ImageViewRGB& image, const float temperature, const float strength )
+    {
+        const RGB color = core::color_of_temperature( temperature, strength );
+        
+        ImageRGB output;
+        
+        if( temperature == 0.0f )
+        {
+            output = image;
+        }
+        else
+        {
+            output = image.alpha_blend( color, strength );
+        }
+        return std::move( output );
+    }
+    
+    /*
+     *  same as correct_color_temperature. the pixels of image are overwritten.
+     */
+    static inline void correct_color_temperature_inplace( ImageRGB& image, const float temperature, const float strength )
+    {
+        const RGB color = core::color_of_temperature( temperature, strength );
+        
+        if( temperature != 0.0f )
+        {
+            image.alpha_blend_inplace( color, strength );
+        }
+    }
+    
+    /*
+     *  [return] image with the color channels multiplied by alpha.
+     *
+     *  [in]image straight alpha.
+     */
+    static inline ImageARGB::Move premultiply_alpha( const ImageViewARGB& image )
+    {
+        ImageARGB output( image.size, core::Initialize::none );
+        
+        for( int y=0; y<image.height; ++y )
+        {
+            const RGBA* p_input = image.row( y );
+            RGBA* p_output = output.row( y );
+            
+            for( int x=0; x<image.width; ++x )
+            {
+                p_output[x] = premultiply( p_input[x] );
+            }
+        }
+        return std::move( output );
+    }
+    
+    static inline ImageARGB::Move unpremultiply_alpha( const ImageViewARGB& image )
+    {
+        ImageARGB output( image.size, core::Initialize::none );
+        
+        for( int y=0; y<image.height; ++y )
+        {
+            const RGBA* p_input = image.row( y );
+            RGBA* p_output = output.row( y );
+            
+            for( int x=0; x<image.width; ++x )
+            {
+                p_output[x] = unpremultiply( p_input[x] );
+            }
+        }
+        return std::move( output );
+    }
+    
+    /*
+     *  [return] fore over back.
+     *
+     *  [in]back, fore
+     *       premultiplied images of the same size.
+     */
+    static inline ImageARGB::Move composite_over( const ImageViewARGB& back, const ImageViewARGB& fore )
+    {
+        if( back.size != fore.size )
+        {
+            throw std::range_error( "composite_over : back.size != fore.size" );
+        }
+        
+        ImageARGB output( back.size, core::Initialize::none );
+        
+        for( int y=0; y<back.height; ++y )
+        {
+            const RGBA* p_back = back.row( y );
+            const RGBA* p_fore = fore.row( y );
+            RGBA* p_output = output.row( y );
+            
+            for( int x=0; x<back.width; ++x )
+            {
+                p_output[x] = composite_over( p_back[x], p_fore[x] );
             }
+        }
+        return std::move( output );
+    }
+    
+    namespace core
+    {
+        /*
+         *  x and y kernels of EdgeKernel::direction, unit vectors from the center. the vector of a pixel is
+         *  the sum of direction * ( center - target ), and the directions sum to 0, so it is minus the
+         *  correlation of the image with the directions.
+         *
+         *  [out]x_kernel, y_kernel column i of row j at [ i*side + j ], as ImageView::filter() reads it.
+         */
+        static inline void edge_kernels( const int radius, std::vector< float >& x_kernel, std::vector< float >& y_kernel )
+        {
+            const int side = radius * 2 + 1;
+            x_kernel.assign( side*side, 0.0f );
+            y_kernel.assign( side*side, 0.0f );
             
-#undef BlendConceptChannel
-#undef fore_color
-#undef back_color
-#undef args_color
-
-            void write( std::ostream& output ) const
+            for( int i=0; i<side; ++i )
             {
-                output.clear();
-                
-                core::BitmapHeader header;
-                const char paddingData[3] = {};
-                const int padding = (4-(width*sizeof(T)%4))%4;
-                
-                header.biWidth     = width;
-                header.biHeight    = height;
-                header.biBitCount  = sizeof(T)*8;
-                header.biSizeImage = length*sizeof(T);
-                header.bfOffBits   = sizeof(core::BitmapHeader);
-                if( header.biBitCount == 8 )
-                {
-                    header.bfOffBits += 4 * 256; //ColorTable
-                }
-                header.bfSize = header.bfOffBits + header.biSizeImage;
-                
-                output.write( (char*)&header, sizeof(core::BitmapHeader) );
-                
-                if( header.biBitCount == 8 ) // ColorTable
+                for( int j=0; j<side; ++j )
                 {
-                    uint8_t table[4] = { 0, 0, 0, 255 };
-                    for( int i=0; i<256; ++i )
+                    const Vector2 v( i-radius, j-radius );
+                    if( v.x != 0.0f || v.y != 0.0f )
                     {
-                        table[0] = table[1] = table[2] = i;
-                        output.write( (char*)table, 4 );
+                        x_kernel[ i*side + j ] = -v.normalize().x;
+                        y_kernel[ i*side + j ] = -v.normalize().y;
                     }
                 }
+            }
+        }
+        
+        /*
+         *  edge vectors of edge_detection(). a 3x3 kernel runs on integers with its axis and diagonal
+         *  weights, larger ones by ImageView::filter() of the two kernels.
+         *
+         *  [in]store store( y, x_vectors, y_vectors ) takes the width vectors of row y.
+         */
+        template <class Store>
+        static inline void edge_vectors( const ImageViewGRAY& gray, const int radius, const EdgeKernel kernel,
+                                         const Border border, const GRAY border_gray, const Store& store )
+        {
+            if( radius == 1 )
+            {
+                // sobel is scaled to give an axis aligned step the magnitude of the direction kernel.
+                const bool sobel = kernel == EdgeKernel::sobel;
+                const int axis     = sobel ? 2 : 1024;
+                const int diagonal = sobel ? 1 : 724;
+                const float scale  = sobel ? (float)( ( 1.0 + M_SQRT2 ) / 4.0 ) : 1.0f / 1024.0f;
                 
-                for( int y=height-1; y>=0; --y )
+                BorderRing< GRAY > ring( gray.width, 1, border, border_gray );
+                std::vector< float > x_vectors( gray.width ), y_vectors( gray.width );
+                
+                for( int y=0; y<gray.height; ++y )
                 {
-                    const char* data = (char*)&(*this)[{0,y}];
-                    for( int x=0; x<width; ++x )
-                    {
-                        for( int i=T::CHANNEL-1; i>=0; --i )
-                        {
-                            output.write( data+i, 1 );
-                        }
-                        data += T::CHANNEL;
-                    }
-                    if( padding != 0 )
+                    ring.seek( gray, y );
+                    const GRAY* p_above  = ring.row( -1 ) - 1;
+                    const GRAY* p_middle = ring.row( 0 )  - 1;
+                    const GRAY* p_below  = ring.row( 1 )  - 1;
+                    
+                    for( int x=0; x<gray.width; ++x )
                     {
-                        output.write( paddingData, padding );
+                        const int dx = axis * ( p_middle[x+2].L - p_middle[x].L ) +
+                                       diagonal * ( p_above[x+2].L - p_above[x].L + p_below[x+2].L - p_below[x].L );
+                        const int dy = axis * ( p_below[x+1].L - p_above[x+1].L ) +
+                                       diagonal * ( p_below[x].L - p_above[x].L + p_below[x+2].L - p_above[x+2].L );
+                        x_vectors[x] = -dx * scale;
+                        y_vectors[x] = -dy * scale;
                     }
+                    store( y, &x_vectors[0], &y_vectors[0] );
                 }
+                return;
             }
             
-            void write( const std::string& filepath ) const
+            std::vector< float > x_kernel, y_kernel;
+            edge_kernels( radius, x_kernel, y_kernel );
+            
+            Image< GRAY_F, ColorBufferGRAY_F > input;
+            input = gray;
+            const GRAY_F border_value = { (float)border_gray.L };
+            const Image< GRAY_F, ColorBufferGRAY_F > x_vectors( input.filter( x_kernel, border, border_value ) );
+            const Image< GRAY_F, ColorBufferGRAY_F > y_vectors( input.filter( y_kernel, border, border_value ) );
+            
+            for( int y=0; y<gray.height; ++y )
             {
-                std::fstream file;
-                file.open( filepath, std::ios::out | std::ios::binary );
-                write( file );
-                file.close();
+                store( y, (const float*)x_vectors.row( y ), (const float*)y_vectors.row( y ) );
             }
-            
-            inline Image& operator>>( const std::string& filepath )
+        }
+        
+        // [return] 1 over the largest vector of the kernel, as 255 levels of magnitude.
+        static inline float edge_magnitude_scale( const int radius )
+        {
+            return 1.0f / (float)( sqrt( radius*radius + radius*radius ) * radius );
+        }
+        
+        static inline void check_edge_kernel( const int radius, const EdgeKernel kernel )
+        {
+            if( radius < 1 )
             {
-                write( filepath );
-                return *this;
+                throw std::range_error( "edge_detection : radius < 1" );
             }
-
-            void read( const std::vector< uint8_t >& image_data )
+            if( kernel == EdgeKernel::sobel && radius != 1 )
             {
-                const core::BitmapHeader* header = (const core::BitmapHeader*)&image_data[0];
-                int index = sizeof(core::BitmapHeader);
-                
-                if( header->bfOffBits != 0 )
+                throw std::range_error( "edge_detection : sobel radius != 1" );
+            }
+        }
+    }
+    
+    /*
+     *  [return] H is the angle of the edge vector in degrees, M its magnitude in 0-255, B is 0.
+     *
+     *  [in]radius 1 or more. 1 for EdgeKernel::sobel.
+     */
+    static inline ImageHMB::Move edge_detection( const ImageViewRGB& image, const int radius,
+                                                 const Border border = Border::mirror, const RGB border_color = RGB(),
+                                                 const EdgeKernel kernel = EdgeKernel::direction )
+    {
+        core::check_edge_kernel( radius, kernel );
+        
+        ImageGRAY input;
+        ImageHMB output( image.size, core::Initialize::none );
+        
+        if( image.length == 0 )
+        {
+            return std::move( output );
+        }
+        input = image;
+        
+        const GRAY border_gray = { core::rgb_to_gray( border_color.R, border_color.G, border_color.B ) };
+        const float max_distance_inverse = core::edge_magnitude_scale( radius );
+        
+        core::edge_vectors( input, radius, kernel, border, border_gray,
+            [&]( const int y, const float* x_vectors, const float* y_vectors )
+            {
+                HMB* p_output = output.row( y );
+                for( int x=0; x<output.width; ++x )
                 {
-                    index = header->bfOffBits;
+                    const Vector2 vec( x_vectors[x], y_vectors[x] );
+                    
+                    p_output[x] = {
+                        vec.angle(),
+                        (float)core::fast_min( (int)(vec.magnitude() * max_distance_inverse), 255 ), 0 };
                 }
-                if( header->biBitCount == 8 ) // ColorTable
+            } );
+        
+        return std::move( output );
+    }
+    
+    /*
+     *  edge_detection() in 8 bits.
+     *
+     *  [out]magnitude   M of edge_detection().
+     *  [out]orientation angle of the edge vector in 256 steps from -180 degrees.
+     */
+    static inline void edge_detection_into( const ImageViewRGB& image, const int radius,
+                                            ImageGRAY& magnitude, ImageGRAY& orientation,
+                                            const Border border = Border::mirror, const RGB border_color = RGB(),
+                                            const EdgeKernel kernel = EdgeKernel::direction )
+    {
+        core::check_edge_kernel( radius, kernel );
+        
+        ImageGRAY input;
+        magnitude.create( image.size, core::Initialize::none );
+        orientation.create( image.size, core::Initialize::none );
+        
+        if( image.length == 0 )
+        {
+            return;
+        }
+        input = image;
+        
+        const GRAY border_gray = { core::rgb_to_gray( border_color.R, border_color.G, border_color.B ) };
+        const float max_distance_inverse = core::edge_magnitude_scale( radius );
+        
+        core::edge_vectors( input, radius, kernel, border, border_gray,
+            [&]( const int y, const float* x_vectors, const float* y_vectors )
+            {
+                GRAY* p_magnitude = magnitude.row( y );
+                GRAY* p_orientation = orientation.row( y );
+                for( int x=0; x<image.width; ++x )
                 {
-                    index += 4*256;
+                    const Vector2 vec( x_vectors[x], y_vectors[x] );
+                    
+                    p_magnitude[x].L = (uint8_t)core::fast_min( (int)(vec.magnitude() * max_distance_inverse), 255 );
+                    p_orientation[x].L = (uint8_t)( (int)( ( vec.angle() + 180.0f ) * ( 256.0f / 360.0f ) ) & 255 );
                 }
+            } );
+    }
+    
+    /*
+     *  Incremental recompute for re-uploaded, lightly edited images.
+     *
+     *  The input is hashed in fixed tiles. Only output tiles whose dependency
+     *  region (tile expanded by the filter radius) touches a changed input tile
+     *  are recomputed, the others are copied from the previous output.
+     *
+     *  The filter must be local: an output pixel may only depend on input pixels
+     *  within radius, and the image edge must be handled by a border mode that
+     *  only reads pixels near the edge. every mode except Border::wrap does.
+     */
+    template <class ImageType> class IncrementalFilter
+    {
+    public:
+        using View     = typename ImageType::View;
+        using Move     = typename ImageType::Move;
+        using Function = std::function< Move( const View& ) >;
+        
+    private:
+        std::mutex              m_mutex;
+        int                     m_tile_size;
+        SizeI                   m_size = { 0, 0 };
+        uint64_t                m_parameter = 0;
+        std::vector< uint64_t > m_hashes;
+        ImageType               m_output;
+        
+        // FNV-1a.
+        uint64_t hash_tile( const View& image, const RectangleI& tile ) const
+        {
+            uint64_t hash = 14695981039346656037ULL;
+            
+            for( int y=tile.y; y<tile.y+tile.height; ++y )
+            {
+                const uint8_t* data = (const uint8_t*)&image.row( y )[ tile.x ];
+                const uint8_t* end  = (const uint8_t*)&image.row( y )[ tile.x + tile.width ];
                 
-                create( {header->biWidth, header->biHeight} );
-                
-                const int padding = (4-(width*sizeof(T)%4))%4;
-                const int byteCount = header->biBitCount/8;
+                for( ; data<end; ++data )
+                {
+                    hash = (hash ^ *data) * 1099511628211ULL;
+                }
+            }
+            return hash;
+        }
+        
+        inline RectangleI tile_rectangle( const SizeI& size, const int tx, const int ty ) const
+        {
+            const int x = tx * m_tile_size;
+            const int y = ty * m_tile_size;
+            
+            return RectangleI( x, y,
+                core::fast_min( m_tile_size, size.width  - x ),
+                core::fast_min( m_tile_size, size.height - y ) );
+        }
+        
+    public:
+        IncrementalFilter( const int tile_size = 64 )
+        {
+            if( tile_size <= 0 )
+            {
+                throw std::range_error( "IncrementalFilter : tile_size <= 0" );
+            }
+            m_tile_size = tile_size;
+            
+            // the cache outlives request scoped allocators.
+            m_output.set_allocator( core::heap_allocator() );
+        }
+        
+        /*
+         *  [return] filtered image.
+         *
+         *  [in]input
+         *       process image.
+         *
+         *  [in]radius
+         *       dependency radius of func.
+         *
+         *  [in]parameter
+         *       hash of the filter parameters. the cache is discarded when it changes.
+         *
+         *  [in]func
+         *       local filter. applied to the whole image or to sub images.
+         */
+        Move process( const View& input, const int radius, const uint64_t parameter, const Function& func )
+        {
+            std::lock_guard< std::mutex > lock( m_mutex );
+            
+            const int tiles_x = (input.width  + m_tile_size - 1) / m_tile_size;
+            const int tiles_y = (input.height + m_tile_size - 1) / m_tile_size;
+            
+            std::vector< uint64_t > hashes( tiles_x * tiles_y );
+            std::vector< uint8_t >  changed( hashes.size() );
+            
+            for( int ty=0; ty<tiles_y; ++ty )
+            {
+                for( int tx=0; tx<tiles_x; ++tx )
+                {
+                    hashes[ ty*tiles_x+tx ] = hash_tile( input, tile_rectangle( input.size, tx, ty ) );
+                }
+            }
+            
+            const bool reuse =
+                m_size == input.size && m_parameter == parameter && m_hashes.size() == hashes.size();
+            
+            int changed_count = 0;
+            for( size_t i=0; i<hashes.size(); ++i )
+            {
+                changed[i] = !reuse || m_hashes[i] != hashes[i];
+                changed_count += changed[i];
+            }
+            
+            if( changed_count != 0 )
+            {
+                // a changed input tile dirties every output tile within reach tiles.
+                const int reach = (radius + m_tile_size - 1) / m_tile_size;
+                std::vector< uint8_t > dirty( hashes.size() );
+                int dirty_count = 0;
                 
-                for( int y=height-1; y>=0; --y )
+                for( int ty=0; ty<tiles_y; ++ty )
                 {
-                    char* data = (char*)&(*this)[{0,y}];
-                    for( int x=0; x<width; ++x )
+                    for( int tx=0; tx<tiles_x; ++tx )
                     {
-                        for( int i=T::CHANNEL-1; i>=0; --i )
+                        if( !changed[ ty*tiles_x+tx ] )
+                        {
+                            continue;
+                        }
+                        for( int dy=core::fast_max( ty-reach, 0 ); dy<=core::fast_min( ty+reach, tiles_y-1 ); ++dy )
                         {
-                            data[i] = image_data[index++];
+                            for( int dx=core::fast_max( tx-reach, 0 ); dx<=core::fast_min( tx+reach, tiles_x-1 ); ++dx )
+                            {
+                                dirty_count += !dirty[ dy*tiles_x+dx ];
+                                dirty[ dy*tiles_x+dx ] = 1;
+                            }
                         }
-                        data += byteCount;
                     }
-                    index += padding;
                 }
-            }
-
-            void read( std::istream& stream )
-            {
-                core::BitmapHeader header;
-                
-                stream.read( (char*)&header, sizeof(core::BitmapHeader) );
                 
-                if( header.bfOffBits != 0 )
+                // recomputing most of the tiles is slower than one full pass.
+                if( !reuse || dirty_count * 2 > (int)dirty.size() )
                 {
-                    stream.seekg( header.bfOffBits, std::ios_base::beg );
+                    const ImageType result = func( input );
+                    m_output.copy( result );
                 }
-                if( header.biBitCount == 8 ) // ColorTable
-                {
-                    stream.seekg( 4*256, std::ios_base::cur );
-                }
-                
-                create( {header.biWidth, header.biHeight} );
-                
-                const int padding = (4-(width*sizeof(T)%4))%4;
-                const int byteCount = header.biBitCount/8;
-                
-                for( int y=height-1; y>=0; --y )
+                else
                 {
-                    char* data = (char*)&(*this)[{0,y}];
-                    for( int x=0; x<width; ++x )
+                    for( int ty=0; ty<tiles_y; ++ty )
                     {
-                        for( int i=T::CHANNEL-1; i>=0; --i )
+                        for( int tx=0; tx<tiles_x; )
                         {
-                            stream.read( data+i, 1 );
+                            if( !dirty[ ty*tiles_x+tx ] )
+                            {
+                                ++tx;
+                                continue;
+                            }
+                            
+                            // merge a run of dirty tiles into one sub image.
+                            const int begin_tx = tx;
+                            while( tx < tiles_x && dirty[ ty*tiles_x+tx ] )
+                            {
+                                ++tx;
+                            }
+                            const RectangleI first = tile_rectangle( input.size, begin_tx, ty );
+                            const RectangleI last  = tile_rectangle( input.size, tx-1, ty );
+                            const RectangleI run( first.x, first.y, last.x + last.width - first.x, first.height );
+                            
+                            const int begin_x = core::fast_max( run.x - radius, 0 );
+                            const int begin_y = core::fast_max( run.y - radius, 0 );
+                            const int end_x   = core::fast_min( run.x + run.width  + radius, input.width  );
+                            const int end_y   = core::fast_min( run.y + run.height + radius, input.height );
+                            
+                            const ImageType result = func( input.view( { begin_x, begin_y, end_x-begin_x, end_y-begin_y } ) );
+                            
+                            for( int y=0; y<run.height; ++y )
+                            {
+                                memcpy(
+                                    &m_output.row( run.y+y )[ run.x ],
+                                    &result.row( run.y+y-begin_y )[ run.x-begin_x ],
+                                    sizeof(*result.row( 0 ))*run.width );
+                            }
                         }
-                        data += byteCount;
-                    }
-                    if( padding != 0 )
-                    {
-                        stream.seekg( padding, std::ios_base::cur );
                     }
                 }
             }
             
-            void read( const std::string& filepath )
-            {
-                std::ifstream file;
-                
-                file.open( filepath, std::ios::in | std::ios::binary );
-                read( file );
-                file.close();
-            }
+            m_size      = input.size;
+            m_parameter = parameter;
+            m_hashes    = std::move( hashes );
             
-            inline Image& operator<<(const std::string& filepath)
-            {
-                read( filepath );
-                return *this;
-            }
-        };
-
-        template<> void Image<GRAY, ColorBufferGRAY>::convert( const Image<RGB, ColorBufferRGB>& image )
-        {
-            create( image.size );
-            for( unsigned int i=0; i<length; ++i )
-            {
-                const RGB rgb = image[i];
-                (*this)[i].L = (uint8_t)((rgb.R*306 + rgb.G*601 + rgb.B * 117) >> 10);
-            }
+            // the caller shares the cached output until one side writes.
+            ImageType output( m_output );
+            return std::move( output );
         }
         
-        template<> void Image<RGB, ColorBufferRGB>::convert( const Image<GRAY, ColorBufferGRAY>& image )
+        // [in]threads cap of the threads of each blur. the result does not depend on it.
+        Move gaussian( const View& input, const float sigma, const int threads = 1 )
         {
-            create( image.size );
-            for( unsigned int i=0; i<length; ++i )
+            uint32_t parameter = 0;
+            memcpy( &parameter, &sigma, sizeof(float) );
+            
+            return process( input, (int)sigma, parameter, [sigma, threads]( const View& image )
             {
-                const auto gray = image[i];
-                (*this)[i] = { gray.L, gray.L, gray.L };
-            }
+                // the FIR kernel, so a changed tile affects only the pixels within (int)sigma.
+                return image.gaussian_fir( sigma, threads );
+            });
         }
-
-        template<> void Image<RGB, ColorBufferRGB>::convert( const Image<HMB, ColorBufferHMB>& image )
+    };
+    
+    /*
+     *  gaussian and laplacian pyramid of an image. level 0 is the image, and each level is the one
+     *  before blurred by gaussian() and decimated to half the size by resize(). levels and bands are
+     *  built the first time they are used, so one pyramid serves several outputs of the same image.
+     */
+    template <class ImageType> class Pyramid
+    {
+    public:
+        using View       = typename ImageType::View;
+        using Move       = typename ImageType::Move;
+        using Channel    = typename ImageType::Pixel::Type;
+        using Difference = typename core::ChannelDifference< Channel >::Type;
+        
+        // level minus the next level resized to its size. CHANNEL differences per pixel.
+        struct Band
         {
-            const RGB table[7] = {
-                {255,  0,  0}, {255,255,  0}, {  0,255,  0}, {  0,255,255},
-                {  0,  0,255}, {255,  0,255}, {255,  0,  0},
-            };
-            
-            RGB color;
-            create( image.size );
-            for( unsigned int i=0; i<length; ++i )
+            SizeI size;
+            std::vector< Difference > values;
+        };
+        
+        // sigma of the blur before each decimation. a deviation of about 1 pixel.
+        static constexpr float DECIMATION_SIGMA = 2.0f;
+        
+    private:
+        std::mutex                 m_mutex;
+        int                        m_threads;
+        std::vector< ImageType >   m_levels;
+        std::vector< Band >        m_bands;
+        std::vector< uint8_t >     m_level_built;
+        std::vector< uint8_t >     m_band_built;
+        
+        const ImageType& build_level( const int index )
+        {
+            if( !m_level_built[ index ] )
             {
-                const HMB hmb = image[i];
+                const ImageType& upper = build_level( index-1 );
+                const SizeI size( ( upper.width + 1 ) / 2, ( upper.height + 1 ) / 2 );
                 
-                const float angle         = hmb.H + (360.0f*2.0f); // Make it a positive number.
-                const int   angle_integer = (int)(angle / 60.0f);
-                const float alpha         = (angle - angle_integer * 60.0f) / 60.0f;
-                const int   index         = angle_integer % 6;
-                const float f_magnitude   = hmb.M / 255.0f;
-                const float R = (table[index].R * (1.0f - alpha) + table[index+1].R * alpha) * f_magnitude;
-                const float G = (table[index].G * (1.0f - alpha) + table[index+1].G * alpha) * f_magnitude;
-                const float B = (table[index].B * (1.0f - alpha) + table[index+1].B * alpha) * f_magnitude;
+                const ImageType blurred( upper.gaussian( DECIMATION_SIGMA, m_threads ) );
                 
-                color.R = fast_min( (int)(R + hmb.B), 255 );
-                color.G = fast_min( (int)(G + hmb.B), 255 );
-                color.B = fast_min( (int)(B + hmb.B), 255 );
-                
-                (*this)[i] = color;
+                m_levels[ index ] = blurred.resize( size, Interpolation::bilinear );
+                m_level_built[ index ] = 1;
             }
+            return m_levels[ index ];
         }
-
-        template<> void Image<HMB, ColorBufferHMB>::convert( const Image<RGB, ColorBufferRGB>& image )
+        
+        Band& build_band( const int index )
         {
-            const Vector2   degree0_R(  1.0f,  0.0f      );
-            const Vector2 degree120_G( -0.5f,  0.866025f );
-            const Vector2 degree240_B( -0.5f, -0.866025f );
-            
-            HMB color;
-            create( image.size );
-            for( unsigned int i=0; i<length; ++i )
+            if( !m_band_built[ index ] )
             {
-                const RGB rgb = image[i];
-                const float base = (float)fast_min( rgb.R, fast_min( rgb.G, rgb.B) );
-                const float R = rgb.R - base;
-                const float G = rgb.G - base;
-                const float B = rgb.B - base;
-                const Vector2 vec = (degree0_R * R) + (degree120_G * G) + (degree240_B * B);
+                const ImageType& level = build_level( index );
+                const ImageType expanded = build_level( index+1 ).resize( level.size, Interpolation::bilinear );
+                const int CHANNEL = ImageType::Pixel::CHANNEL;
+                Band& band = m_bands[ index ];
                 
-                color.H = core::radian_to_degree( atan2( vec.y, vec.x ) );
-                color.M = fast_max( rgb.R, fast_max( rgb.G, rgb.B) ) - base;
-                color.B = base;
+                band.size = level.size;
+                band.values.resize( (size_t)level.length * CHANNEL );
                 
-                (*this)[i] = color;
+                for( int y=0; y<level.height; ++y )
+                {
+                    const Channel* p_level = (const Channel*)level.row( y );
+                    const Channel* p_expanded = (const Channel*)expanded.row( y );
+                    Difference* p_band = &band.values[ (size_t)level.width * CHANNEL * y ];
+                    
+                    for( int x=0; x<level.width*CHANNEL; ++x )
+                    {
+                        p_band[x] = (Difference)( p_level[x] - p_expanded[x] );
+                    }
+                }
+                m_band_built[ index ] = 1;
             }
+            return m_bands[ index ];
         }
-    }
-    using ImageGRAY   = core::Image< GRAY  , ColorBufferGRAY   >;
-    using ImageGRAY_F = core::Image< GRAY_F, ColorBufferGRAY_F >;
-    using ImageRGB    = core::Image<  RGB  , ColorBufferRGB    >;
-    using ImageARGB   = core::Image< RGBA  , ColorBufferRGBA   >;
-    using ImageHMB    = core::Image<  HMB  , ColorBufferHMB    >;
-    
-    static inline ImageRGB::Move gaussian_keep_edge_hmb( const ImageRGB& image,
-            const float sigma, const float hue, const float magnitude, const float base_luminance )
-    {
-        if( sigma < 0.0f )
+        
+    public:
+        /*
+         *  [in]image   level 0. shared until one side writes.
+         *  [in]threads of the gaussian() calls.
+         */
+        Pyramid( const View& image, const int threads = 1 )
         {
-            throw std::range_error( "gaussian : sigma < 0.0f" );
+            if( image.width <= 0 || image.height <= 0 )
+            {
+                throw std::range_error( "Pyramid : empty image" );
+            }
+            m_threads = threads;
+            
+            // down to 1 pixel in width or height.
+            int count = 1;
+            for( SizeI size = image.size; size.width > 1 && size.height > 1; ++count )
+            {
+                size = SizeI( ( size.width + 1 ) / 2, ( size.height + 1 ) / 2 );
+            }
+            
+            m_levels.resize( count );
+            m_bands.resize( count-1 );
+            m_level_built.resize( count );
+            m_band_built.resize( count-1 );
+            
+            m_levels[0] = image;
+            m_level_built[0] = 1;
         }
         
-        const float pixel_distance_scale = 2.0f;
-        const int radius = (int)( sigma / pixel_distance_scale * 2.0f );
+        inline int level_count() const
+        {
+            return (int)m_levels.size();
+        }
         
-        ImageRGB output( image.size );
-
-        if( radius != 0 )
+        // [return] gaussian level. level 0 is the image.
+        const ImageType& level( const int index )
         {
-            std::vector< int > kernel( radius * 2 + 1 );
-            
-            const double sigma_2_square = 2 * sigma * sigma;
-            double root_sigma_square_pi = sqrt(2.0 * M_PI * sigma * sigma);
-            
-            double sum = 0.0;
-            for( int i=0; i<(int)kernel.size(); ++i )
+            if( index < 0 || index >= level_count() )
             {
-                double distance = (i-radius) * pixel_distance_scale;
-                
-                sum += exp( -(distance*distance / sigma_2_square) ) / root_sigma_square_pi;
+                throw std::range_error( "level : index out of range" );
             }
+            std::lock_guard< std::mutex > lock( m_mutex );
             
-            const double weight = 4096.0 / sum;
-            for( int i=0; i<(int)kernel.size(); ++i )
+            return build_level( index );
+        }
+        
+        // [return] laplacian band of level index. may be changed before reconstruct().
+        Band& laplacian( const int index )
+        {
+            if( index < 0 || index >= level_count()-1 )
             {
-                double distance = (i-radius) * pixel_distance_scale;
-                
-                kernel[i] = (int)(
-                                  (exp( -(distance*distance / sigma_2_square) ) / root_sigma_square_pi ) * weight);
+                throw std::range_error( "laplacian : index out of range" );
             }
+            std::lock_guard< std::mutex > lock( m_mutex );
             
-            ImageRGB input;
-            ImageHMB hmb;
-            
-            input = image.mirror_border(radius, radius);
-            hmb = input;
-            
-            const RGB* p_input = &input[0];
-            const HMB* p_hmb = &hmb[0];
-            RGB* p_output = &output[0];
+            return build_band( index );
+        }
+        
+        /*
+         *  [return] level 0 rebuilt from level top and the laplacian bands above it.
+         *           the image itself while the bands are unchanged.
+         */
+        Move reconstruct( const int top )
+        {
+            if( top < 0 || top >= level_count() )
+            {
+                throw std::range_error( "reconstruct : top out of range" );
+            }
+            std::lock_guard< std::mutex > lock( m_mutex );
             
-            ImageRGB horizontal_rgb( {input.width, 1 } );
-            ImageHMB horizontal_hmb( {input.width, 1 } );
+            const int CHANNEL = ImageType::Pixel::CHANNEL;
+            ImageType output( build_level( top ) );
             
-            for( int y=0; y<output.height; ++y )
+            for( int index=top-1; index>=0; --index )
             {
-                // vertical filter.
-                for( int x=0; x<input.width; ++x, ++p_input, ++p_hmb )
-                {
-                    gs::HMB center_color_hmb = hmb[ {x,y+radius} ];
-                    
-                    const gs::RGB* p_input_xy = p_input;
-                    const gs::HMB* p_hmb_xy = p_hmb;
-                    
-                    gs::ColorBufferRGB color;
-                    int much_weight = 0;
-                    for( int i=0; i<kernel.size(); ++i, p_input_xy += input.width, p_hmb_xy += hmb.width )
-                    {
-                        if( std::abs(center_color_hmb.H - (*p_hmb_xy).H) <= hue &&
-                            std::abs(center_color_hmb.M - (*p_hmb_xy).M) <= magnitude &&
-                            std::abs(center_color_hmb.B - (*p_hmb_xy).B) <= base_luminance )
-                        {
-                            color += ColorBufferRGB(*p_input_xy) * kernel[ i ];
-                            much_weight += kernel[i];
-                        }
-                    }
-                    horizontal_rgb[x] = color / much_weight;
-                }
+                const Band& band = build_band( index );
+                ImageType expanded( output.resize( band.size, Interpolation::bilinear ) );
                 
-                horizontal_hmb = horizontal_rgb;
-                
-                // horizontal filter.
-                for( int x=0; x<output.width; ++x, ++p_output )
+                for( int y=0; y<band.size.height; ++y )
                 {
-                    HMB center_color_hmb = horizontal_hmb[ x+radius ];
+                    Channel* p_expanded = (Channel*)expanded.row( y );
+                    const Difference* p_band = &band.values[ (size_t)band.size.width * CHANNEL * y ];
                     
-                    ColorBufferRGB color;
-                    int much_weight = 0;
-                    for( int i=0; i<kernel.size(); ++i )
+                    for( int x=0; x<band.size.width*CHANNEL; ++x )
                     {
-                        if( std::abs(center_color_hmb.H - horizontal_hmb[x+i].H) <= hue &&                            std::abs(center_color_hmb.M - horizontal_hmb[x+i].M) <= magnitude &&
-                            std::abs(center_color_hmb.B - horizontal_hmb[x+i].B) <= base_luminance )
-                        {
-                            color += gs::ColorBufferRGB(horizontal_rgb[i+x]) * kernel[ i ];
-                            much_weight += kernel[i];
-                        }
+                        core::store_channel( p_expanded[x], (float)p_expanded[x] + (float)p_band[x] );
                     }
-                    *p_output = color / much_weight;
                 }
+                output = std::move( expanded );
             }
-        }
-        else
-        {
-            output = image;
-        }
-        
-        return std::move( output );
-    }
-    
-    static inline ImageRGB::Move gaussian_keep_edge_rgb( const ImageRGB& image,
-                                                    const float sigma, const uint8_t r, const uint8_t g, const uint8_t b )
-    {
-        if( sigma < 0.0f )
-        {
-            throw std::range_error( "gaussian : sigma < 0.0f" );
+            return std::move( output );
         }
         
-        const float pixel_distance_scale = 2.0f;
-        const int radius = (int)( sigma / pixel_distance_scale * 2.0f );
-        
-        ImageRGB output( image.size );
-        
-        if( radius != 0 )
+        /*
+         *  [return] gaussian() of the image, run on the coarsest level that still needs a blur of 2 pixels
+         *           or more, and resized back. each level down costs a quarter of the one before.
+         */
+        Move gaussian( const float sigma )
         {
-            std::vector< int > kernel( radius * 2 + 1 );
+            if( sigma < 0.0f )
+            {
+                throw std::range_error( "gaussian : sigma < 0.0f" );
+            }
             
-            const double sigma_2_square = 2 * sigma * sigma;
-            double root_sigma_square_pi = sqrt(2.0 * M_PI * sigma * sigma);
+            std::vector< int > kernel;
+            core::gaussian_kernel( sigma, kernel );
+            const double target = core::kernel_deviation( kernel );
             
-            double sum = 0.0;
-            for( int i=0; i<(int)kernel.size(); ++i )
+            std::vector< int > decimation;
+            core::gaussian_kernel( DECIMATION_SIGMA, decimation );
+            const double step = core::kernel_deviation( decimation );
+            
+            // variance in pixels of level 0 carried by level index and by resizing it back.
+            double carried = 0.0;
+            int index = 0;
+            double residual = target;
+            
+            for( int i=1; i<level_count(); ++i )
             {
-                double distance = (i-radius) * pixel_distance_scale;
+                const double scale = (double)( 1 << i );
+                carried += step*step * ( scale/2 ) * ( scale/2 );
                 
-                sum += exp( -(distance*distance / sigma_2_square) ) / root_sigma_square_pi;
+                // a blur of 2 pixels on the level keeps the resize from showing.
+                const double remaining = target*target - carried - scale*scale / 6.0;
+                if( remaining < 4.0 * scale*scale )
+                {
+                    break;
+                }
+                index = i;
+                residual = sqrt( remaining ) / scale;
             }
             
-            const double weight = 4096.0 / sum;
-            for( int i=0; i<(int)kernel.size(); ++i )
+            if( index == 0 )
             {
-                double distance = (i-radius) * pixel_distance_scale;
-                
-                kernel[i] = (int)(
-                                  (exp( -(distance*distance / sigma_2_square) ) / root_sigma_square_pi ) * weight);
+                return level( 0 ).gaussian( sigma, m_threads );
             }
             
-            ImageRGB input;
-            
-            input = image.mirror_border(radius, radius);
-            
-            const RGB* p_input = &input[0];
-            RGB* p_output = &output[0];
-            
-            ImageRGB horizontal_rgb( {input.width, 1 } );
+            const ImageType& coarse = level( index );
+            const ImageType blurred( coarse.gaussian( core::gaussian_sigma( residual ), m_threads ) );
+            return blurred.resize( m_levels[0].size, Interpolation::bilinear );
+        }
+    };
+    
+    namespace core
+    {
+        /*
+         *  summed area table of height rows of width pixels of channels values. row y+1 and column x+1
+         *  hold the sums of the rows above y and the columns left of x, so row 0 and column 0 are zero.
+         *  the rows are summed in bands and the columns in blocks, both in parallel.
+         *
+         *  [in]load  load( y, line ) stores the width*channels values of row y in line.
+         *  [out]table (height+1) rows of (width+1)*channels sums.
+         */
+        template <class Sum, class Load>
+        static inline void summed_area_table( const int width, const int height, const int channels, const int threads,
+                                              const Load& load, Sum* table )
+        {
+            const int pitch = ( width + 1 ) * channels;
+            std::fill( table, table + pitch, Sum() );
             
-            for( int y=0; y<output.height; ++y )
+            parallel_bands( height, threads, [&]( const int, const int begin, const int end )
             {
-                // vertical filter.
-                for( int x=0; x<input.width; ++x, ++p_input )
+                for( int y=begin; y<end; ++y )
                 {
-                    RGB center_color_rgb = input[ {x,y+radius} ];
-                    
-                    const RGB* p_input_xy = p_input;
+                    Sum* p_row = table + (size_t)( y+1 ) * pitch;
                     
-                    ColorBufferRGB color;
-                    int much_weight = 0;
-                    for( int i=0; i<kernel.size(); ++i, p_input_xy += input.width )
+                    std::fill( p_row, p_row + channels, Sum() );
+                    load( y, p_row + channels );
+                    for( int i=channels; i<pitch; ++i )
                     {
-                        if( core::fast_abs(center_color_rgb.R - (*p_input_xy).R) <= r &&
-                            core::fast_abs(center_color_rgb.G - (*p_input_xy).G) <= g &&
-                            core::fast_abs(center_color_rgb.B - (*p_input_xy).B) <= b )
-                        {
-                            color += ColorBufferRGB(*p_input_xy) * kernel[ i ];
-                            much_weight += kernel[i];
-                        }
+                        p_row[i] += p_row[ i-channels ];
                     }
-                    horizontal_rgb[x] = color / much_weight;
                 }
-                
-                // horizontal filter.
-                for( int x=0; x<output.width; ++x, ++p_output )
+            } );
+            
+            parallel_bands( pitch, threads, [&]( const int, const int begin, const int end )
+            {
+                for( int y=1; y<height; ++y )
                 {
-                    RGB center_color_rgb = horizontal_rgb[ x+radius ];
+                    const Sum* p_above = table + (size_t)y * pitch;
+                    Sum* p_row = table + (size_t)( y+1 ) * pitch;
                     
-                    ColorBufferRGB color;
-                    int much_weight = 0;
-                    for( int i=0; i<kernel.size(); ++i )
+                    for( int i=begin; i<end; ++i )
                     {
-                        if( core::fast_abs(center_color_rgb.R - horizontal_rgb[x+i].R) <= r &&
-                            core::fast_abs(center_color_rgb.G - horizontal_rgb[x+i].G) <= g &&
-                            core::fast_abs(center_color_rgb.B - horizontal_rgb[x+i].B) <= b )
-                        {
-                            color += gs::ColorBufferRGB(horizontal_rgb[i+x]) * kernel[ i ];
-                            much_weight += kernel[i];
-                        }
+                        p_row[i] += p_above[i];
                     }
-                    *p_output = color / much_weight;
                 }
-            }
+            } );
         }
-        else
+        
+        // [return] sum of the box from column x0 to x1 and row y0 to y1, excluding x1 and y1, of one channel.
+        template <class Sum>
+        inline static Sum box_sum( const Sum* table, const int pitch, const int x0, const int y0, const int x1, const int y1 )
         {
-            output = image;
+            const Sum* p_top    = table + (size_t)y0 * pitch;
+            const Sum* p_bottom = table + (size_t)y1 * pitch;
+            
+            return p_bottom[ x1 ] - p_bottom[ x0 ] - p_top[ x1 ] + p_top[ x0 ];
         }
-        
-        return std::move( output );
     }
     
-    static inline ImageRGB::Move restore_material(
-            const ImageRGB& blur_image, const ImageRGB& original_image, const float strength )
+    /*
+     *  summed area tables of an 8bit image. the sum and the sum of squares of any box are read in O(1),
+     *  so box means and variances cost the same for any radius. unsigned sums wrap around, but the
+     *  sum of a box is still exact while it fits Sum. uint32_t fits the sums of squares of boxes up to
+     *  66049 pixels, a radius of 128. uint64_t fits any image.
+     */
+    template <class ImageType, class Sum = uint32_t> class IntegralImage
     {
-        if( strength < 0.0f )
-        {
-            throw std::range_error( "strength < 0.0f" );
-        }
-        if( strength > 1.0f )
-        {
-            throw std::range_error( "strength > 1.0f" );
-        }
-        if( blur_image.size != original_image.size )
-        {
-            throw std::range_error( "blur_image.size != original_image.size" );
-        }
+    public:
+        using View    = typename ImageType::View;
+        using Move    = typename ImageType::Move;
+        using Channel = typename ImageType::Pixel::Type;
+        static const int CHANNEL = ImageType::Pixel::CHANNEL;
         
-        ImageRGB output( blur_image.size );
-
-        int istrength = (int)(strength * 1024.0f);
+        static_assert( std::is_same< Channel, uint8_t >::value, "IntegralImage : 8bit channels" );
+        
+    private:
+        SizeI              m_size;
+        int                m_pitch;
+        std::vector< Sum > m_sums;
+        std::vector< Sum > m_products;
         
-        for( int i=0; i<output.length; ++i )
+        void build( const View& image, const View& other, const int threads )
         {
-            const int min1 =
-                core::fast_min( blur_image[i].R, core::fast_min(blur_image[i].G, blur_image[i].B) );
-            const int min2 =
-                core::fast_min( original_image[i].R, core::fast_min(original_image[i].G, original_image[i].B) );
+            m_size = image.size;
+            m_pitch = ( image.width + 1 ) * CHANNEL;
+            m_sums.resize( (size_t)m_pitch * ( image.height + 1 ) );
+            m_products.resize( m_sums.size() );
             
-            const int add = ((min2 - min1) * istrength) >> 10;
-            
-            output[i] = (gs::ColorBufferRGB(blur_image[i]) + add).limit_min_max();
+            const int count = image.width * CHANNEL;
+            core::summed_area_table( image.width, image.height, CHANNEL, threads, [&]( const int y, Sum* line )
+            {
+                const Channel* p_input = (const Channel*)image.row( y );
+                for( int i=0; i<count; ++i )
+                {
+                    line[i] = p_input[i];
+                }
+            }, &m_sums[0] );
+            core::summed_area_table( image.width, image.height, CHANNEL, threads, [&]( const int y, Sum* line )
+            {
+                const Channel* p_input = (const Channel*)image.row( y );
+                const Channel* p_other = (const Channel*)other.row( y );
+                for( int i=0; i<count; ++i )
+                {
+                    line[i] = (Sum)( p_input[i] * p_other[i] );
+                }
+            }, &m_products[0] );
         }
         
-        return std::move( output );
-    }
-    /*
-     *  [return] correct image.
-     *
-     *  [in]image
-     *　　　　process image.
-     *
-     *  [in]temperature
-     *　　　　kelvin correct. [-1.0] - [1.0]
-     *       -1.0 Red. 0.0 White. 1.0 Blue
-     *
-     *  [in]strength [0.0] - [1.0]
-     */
-    static inline ImageRGB::Move correct_color_temperature( const ImageRGB& image, const float temperature, const float strength )
-    {
-        if( temperature < -1.0f )
-        {
-            throw std::range_error( "correct_color_temperature : correct_color_temperature < -1.0f" );
-        }
-        if( temperature > 1.0f )
+    public:
+        IntegralImage() : m_pitch( 0 ){}
+        
+        // tables of the image and of its squares.
+        IntegralImage( const View& image, const int threads = 1 )
         {
-            throw std::range_error( "correct_color_temperature : correct_color_temperature > 1.0f" );
+            build( image, image, threads );
         }
-        if( strength < 0.0f )
+        
+        // tables of the image and of its products with other, the guide of guided_filter().
+        IntegralImage( const View& image, const View& other, const int threads = 1 )
         {
-            throw std::range_error( "correct_color_temperature : strength < 0.0f" );
+            if( image.size != other.size )
+            {
+                throw std::range_error( "image.size != other.size" );
+            }
+            build( image, other, threads );
         }
-        if( strength > 1.0f )
+        
+        inline const SizeI& size() const
         {
-            throw std::range_error( "correct_color_temperature : strength > 1.0f" );
+            return m_size;
         }
         
-        const RGB table[6] = {
-            {255,  0,  0}, {255,255,  0}, {255,255,255},
-            {  0,255,255}, {  0,  0,255}, {  0,  0,255}, /* last data is sentinel. */
-        };
-        
-        ImageRGB output;
-        
-        if( temperature == 0.0f )
+        /*
+         *  [in]x0, y0, x1, y1 box from column x0 to x1 and row y0 to y1, excluding x1 and y1.
+         *                     0 <= x0 <= x1 <= width and 0 <= y0 <= y1 <= height.
+         *  [out]sums          CHANNEL sums of the pixels.
+         *  [out]products      CHANNEL sums of the squares or of the products with other. may be nullptr.
+         */
+        void sum( const int x0, const int y0, const int x1, const int y1, Sum* sums, Sum* products = nullptr ) const
         {
-            output = image;
+            for( int c=0; c<CHANNEL; ++c )
+            {
+                sums[c] = core::box_sum( &m_sums[c], m_pitch, x0*CHANNEL, y0, x1*CHANNEL, y1 );
+            }
+            if( products != nullptr )
+            {
+                for( int c=0; c<CHANNEL; ++c )
+                {
+                    products[c] = core::box_sum( &m_products[c], m_pitch, x0*CHANNEL, y0, x1*CHANNEL, y1 );
+                }
+            }
         }
-        else
+        
+        /*
+         *  statistics of the box of radius around a pixel. the box is cut at the image edges.
+         *
+         *  [return] number of pixels in the box.
+         *
+         *  [out]means     CHANNEL means.
+         *  [out]variances CHANNEL variances. may be nullptr.
+         */
+        int statistics( const int x, const int y, const int radius, float* means, float* variances = nullptr ) const
         {
-            int index = 0;
-            int alpha = 0;
-            if( temperature < 0.0f )
+            const int x0 = core::fast_max( x - radius, 0 );
+            const int y0 = core::fast_max( y - radius, 0 );
+            const int x1 = core::fast_min( x + radius + 1, m_size.width );
+            const int y1 = core::fast_min( y + radius + 1, m_size.height );
+            const int count = ( x1 - x0 ) * ( y1 - y0 );
+            const double scale = 1.0 / count;
+            
+            // in double. the variance is a small difference of large squares.
+            Sum sums[ CHANNEL ], squares[ CHANNEL ];
+            sum( x0, y0, x1, y1, sums, variances != nullptr ? squares : nullptr );
+            
+            for( int c=0; c<CHANNEL; ++c )
             {
-                index = (1.0f+temperature) / 0.5f;
-                alpha = (int)(((1.0f+temperature) - index*0.5f) / 0.5f * 1024.0f);
+                const double mean = (double)sums[c] * scale;
+                means[c] = (float)mean;
+                if( variances != nullptr )
+                {
+                    variances[c] = (float)std::max( (double)squares[c] * scale - mean * mean, 0.0 );
+                }
             }
-            else
+            return count;
+        }
+        
+        // [return] mean of the box of radius around every pixel. cut at the image edges.
+        Move box_mean( const int radius, const int threads = 1 ) const
+        {
+            if( radius < 0 )
             {
-                index = temperature / 0.5f + 2;
-                alpha = (int)((temperature - (index-2)*0.5f) / 0.5f * 1024.0f);
+                throw std::range_error( "box_mean : radius < 0" );
             }
             
-            output = image.alpha_blend( gs::alpha_blend( table[index], table[index+1], alpha ), strength );
+            ImageType output( m_size, core::Initialize::none );
+            Channel* const output_pixels = (Channel*)output.row( 0 );
+            const ptrdiff_t output_stride = output.stride;
+            
+            core::parallel_bands( m_size.height, threads, [&]( const int, const int begin, const int end )
+            {
+                for( int y=begin; y<end; ++y )
+                {
+                    Channel* p_output = core::offset_row( output_pixels, y*output_stride );
+                    for( int x=0; x<m_size.width; ++x, p_output+=CHANNEL )
+                    {
+                        float means[ CHANNEL ];
+                        statistics( x, y, radius, means );
+                        for( int c=0; c<CHANNEL; ++c )
+                        {
+                            core::round_channel( p_output[c], means[c] );
+                        }
+                    }
+                }
+            } );
+            return std::move( output );
         }
-        return std::move( output );
-    }
+    };
     
-    static inline ImageHMB::Move edge_detection( const ImageRGB& image, const int radius )
+    namespace core
     {
-        const int side = radius * 2 + 1;
-        std::vector< Vector2 > direction( side*side );
-        
-        int index = 0;
-        for( int y=0; y<side; ++y )
+        /*
+         *  guided filter of He, Sun and Tang. every box is fitted by output = a*guide + b, and the a and b
+         *  of the boxes over a pixel are averaged. the boxes are read from summed area tables.
+         */
+        template <class Sum, class ImageType>
+        static inline void guided_filter_into( const typename ImageType::View& image, const typename ImageType::View& guide,
+                                          const int radius, const float epsilon, const int threads, ImageType& output )
         {
-            for( int x=0; x<side; ++x, ++index )
+            using Channel = typename ImageType::Pixel::Type;
+            const int CHANNEL = ImageType::Pixel::CHANNEL;
+            const int width  = image.width;
+            const int height = image.height;
+            
+            // a guide of the image itself needs only the tables of the image.
+            const IntegralImage< ImageType, Sum > guide_table( guide, threads );
+            const bool self = image.row( 0 ) == guide.row( 0 ) && image.stride == guide.stride;
+            const IntegralImage< ImageType, Sum > image_table =
+                self ? IntegralImage< ImageType, Sum >() : IntegralImage< ImageType, Sum >( image, guide, threads );
+            const float regularization = epsilon * 255.0f * 255.0f;
+            
+            // a and b side by side for every channel.
+            const int count = width * CHANNEL * 2;
+            ScratchBuffer< float > coefficients( (size_t)count * height );
+            parallel_bands( height, threads, [&]( const int, const int begin, const int end )
             {
-                Vector2 v( x-radius, y-radius );
-                
-                if( v.x == 0.0f && v.y == 0.0f )
+                for( int y=begin; y<end; ++y )
                 {
-                    direction[index] = Vector2( 0,0 );
+                    float* p_coefficients = &coefficients[ (size_t)y * count ];
+                    
+                    for( int x=0; x<width; ++x, p_coefficients+=CHANNEL*2 )
+                    {
+                        float guide_means[ CHANNEL ], guide_variances[ CHANNEL ];
+                        const int pixels = guide_table.statistics( x, y, radius, guide_means, guide_variances );
+                        
+                        float means[ CHANNEL ], covariances[ CHANNEL ];
+                        if( self )
+                        {
+                            std::copy( guide_means, guide_means + CHANNEL, means );
+                            std::copy( guide_variances, guide_variances + CHANNEL, covariances );
+                        }
+                        else
+                        {
+                            Sum sums[ CHANNEL ], products[ CHANNEL ];
+                            image_table.sum( fast_max( x - radius, 0 ), fast_max( y - radius, 0 ),
+                                             fast_min( x + radius + 1, width ), fast_min( y + radius + 1, height ),
+                                             sums, products );
+                            for( int c=0; c<CHANNEL; ++c )
+                            {
+                                const double mean = (double)sums[c] / pixels;
+                                means[c] = (float)mean;
+                                covariances[c] = (float)( (double)products[c] / pixels - mean * guide_means[c] );
+                            }
+                        }
+                        
+                        // a flat guide with epsilon 0 has nothing to fit. the box mean is taken.
+                        for( int c=0; c<CHANNEL; ++c )
+                        {
+                            const float variance = guide_variances[c] + regularization;
+                            const float a = variance > 0.0f ? covariances[c] / variance : 0.0f;
+                            p_coefficients[ c*2 ]     = a;
+                            p_coefficients[ c*2 + 1 ] = means[c] - a * guide_means[c];
+                        }
+                    }
                 }
-                else
+            } );
+            
+            // the sums of a and b are fractional, so they are summed in double.
+            const int pitch = ( width + 1 ) * CHANNEL * 2;
+            std::vector< double > table( (size_t)pitch * ( height + 1 ) );
+            summed_area_table( width, height, CHANNEL * 2, threads, [&]( const int y, double* line )
+            {
+                const float* p_coefficients = &coefficients[ (size_t)y * count ];
+                std::copy( p_coefficients, p_coefficients + count, line );
+            }, &table[0] );
+            
+            output.create( image.size, Initialize::none );
+            Channel* const output_pixels = (Channel*)output.row( 0 );
+            const ptrdiff_t output_stride = output.stride;
+            
+            parallel_bands( height, threads, [&]( const int, const int begin, const int end )
+            {
+                for( int y=begin; y<end; ++y )
                 {
-                    direction[index] = v.normalize();
+                    const Channel* p_guide = (const Channel*)guide.row( y );
+                    Channel* p_output = offset_row( output_pixels, y*output_stride );
+                    const int y0 = fast_max( y - radius, 0 );
+                    const int y1 = fast_min( y + radius + 1, height );
+                    
+                    for( int x=0; x<width; ++x )
+                    {
+                        const int x0 = fast_max( x - radius, 0 );
+                        const int x1 = fast_min( x + radius + 1, width );
+                        const double scale = 1.0 / ( ( x1 - x0 ) * ( y1 - y0 ) );
+                        
+                        for( int c=0; c<CHANNEL; ++c )
+                        {
+                            const int i = c*2;
+                            const double a = box_sum( &table[ i ],   pitch, x0*CHANNEL*2, y0, x1*CHANNEL*2, y1 ) * scale;
+                            const double b = box_sum( &table[ i+1 ], pitch, x0*CHANNEL*2, y0, x1*CHANNEL*2, y1 ) * scale;
+                            
+                            round_channel( p_output[ x*CHANNEL + c ], (float)( a * p_guide[ x*CHANNEL + c ] + b ) );
+                        }
+                    }
                 }
-            }
+            } );
         }
-
-        ImageGRAY input;
-        ImageHMB output( image.size );
-        
-        input = image;
-        input = input.mirror_border(radius, radius);
-        
-        const float max_distance_inverse = 1.0 / ( sqrt( radius*radius + radius*radius ) * radius );
-
-        HMB* p_output = &output[0];
         
-        for( int y=0; y<output.height; ++y )
+        template <class ImageType>
+        static inline typename ImageType::Move guided_filter( const typename ImageType::View& image,
+                                                              const typename ImageType::View& guide,
+                                                              const int radius, const float epsilon, const int threads )
         {
-            const GRAY* p_input = &input[ {0,y} ];
-
-            for( int x=0; x<output.width; ++x, ++p_output, ++p_input )
+            if( radius < 0 )
             {
-                const GRAY center = p_input[ x + radius ];
-                
-                Vector2 vec;
-                for( int i=0; i<direction.size(); ++i )
-                {
-                    const int dx = i % side;
-                    const int dy = i / side;
-                    const GRAY target = p_input[ dx + dy*input.width ];
-                    
-                    vec += direction[i] * ( center.L - target.L );
-                }
-                
-                *p_output = {
-                    vec.angle(),
-                    (float)core::fast_min( (int)(vec.magnitude() * max_distance_inverse), 255 ), 0 };
+                throw std::range_error( "radius < 0" );
+            }
+            if( epsilon < 0.0f )
+            {
+                throw std::range_error( "epsilon < 0.0f" );
+            }
+            if( image.size != guide.size )
+            {
+                throw std::range_error( "image.size != guide.size" );
+            }
+            
+            ImageType output;
+            if( image.length == 0 )
+            {
+                return std::move( output );
+            }
+            
+            // the sums of squares of a box fit 32 bits up to a radius of 128.
+            if( radius <= 128 )
+            {
+                guided_filter_into< uint32_t >( image, guide, radius, epsilon, threads, output );
+            }
+            else
+            {
+                guided_filter_into< uint64_t >( image, guide, radius, epsilon, threads, output );
             }
+            return std::move( output );
         }
-        
-        return std::move( output );
+    }
+    
+    /*
+     *  edge keeping blur by a guided filter. the work does not depend on radius.
+     *
+     *  [in]image   to blur.
+     *  [in]guide   whose edges are kept. the image itself for edge keeping smoothing.
+     *  [in]radius  of the boxes. 0 or more.
+     *  [in]epsilon 0 or more, in squares of the 0 to 1 range of a channel. edges whose deviation in a box
+     *              is well above sqrt( epsilon ) are kept, flatter areas are blurred. 0.01 keeps about 25 levels.
+     */
+    static inline ImageRGB::Move guided_filter( const ImageViewRGB& image, const ImageViewRGB& guide,
+                                                const int radius, const float epsilon, const int threads = 1 )
+    {
+        return core::guided_filter< ImageRGB >( image, guide, radius, epsilon, threads );
+    }
+    
+    static inline ImageGRAY::Move guided_filter( const ImageViewGRAY& image, const ImageViewGRAY& guide,
+                                                 const int radius, const float epsilon, const int threads = 1 )
+    {
+        return core::guided_filter< ImageGRAY >( image, guide, radius, epsilon, threads );
     }
 }
 
@@ -5,6 +5,132 @@
 #include <apr_hash.h>
 #include <apr_strings.h>
 #include "GazoShori.hpp"
+#include <list>
+#include <memory>
+
+extern "C" module AP_MODULE_DECLARE_DATA gazo_shori_module;
+
+enum class BufferAllocator
+{
+    heap,
+    pool,    // request pool. released together with the request.
+    recycle, // per-thread size class cache. reused across requests.
+};
+
+struct GazoShoriConfig
+{
+    BufferAllocator allocator;
+    int             grayscale; // 8bit uploads are processed and returned as 8bit gray.
+    int             threads;   // filter threads per request.
+};
+
+static void* create_gazo_shori_server_config( apr_pool_t* p, server_rec* )
+{
+    GazoShoriConfig* config = (GazoShoriConfig*)apr_pcalloc( p, sizeof(GazoShoriConfig) );
+    
+    config->allocator = BufferAllocator::recycle;
+    config->grayscale = 0;
+    config->threads = 1;
+    return config;
+}
+
+static const char* set_gazo_shori_allocator( cmd_parms* cmd, void*, const char* arg )
+{
+    GazoShoriConfig* config =
+        (GazoShoriConfig*)ap_get_module_config( cmd->server->module_config, &gazo_shori_module );
+    
+    if( !strcmp( arg, "heap" ) )
+    {
+        config->allocator = BufferAllocator::heap;
+    }
+    else if( !strcmp( arg, "pool" ) )
+    {
+        config->allocator = BufferAllocator::pool;
+    }
+    else if( !strcmp( arg, "recycle" ) )
+    {
+        config->allocator = BufferAllocator::recycle;
+    }
+    else
+    {
+        return "GazoShoriAllocator must be heap, pool or recycle";
+    }
+    return NULL;
+}
+
+static const char* set_gazo_shori_grayscale( cmd_parms* cmd, void*, int flag )
+{
+    GazoShoriConfig* config =
+        (GazoShoriConfig*)ap_get_module_config( cmd->server->module_config, &gazo_shori_module );
+    
+    config->grayscale = flag;
+    return NULL;
+}
+
+static const char* set_gazo_shori_threads( cmd_parms* cmd, void*, const char* arg )
+{
+    GazoShoriConfig* config =
+        (GazoShoriConfig*)ap_get_module_config( cmd->server->module_config, &gazo_shori_module );
+    
+    const int threads = atoi( arg );
+    if( threads < 1 )
+    {
+        return "GazoShoriThreads must be 1 or more";
+    }
+    config->threads = threads;
+    return NULL;
+}
+
+// the cache of the recycle allocator is per thread and shared by every server, so this is global only.
+static const char* set_gazo_shori_recycle_capacity( cmd_parms* cmd, void*, const char* arg )
+{
+    const char* error = ap_check_cmd_context( cmd, GLOBAL_ONLY );
+    if( error != NULL )
+    {
+        return error;
+    }
+    
+    const int megabytes = atoi( arg );
+    if( megabytes < 0 || ( megabytes == 0 && strcmp( arg, "0" ) ) )
+    {
+        return "GazoShoriRecycleCapacity must be 0 or more megabytes";
+    }
+    gs::core::set_recycle_capacity( (size_t)megabytes * 1024 * 1024 );
+    return NULL;
+}
+
+static const command_rec gazo_shori_commands[] =
+{
+    AP_INIT_TAKE1( "GazoShoriAllocator", (const char* (*)())set_gazo_shori_allocator, NULL, RSRC_CONF,
+                   "image buffer allocator. heap, pool or recycle" ),
+    AP_INIT_FLAG( "GazoShoriGrayscale", (const char* (*)())set_gazo_shori_grayscale, NULL, RSRC_CONF,
+                  "On to keep 8bit gray uploads in one channel instead of expanding them to RGB" ),
+    AP_INIT_TAKE1( "GazoShoriThreads", (const char* (*)())set_gazo_shori_threads, NULL, RSRC_CONF,
+                   "maximum filter threads per request. 1 keeps filters on the request thread" ),
+    AP_INIT_TAKE1( "GazoShoriRecycleCapacity", (const char* (*)())set_gazo_shori_recycle_capacity, NULL, RSRC_CONF,
+                   "megabytes of freed image buffers the recycle allocator keeps per worker thread. default 16" ),
+    { NULL }
+};
+
+// Image buffers allocated from the request pool. freed all at once with the request.
+class PoolAllocator : public gs::core::Allocator
+{
+private:
+    apr_pool_t* m_pool;
+    
+public:
+    PoolAllocator( apr_pool_t* pool ) : m_pool( pool ){}
+    
+    void* allocate( const size_t size ) override
+    {
+        return apr_palloc( m_pool, size );
+    }
+    void deallocate( void*, const size_t ) override
+    {
+    }
+};
+
+static gs::core::RecyclingAllocator recycling_allocator;
 
 class MultipartFormData
 {
@@ -54,6 +180,44 @@ public:
     }
 };
 
+// Incremental filter state of the recently used editing sessions.
+class IncrementalSessions
+{
+public:
+    using Filter = gs::IncrementalFilter< gs::ImageRGB >;
+    
+private:
+    std::mutex m_mutex;
+    std::list< std::pair< std::string, std::shared_ptr< Filter > > > m_sessions; // front is the most recent.
+    const size_t m_capacity;
+    
+public:
+    IncrementalSessions( const size_t capacity ) : m_capacity( capacity ){}
+    
+    std::shared_ptr< Filter > get( const std::string& key )
+    {
+        std::lock_guard< std::mutex > lock( m_mutex );
+        
+        for( auto it = m_sessions.begin(); it != m_sessions.end(); ++it )
+        {
+            if( it->first == key )
+            {
+                m_sessions.splice( m_sessions.begin(), m_sessions, it );
+                return m_sessions.front().second;
+            }
+        }
+        
+        m_sessions.emplace_front( key, std::make_shared< Filter >() );
+        if( m_sessions.size() > m_capacity )
+        {
+            m_sessions.pop_back();
+        }
+        return m_sessions.front().second;
+    }
+};
+
+static IncrementalSessions incremental_sessions( 16 );
+
 static int gazo_shori_handler(request_rec *r)
 {
     if( strcmp(r->handler, "gazo_shori") )
@@ -99,11 +263,57 @@ static int gazo_shori_handler(request_rec *r)
 
     if ( !r->header_only )
     {
-        gs::ImageRGB image;
+        const GazoShoriConfig* config =
+            (const GazoShoriConfig*)ap_get_module_config( r->server->module_config, &gazo_shori_module );
+        
+        PoolAllocator pool_allocator( r->pool );
+        gs::core::Allocator* allocator = gs::core::heap_allocator();
+        
+        if( config->allocator == BufferAllocator::pool )
+        {
+            allocator = &pool_allocator;
+        }
+        else if( config->allocator == BufferAllocator::recycle )
+        {
+            allocator = &recycling_allocator;
+        }
+        gs::core::ScopedAllocator scoped_allocator( allocator );
+        
         MultipartFormData form( post );
         
+        // the editing sessions keep RGB state, so only plain requests take the gray path.
+        // 8bit uploads with a palette of colors are expanded to RGB by read().
+        const char* session = apr_table_get( r->headers_in, "X-Gazo-Shori-Session" );
+        if( config->grayscale && session == nullptr && gs::core::gray_bitmap( form.binary_data ) )
+        {
+            gs::ImageGRAY gray;
+            
+            gray.read( form.binary_data );
+            gray.gaussian_into( gray, 10, config->threads );
+            
+            std::stringstream bitmap;
+            gray.write( bitmap );
+            ap_rwrite( bitmap.str().data(), bitmap.str().size(), r );
+            return OK;
+        }
+        
+        gs::ImageRGB image;
+        
         image.read( form.binary_data );
-        image = image.gaussian( 10 );
+        
+        // re-uploads of the same editing session recompute only the changed tiles.
+        if( session != nullptr )
+        {
+            image = incremental_sessions.get( session )->gaussian( image, 10, config->threads );
+        }
+        else
+        {
+            // the planar layout lets the blur run on contiguous 8bit channels.
+            gs::ImagePlanarRGB planar( image );
+            
+            planar.gaussian_into( planar, 10, config->threads );
+            planar.interleave_into( image );
+        }
 
         std::stringstream bitmap;
         image.write( bitmap );
@@ -124,9 +334,9 @@ module AP_MODULE_DECLARE_DATA gazo_shori_module = {
     STANDARD20_MODULE_STUFF, 
     NULL,                  /* create per-dir    config structures */
     NULL,                  /* merge  per-dir    config structures */
-    NULL,                  /* create per-server config structures */
+    create_gazo_shori_server_config, /* create per-server config structures */
     NULL,                  /* merge  per-server config structures */
-    NULL,                  /* table of config file commands       */
+    gazo_shori_commands,   /* table of config file commands       */
     gazo_shori_register_hooks  /* register hooks                      */
 };
 }